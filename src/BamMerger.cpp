@@ -0,0 +1,297 @@
+// Author: Derek Barnett
+
+#include "BamMerger.h"
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+
+#include <pbbam/BamFile.h>
+#include <pbbam/BamHeader.h>
+#include <pbbam/PbiRawData.h>
+
+namespace internal {
+
+static const size_t BgzfHeaderSize = 18;   // gzip header + BC extra subfield
+static const size_t BgzfMaxBlockSize = 65536;
+static const uint32_t PbiVersion = 0x030001; // 3.0.1, basic data only
+
+static inline uint16_t ReadUint16(const unsigned char* p)
+{ return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+static inline uint32_t ReadUint32(const unsigned char* p)
+{ return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+
+// PBI columns are little-endian, as is every platform we build on
+template<typename T>
+static bool WriteColumn(BGZF* fp, const std::vector<T>& column)
+{
+    const size_t numBytes = column.size() * sizeof(T);
+    return numBytes == 0 || bgzf_write(fp, column.data(), numBytes) == static_cast<ssize_t>(numBytes);
+}
+
+template<typename T>
+static void AppendColumn(std::vector<T>* to, const std::vector<T>& from)
+{ to->insert(to->end(), from.begin(), from.end()); }
+
+} // namespace internal
+
+BamMerger::BamMerger(const std::string& outputFilename,
+                     const std::vector<std::string>& inputFilenames)
+    : outputFilename_(outputFilename)
+    , inputFilenames_(inputFilenames)
+    , bytesCopied_(0)
+    , blocksCopied_(0)
+{ }
+
+const std::vector<std::string>& BamMerger::Errors(void) const
+{ return errors_; }
+
+uint64_t BamMerger::BytesCopied(void) const
+{ return bytesCopied_; }
+
+uint64_t BamMerger::BlocksCopied(void) const
+{ return blocksCopied_; }
+
+bool BamMerger::Run(void)
+{
+    using namespace PacBio::BAM;
+
+    if (inputFilenames_.empty()) {
+        errors_.push_back("no input BAM files to merge");
+        return false;
+    }
+
+    try {
+        if (!CheckHeaders())
+            return false;
+
+        // where each input's records start, must be on a block boundary
+        std::vector<int64_t> firstBlockOffsets;
+        for (const std::string& fn : inputFilenames_) {
+            const BamFile file(fn);
+            if (!file.PacBioIndexExists()) {
+                errors_.push_back("missing PBI for " + fn);
+                return false;
+            }
+            const int64_t firstRecordOffset = file.FirstAlignmentOffset();
+            if ((firstRecordOffset & 0xFFFF) != 0) {
+                errors_.push_back("first record of " + fn + " does not start a BGZF block, "
+                                  "it can't be merged without recompressing");
+                return false;
+            }
+            firstBlockOffsets.push_back(firstRecordOffset >> 16);
+        }
+
+        BGZF* out = bgzf_open(outputFilename_.c_str(), "w");
+        if (out == nullptr) {
+            errors_.push_back("could not open " + outputFilename_ + " for writing");
+            return false;
+        }
+
+        bool success = WriteHeader(out, BamFile(inputFilenames_.front()).Header()) &&
+                       bgzf_flush(out) == 0;
+
+        // copy record blocks, noting how far each input's blocks moved
+        uint64_t outOffset = static_cast<uint64_t>(bgzf_tell(out) >> 16);
+        std::vector<int64_t> blockShifts;
+        for (size_t i = 0; success && i < inputFilenames_.size(); ++i) {
+            blockShifts.push_back(static_cast<int64_t>(outOffset) - firstBlockOffsets[i]);
+            success = CopyBlocks(inputFilenames_[i], firstBlockOffsets[i], out, &outOffset);
+        }
+
+        // closing appends the one EOF marker
+        if (bgzf_close(out) != 0 && success) {
+            errors_.push_back("could not finish writing " + outputFilename_);
+            success = false;
+        }
+        return success && MergeIndexes(blockShifts);
+
+    } catch (std::exception& e) {
+        errors_.push_back(e.what());
+        return false;
+    }
+}
+
+bool BamMerger::CheckHeaders(void)
+{
+    using namespace PacBio::BAM;
+
+    const BamHeader first = BamFile(inputFilenames_.front()).Header();
+
+    // @PG lines may differ (e.g. --chunk arguments), nothing else may
+    auto describe = [](const BamHeader& header) {
+        std::string description = header.Version() + '\t' + header.SortOrder() + '\t' +
+                                  header.PacBioBamVersion() + '\n';
+        for (const SequenceInfo& sequence : header.Sequences())
+            description += sequence.ToSam() + '\n';
+        for (const ReadGroupInfo& readGroup : header.ReadGroups())
+            description += readGroup.ToSam() + '\n';
+        return description;
+    };
+    const std::string expected = describe(first);
+
+    for (size_t i = 1; i < inputFilenames_.size(); ++i) {
+        if (describe(BamFile(inputFilenames_[i]).Header()) != expected) {
+            errors_.push_back("header of " + inputFilenames_[i] + " is not compatible with " +
+                              inputFilenames_.front());
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BamMerger::WriteHeader(BGZF* out, const PacBio::BAM::BamHeader& header)
+{
+    using namespace PacBio::BAM;
+
+    // BAM magic, SAM text & reference list
+    std::string data("BAM\1", 4);
+    auto appendInt32 = [&data](const int32_t value) {
+        data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    const std::string text = header.ToSam();
+    appendInt32(static_cast<int32_t>(text.size()));
+    data += text;
+
+    const std::vector<SequenceInfo> sequences = header.Sequences();
+    appendInt32(static_cast<int32_t>(sequences.size()));
+    for (const SequenceInfo& sequence : sequences) {
+        const std::string name = sequence.Name();
+        appendInt32(static_cast<int32_t>(name.size() + 1));
+        data.append(name.c_str(), name.size() + 1);
+        appendInt32(static_cast<int32_t>(std::stol(sequence.Length())));
+    }
+
+    if (bgzf_write(out, data.data(), data.size()) != static_cast<ssize_t>(data.size())) {
+        errors_.push_back("could not write header to " + outputFilename_);
+        return false;
+    }
+    return true;
+}
+
+bool BamMerger::CopyBlocks(const std::string& fn,
+                           const int64_t firstBlockOffset,
+                           BGZF* out,
+                           uint64_t* outOffset)
+{
+    assert(outOffset);
+
+    std::ifstream in(fn, std::ios::binary);
+    if (!in || !in.seekg(firstBlockOffset)) {
+        errors_.push_back("could not read " + fn);
+        return false;
+    }
+
+    // empty blocks are held back, & dropped if nothing follows them (EOF marker)
+    std::string pending;
+    std::vector<unsigned char> block(internal::BgzfMaxBlockSize);
+
+    while (in.read(reinterpret_cast<char*>(block.data()), internal::BgzfHeaderSize)) {
+
+        const unsigned char* h = block.data();
+        if (h[0] != 31 || h[1] != 139 || h[2] != 8 || (h[3] & 4) == 0 ||
+            internal::ReadUint16(h + 10) != 6 || h[12] != 'B' || h[13] != 'C')
+        {
+            errors_.push_back("invalid BGZF block in " + fn);
+            return false;
+        }
+        const size_t blockSize = internal::ReadUint16(h + 16) + 1;
+        if (blockSize < internal::BgzfHeaderSize + 8 ||
+            !in.read(reinterpret_cast<char*>(block.data()) + internal::BgzfHeaderSize,
+                     blockSize - internal::BgzfHeaderSize))
+        {
+            errors_.push_back("truncated BGZF block in " + fn);
+            return false;
+        }
+
+        const uint32_t uncompressedSize = internal::ReadUint32(block.data() + blockSize - 4);
+        if (uncompressedSize == 0) {
+            pending.append(reinterpret_cast<const char*>(block.data()), blockSize);
+            continue;
+        }
+
+        // keep block positions (& so PBI offsets) contiguous
+        if (!pending.empty()) {
+            if (bgzf_raw_write(out, pending.data(), pending.size()) != static_cast<ssize_t>(pending.size())) {
+                errors_.push_back("could not write to " + outputFilename_);
+                return false;
+            }
+            *outOffset += pending.size();
+            pending.clear();
+        }
+        if (bgzf_raw_write(out, block.data(), blockSize) != static_cast<ssize_t>(blockSize)) {
+            errors_.push_back("could not write to " + outputFilename_);
+            return false;
+        }
+        *outOffset += blockSize;
+        bytesCopied_ += blockSize;
+        ++blocksCopied_;
+    }
+
+    if (!in.eof() || in.gcount() != 0) {
+        errors_.push_back("truncated BGZF block in " + fn);
+        return false;
+    }
+    return true;
+}
+
+bool BamMerger::MergeIndexes(const std::vector<int64_t>& blockShifts)
+{
+    using namespace PacBio::BAM;
+
+    assert(blockShifts.size() == inputFilenames_.size());
+
+    PbiRawBasicData merged;
+    for (size_t i = 0; i < inputFilenames_.size(); ++i) {
+        const BamFile file(inputFilenames_[i]);
+        const PbiRawData index(file.PacBioIndexFilename());
+        if (index.HasMappedData() || index.HasBarcodeData() || index.HasReferenceData()) {
+            errors_.push_back("only unaligned, unbarcoded PBIs can be merged: " +
+                              file.PacBioIndexFilename());
+            return false;
+        }
+
+        const PbiRawBasicData& basic = index.BasicData();
+        internal::AppendColumn(&merged.rgId_,       basic.rgId_);
+        internal::AppendColumn(&merged.qStart_,     basic.qStart_);
+        internal::AppendColumn(&merged.qEnd_,       basic.qEnd_);
+        internal::AppendColumn(&merged.holeNumber_, basic.holeNumber_);
+        internal::AppendColumn(&merged.readQual_,   basic.readQual_);
+        internal::AppendColumn(&merged.ctxtFlag_,   basic.ctxtFlag_);
+
+        // virtual offsets: compressed block offset in the upper 48 bits
+        for (const int64_t offset : basic.fileOffset_)
+            merged.fileOffset_.push_back(offset + (blockShifts[i] << 16));
+    }
+
+    const std::string pbiFn = outputFilename_ + ".pbi";
+    BGZF* out = bgzf_open(pbiFn.c_str(), "w");
+    if (out == nullptr) {
+        errors_.push_back("could not open " + pbiFn + " for writing");
+        return false;
+    }
+
+    const uint32_t version = internal::PbiVersion;
+    const uint16_t sections = 0; // basic data only
+    const uint32_t numReads = static_cast<uint32_t>(merged.fileOffset_.size());
+    char reserved[18] = { };
+    bool success = bgzf_write(out, "PBI\1", 4) == 4 &&
+                   bgzf_write(out, &version, sizeof(version)) == sizeof(version) &&
+                   bgzf_write(out, &sections, sizeof(sections)) == sizeof(sections) &&
+                   bgzf_write(out, &numReads, sizeof(numReads)) == sizeof(numReads) &&
+                   bgzf_write(out, reserved, sizeof(reserved)) == sizeof(reserved) &&
+                   internal::WriteColumn(out, merged.rgId_) &&
+                   internal::WriteColumn(out, merged.qStart_) &&
+                   internal::WriteColumn(out, merged.qEnd_) &&
+                   internal::WriteColumn(out, merged.holeNumber_) &&
+                   internal::WriteColumn(out, merged.readQual_) &&
+                   internal::WriteColumn(out, merged.ctxtFlag_) &&
+                   internal::WriteColumn(out, merged.fileOffset_);
+    if (bgzf_close(out) != 0)
+        success = false;
+    if (!success)
+        errors_.push_back("could not write " + pbiFn);
+    return success;
+}
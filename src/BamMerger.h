@@ -0,0 +1,57 @@
+// Author: Derek Barnett
+
+#ifndef BAMMERGER_H
+#define BAMMERGER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <htslib/bgzf.h>
+
+namespace PacBio { namespace BAM { class BamHeader; } }
+
+//
+// BamMerger joins BAM files converted in shards (--chunk, --zmw-range) into
+// one BAM & PBI, without decompressing or recompressing records.
+//
+// Headers must agree on everything but their @PG lines. A fresh header is
+// written from the first input, then each input's BGZF blocks are copied
+// verbatim, starting at its first record & dropping its trailing EOF marker.
+// PBIs are concatenated with their virtual file offsets shifted by where each
+// input's blocks land in the output.
+//
+// Inputs must have PBIs, and their first record must start a BGZF block (as
+// htslib writes them, with the header flushed separately).
+//
+class BamMerger
+{
+public:
+    BamMerger(const std::string& outputFilename,
+              const std::vector<std::string>& inputFilenames);
+
+public:
+    bool Run(void);
+
+    const std::vector<std::string>& Errors(void) const;
+    uint64_t BytesCopied(void) const;
+    uint64_t BlocksCopied(void) const;
+
+private:
+    bool CheckHeaders(void);
+    bool WriteHeader(BGZF* out, const PacBio::BAM::BamHeader& header);
+    bool CopyBlocks(const std::string& fn,
+                    const int64_t firstBlockOffset,
+                    BGZF* out,
+                    uint64_t* outOffset);
+    bool MergeIndexes(const std::vector<int64_t>& blockShifts);
+
+private:
+    std::string outputFilename_;
+    std::vector<std::string> inputFilenames_;
+    std::vector<std::string> errors_;
+    uint64_t bytesCopied_;
+    uint64_t blocksCopied_;
+};
+
+#endif // BAMMERGER_H
@@ -0,0 +1,75 @@
+// Author: Derek Barnett
+
+#include "BamRecordPool.h"
+
+#include <cassert>
+#include <utility>
+
+using namespace PacBio;
+using namespace PacBio::BAM;
+
+BamRecordPool::Lease::Lease(BamRecordPool* pool, std::unique_ptr<BamRecordImpl> record)
+    : pool_(pool)
+    , record_(std::move(record))
+{
+    assert(pool_);
+    assert(record_);
+}
+
+BamRecordPool::Lease::Lease(Lease&& other)
+    : pool_(other.pool_)
+    , record_(std::move(other.record_))
+{ }
+
+BamRecordPool::Lease::~Lease(void)
+{
+    if (record_)
+        pool_->Release(std::move(record_));
+}
+
+BamRecordImpl* BamRecordPool::Lease::get(void) const
+{ return record_.get(); }
+
+BamRecordImpl* BamRecordPool::Lease::operator->(void) const
+{ return record_.get(); }
+
+BamRecordImpl& BamRecordPool::Lease::operator*(void) const
+{ return *record_; }
+
+BamRecordPool::BamRecordPool(const size_t maxIdle)
+    : maxIdle_(maxIdle)
+    , hits_(0)
+    , misses_(0)
+{ }
+
+BamRecordPool::Lease BamRecordPool::Acquire(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            std::unique_ptr<BamRecordImpl> record = std::move(idle_.back());
+            idle_.pop_back();
+            ++hits_;
+            return Lease(this, std::move(record));
+        }
+    }
+
+    ++misses_;
+    return Lease(this, std::unique_ptr<BamRecordImpl>(new BamRecordImpl));
+}
+
+void BamRecordPool::Release(std::unique_ptr<BamRecordImpl> record)
+{
+    assert(record);
+
+    // anything beyond the idle limit is simply freed
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (idle_.size() < maxIdle_)
+        idle_.push_back(std::move(record));
+}
+
+uint64_t BamRecordPool::Hits(void) const
+{ return hits_; }
+
+uint64_t BamRecordPool::Misses(void) const
+{ return misses_; }
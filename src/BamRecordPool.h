@@ -0,0 +1,67 @@
+// Author: Derek Barnett
+
+#ifndef BAMRECORDPOOL_H
+#define BAMRECORDPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <pbbam/BamRecordImpl.h>
+
+//
+// BamRecordPool recycles BamRecordImpl objects between conversion & writing.
+//
+// A released record keeps its underlying buffers, so the next record built in
+// it usually needs no reallocation. Records are handed out as a Lease, which
+// returns the record to the pool when it goes out of scope (i.e. once it has
+// been written). Acquire/release are safe to call from multiple threads.
+//
+class BamRecordPool
+{
+public:
+    static const size_t DefaultMaxIdle = 64; // records kept for re-use
+
+public:
+    class Lease
+    {
+    public:
+        Lease(BamRecordPool* pool, std::unique_ptr<PacBio::BAM::BamRecordImpl> record);
+        Lease(Lease&& other);
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease(void);
+
+    public:
+        PacBio::BAM::BamRecordImpl* get(void) const;
+        PacBio::BAM::BamRecordImpl* operator->(void) const;
+        PacBio::BAM::BamRecordImpl& operator*(void) const;
+
+    private:
+        BamRecordPool* pool_;
+        std::unique_ptr<PacBio::BAM::BamRecordImpl> record_;
+    };
+
+public:
+    explicit BamRecordPool(const size_t maxIdle = DefaultMaxIdle);
+
+public:
+    Lease Acquire(void);
+    void Release(std::unique_ptr<PacBio::BAM::BamRecordImpl> record);
+
+    // number of Acquire() calls served from the pool vs. newly allocated
+    uint64_t Hits(void) const;
+    uint64_t Misses(void) const;
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<PacBio::BAM::BamRecordImpl> > idle_;
+    size_t maxIdle_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+#endif // BAMRECORDPOOL_H
@@ -3,11 +3,13 @@
 #include "Bax2Bam.h"
 #include "CcsConverter.h"
 #include "HqRegionConverter.h"
+#include "OutputPublisher.h"
 #include "PolymeraseReadConverter.h"
 #include "SubreadConverter.h"
 #include <pbbam/DataSet.h>
 #include <pbbam/PbiRawData.h>
 #include <boost/algorithm/string.hpp>
+#include <deque>
 #include <memory>
 #include <fstream>
 #include <iostream>
@@ -29,8 +31,23 @@ std::string CurrentWorkingDir(void)
     return std::string(result);
 }
 
+// If the output filename starts with a slash, assume it's the path,
+// otherwise build the path from the CWD
+static
+std::string AbsolutePath(const std::string& fn)
+{
+    if (boost::starts_with(fn, "/"))
+        return fn;
+    std::string path = CurrentWorkingDir();
+    if (!path.empty())
+        path.append(1, '/');
+    path.append(fn);
+    return path;
+}
+
 static
 bool WriteDatasetXmlOutput(const Settings& settings,
+                           OutputPublisher& publisher,
                            std::vector<std::string>* errors)
 {
     using namespace PacBio::BAM;
@@ -109,6 +126,10 @@ bool WriteDatasetXmlOutput(const Settings& settings,
         dataset.CreatedAt(ToIso8601(currentTime));
         dataset.TimeStampedName(outputTimestampPrefix+ToDataSetFormat(currentTime));
 
+        // tell shards of one movie apart
+        if (!settings.shardLabel.empty())
+            dataset.Name(dataset.Name() + " (" + settings.shardLabel.substr(1) + ")");
+
         // change files: remove BAX, add BAM
         std::vector<ExternalResource> toRemove;
         ExternalResources resources = dataset.ExternalResources();
@@ -127,69 +148,52 @@ bool WriteDatasetXmlOutput(const Settings& settings,
             toRemove.pop_back();
         }
 
-        const std::string scheme = "file://";
-        std::string mainBamFilepath;
-
-        // If the output filename starts with a slash, assume it's the path
-        if (boost::starts_with(settings.outputBamFilename, "/"))
-        {
-            mainBamFilepath = settings.outputBamFilename;
-        }
-        else // otherwise build the path from the CWD
-        {
-            mainBamFilepath = CurrentWorkingDir();
-            if (!mainBamFilepath.empty())
-                mainBamFilepath.append(1, '/');
-            mainBamFilepath.append(settings.outputBamFilename);
+        // one main BAM (& scraps BAM) per output part
+        std::vector<std::string> bamFilenames = settings.outputBamParts;
+        std::vector<std::string> scrapsFilenames = settings.scrapsBamParts;
+        if (bamFilenames.empty()) {
+            bamFilenames.push_back(settings.outputBamFilename);
+            if (!settings.scrapsBamFilename.empty())
+                scrapsFilenames.push_back(settings.scrapsBamFilename);
         }
 
-        // Combine the scheme and filepath and store in the dataset
-        mainBamFilepath = scheme + mainBamFilepath;
-        ExternalResource mainBam{ outputBamFileType, mainBamFilepath };
-        FileIndex mainPbi{ "PacBio.Index.PacBioIndex", mainBamFilepath + ".pbi" };
-        mainBam.FileIndices().Add(mainPbi);
+        uint64_t totalLength = 0;
+        uint32_t numRecords = 0;
+        for (size_t i = 0; i < bamFilenames.size(); ++i) {
+
+            // Combine the scheme and filepath and store in the dataset
+            const std::string mainBamFilepath = "file://" + AbsolutePath(bamFilenames[i]);
+            ExternalResource mainBam{ outputBamFileType, mainBamFilepath };
+            FileIndex mainPbi{ "PacBio.Index.PacBioIndex", mainBamFilepath + ".pbi" };
+            mainBam.FileIndices().Add(mainPbi);
+
+            // maybe add scraps BAM (& PBI)
+            if (i < scrapsFilenames.size()) {
+                const std::string scrapsBamFilepath = AbsolutePath(scrapsFilenames[i]);
+                ExternalResource scrapsBam{ outputScrapsFileType, scrapsBamFilepath };
+                FileIndex scrapsPbi{ "PacBio.Index.PacBioIndex", scrapsBamFilepath + ".pbi" };
+                scrapsBam.FileIndices().Add(scrapsPbi);
+                mainBam.ExternalResources().Add(scrapsBam);
+            }
 
-        // maybe add scraps BAM (& PBI)
-        if (!settings.scrapsBamFilename.empty()) {
+            // add resources to output dataset
+            resources.Add(mainBam);
 
-            std::string scrapsBamFilepath;
+            // update TotalLength & NumRecords
+            const BamFile subreadFile{ bamFilenames[i] };
+            const std::string subreadPbiFn = subreadFile.PacBioIndexFilename();
+            const PbiRawData subreadsIndex{ subreadPbiFn };
+            const PbiRawBasicData& subreadData = subreadsIndex.BasicData();
 
-            // If the output filename starts with a slash, assume it's the path
-            if (boost::starts_with(settings.scrapsBamFilename, "/"))
-            {
-                scrapsBamFilepath = settings.scrapsBamFilename;
-            }
-            else // otherwise build the path from the CWD
-            {
-                scrapsBamFilepath = CurrentWorkingDir();
-                if (!scrapsBamFilepath.empty())
-                    scrapsBamFilepath.append(1, '/');
-                scrapsBamFilepath.append(settings.scrapsBamFilename);
+            const uint32_t numPartRecords = subreadsIndex.NumReads();
+            for (uint32_t j = 0; j < numPartRecords; ++j) {
+                const auto subreadLength = subreadData.qEnd_.at(j) - subreadData.qStart_.at(j);
+                totalLength += subreadLength;
             }
-
-            ExternalResource scrapsBam{ outputScrapsFileType, scrapsBamFilepath };
-            FileIndex scrapsPbi{ "PacBio.Index.PacBioIndex", scrapsBamFilepath + ".pbi" };
-            scrapsBam.FileIndices().Add(scrapsPbi);
-            mainBam.ExternalResources().Add(scrapsBam);
+            numRecords += numPartRecords;
         }
-
-        // add resources to output dataset
-        resources.Add(mainBam);
         dataset.ExternalResources(resources);
 
-        // update TotalLength & NumRecords
-        const BamFile subreadFile{ settings.outputBamFilename };
-        const std::string subreadPbiFn = subreadFile.PacBioIndexFilename();
-        const PbiRawData subreadsIndex{ subreadPbiFn };
-        const PbiRawBasicData& subreadData = subreadsIndex.BasicData();
-
-        uint64_t totalLength = 0;
-        uint32_t numRecords = subreadsIndex.NumReads();
-        for (uint32_t i = 0; i < numRecords; ++i) {
-            const auto subreadLength = subreadData.qEnd_.at(i) - subreadData.qStart_.at(i);
-            totalLength += subreadLength;
-        }
-
         DataSetMetadata metadata = dataset.Metadata();
         metadata.TotalLength(std::to_string(totalLength));
         metadata.NumRecords(std::to_string(numRecords));
@@ -199,7 +203,10 @@ bool WriteDatasetXmlOutput(const Settings& settings,
         std::string xmlFn = settings.outputXmlFilename; // try user-provided explicit filename first
         if (xmlFn.empty())
             xmlFn = settings.outputBamPrefix + outputXmlSuffix; // prefix set w/ moviename elsewhere if not user-provided
-        dataset.Save(xmlFn);
+
+        // staged next to the BAMs, if requested (caller waits for the move)
+        dataset.Save(publisher.StagedPath(xmlFn));
+        publisher.Publish(xmlFn);
         return true;
 
     } catch (std::exception&) {
@@ -224,6 +231,32 @@ int Bax2Bam::Run(Settings& settings) {
             return EXIT_FAILURE;
     }
 
+    // additional modes ride along on the first one's pass over each ZMW,
+    // each with its own settings (deque keeps references stable)
+    std::deque<Settings> companionSettings;
+    std::vector<std::unique_ptr<ConverterBase<> > > companions;
+    for (const Settings::Mode mode : settings.additionalModes) {
+        companionSettings.push_back(settings);
+        Settings& s = companionSettings.back();
+        s.mode = mode;
+        s.additionalModes.clear();
+        s.outputXmlFilename.clear();
+
+        switch (mode) {
+            case Settings::HQRegionMode   : companions.emplace_back(new HqRegionConverter(s)); break;
+            case Settings::PolymeraseMode : companions.emplace_back(new PolymeraseReadConverter(s)); break;
+            case Settings::SubreadMode    : companions.emplace_back(new SubreadConverter(s)); break;
+            default :
+                std::cerr << "ERROR: mode cannot be combined with others" << std::endl;
+                return EXIT_FAILURE;
+        }
+        static_cast<ConverterBase<>*>(converter.get())->AddCompanion(companions.back().get());
+    }
+
+    // one staging dir (--tmpdir) & mover thread for every output of the run
+    std::shared_ptr<OutputPublisher> publisher = std::make_shared<OutputPublisher>(settings.tmpDir);
+    converter->SetPublisher(publisher);
+
     // run conversion
     bool success = false;
     std::vector<std::string> xmlErrors;
@@ -231,12 +264,36 @@ int Bax2Bam::Run(Settings& settings) {
         success = true;
 
         // if given dataset XML as input, attempt write dataset XML output
-        if (!settings.datasetXmlFilename.empty()) {
-            if (!internal::WriteDatasetXmlOutput(settings, &xmlErrors))
+        // (not for streamed or FASTA/FASTQ output, there's no BAM file/PBI to refer to)
+        if (!settings.datasetXmlFilename.empty() && !settings.isStreamingOutput &&
+            !settings.isStatsOnly && settings.outputFormat == Settings::BamFormat)
+        {
+            if (!internal::WriteDatasetXmlOutput(settings, *publisher, &xmlErrors))
+                success = false;
+
+            // companions name theirs after their BAM, they'd collide on the prefix
+            for (Settings& s : companionSettings) {
+                s.outputXmlFilename = boost::algorithm::erase_last_copy(s.outputBamFilename, ".bam") +
+                                      ".subreadset.xml";
+                if (!internal::WriteDatasetXmlOutput(s, *publisher, &xmlErrors))
+                    success = false;
+            }
+
+            // XML refers to the BAMs at their final paths, which Run() has already waited for
+            if (!publisher->Wait()) {
+                for (const std::string& e : publisher->Errors())
+                    xmlErrors.push_back(e);
                 success = false;
+            }
         }
     }
 
+    // report run statistics
+    if (settings.isReportingStats) {
+        for (const auto& stat : converter->Statistics())
+            std::cerr << stat.first << ": " << stat.second << std::endl;
+    }
+
     // return success/fail
     if (success)
         return EXIT_SUCCESS;
@@ -0,0 +1,210 @@
+// Author: Derek Barnett
+
+#include "BufferedFileSink.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace internal {
+
+// larger pipe = fewer wakeups of the sink thread
+static const int PipeSize = 1024 * 1024;
+
+static size_t AlignUp(const size_t n, const size_t alignment)
+{ return ((n + alignment - 1) / alignment) * alignment; }
+
+} // namespace internal
+
+BufferedFileSink::BufferedFileSink(const std::string& filename,
+                                   const size_t bufferSize,
+                                   const bool useDirectIO)
+    : filename_(filename)
+    , bufferSize_(internal::AlignUp(std::max(bufferSize, Alignment), Alignment))
+    , useDirectIO_(useDirectIO)
+    , fd_(-1)
+    , pipeRead_(-1)
+    , pipeWrite_(-1)
+    , buffer_(nullptr)
+    , isOk_(true)
+    , bytesWritten_(0)
+    , numWrites_(0)
+{ }
+
+BufferedFileSink::~BufferedFileSink(void)
+{
+    Finish();
+    free(buffer_);
+}
+
+bool BufferedFileSink::Open(void)
+{
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, Alignment, bufferSize_) != 0) {
+        error_ = "could not allocate output buffer for " + filename_;
+        return false;
+    }
+    buffer_ = static_cast<char*>(buffer);
+
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    if (useDirectIO_) {
+        fd_ = open(filename_.c_str(), flags | O_DIRECT, 0666);
+
+        // not every filesystem supports it (e.g. tmpfs), keep the large buffers anyway
+        if (fd_ < 0 && errno == EINVAL)
+            useDirectIO_ = false;
+    }
+#else
+    useDirectIO_ = false;
+#endif
+    if (fd_ < 0)
+        fd_ = open(filename_.c_str(), flags, 0666);
+    if (fd_ < 0) {
+        error_ = "could not open " + filename_ + ": " + std::strerror(errno);
+        return false;
+    }
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        error_ = std::string("could not create output pipe: ") + std::strerror(errno);
+        return false;
+    }
+    pipeRead_ = fds[0];
+    pipeWrite_ = fds[1];
+
+    // the writer reaches the pipe by path, which needs /dev/fd (Linux, macOS)
+    if (access(WriterPath().c_str(), W_OK) != 0) {
+        error_ = "could not buffer " + filename_ + ": " + WriterPath() + " is not available on this system";
+        return false;
+    }
+#ifdef F_SETPIPE_SZ
+    fcntl(pipeWrite_, F_SETPIPE_SZ, internal::PipeSize);
+#endif
+
+    thread_ = std::thread(&BufferedFileSink::Run, this);
+    return true;
+}
+
+bool BufferedFileSink::Finish(void)
+{
+    // writer's end is closed by now, closing ours signals EOF to the sink thread
+    if (pipeWrite_ >= 0) {
+        close(pipeWrite_);
+        pipeWrite_ = -1;
+    }
+    if (thread_.joinable())
+        thread_.join();
+
+    if (pipeRead_ >= 0) {
+        close(pipeRead_);
+        pipeRead_ = -1;
+    }
+    if (fd_ >= 0) {
+        if (close(fd_) != 0 && isOk_) {
+            isOk_ = false;
+            error_ = "could not close " + filename_ + ": " + std::strerror(errno);
+        }
+        fd_ = -1;
+    }
+    return isOk_ && error_.empty();
+}
+
+std::string BufferedFileSink::WriterPath(void) const
+{ return "/dev/fd/" + std::to_string(pipeWrite_); }
+
+const std::string& BufferedFileSink::Error(void) const
+{ return error_; }
+
+uint64_t BufferedFileSink::BytesWritten(void) const
+{ return bytesWritten_; }
+
+uint64_t BufferedFileSink::NumWrites(void) const
+{ return numWrites_; }
+
+bool BufferedFileSink::WriteBuffer(const size_t length)
+{
+    size_t offset = 0;
+    while (offset < length) {
+        const ssize_t n = write(fd_, buffer_ + offset, length - offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            error_ = "could not write " + filename_ + ": " + std::strerror(errno);
+            return false;
+        }
+        offset += n;
+        ++numWrites_;
+
+        // a short O_DIRECT write may stop mid-block, leaving the rest (& the
+        // file offset) unaligned - finish this file with buffered writes
+        if (useDirectIO_ && offset % Alignment != 0 && !ClearDirectIO())
+            return false;
+    }
+    bytesWritten_ += length;
+    return true;
+}
+
+bool BufferedFileSink::ClearDirectIO(void)
+{
+#ifdef O_DIRECT
+    const int flags = fcntl(fd_, F_GETFL);
+    if (flags < 0 || fcntl(fd_, F_SETFL, flags & ~O_DIRECT) != 0) {
+        error_ = "could not clear O_DIRECT on " + filename_ + ": " + std::strerror(errno);
+        return false;
+    }
+#endif
+    useDirectIO_ = false;
+    return true;
+}
+
+bool BufferedFileSink::WriteTail(const size_t length)
+{
+    if (length == 0)
+        return true;
+
+    // O_DIRECT needs whole aligned blocks, the last one usually isn't
+    if (useDirectIO_ && length % Alignment != 0 && !ClearDirectIO())
+        return false;
+    return WriteBuffer(length);
+}
+
+void BufferedFileSink::Run(void)
+{
+    size_t used = 0;
+    while (true) {
+        const ssize_t n = read(pipeRead_, buffer_ + used, bufferSize_ - used);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            error_ = std::string("could not read output pipe: ") + std::strerror(errno);
+            isOk_ = false;
+            break;
+        }
+
+        // EOF
+        if (n == 0) {
+            isOk_ = WriteTail(used);
+            break;
+        }
+
+        used += n;
+        if (used == bufferSize_) {
+            if (!WriteBuffer(used)) {
+                isOk_ = false;
+                break;
+            }
+            used = 0;
+        }
+    }
+
+    // keep draining so the writer never blocks on a full pipe after an error
+    if (!isOk_) {
+        char discard[65536];
+        while (read(pipeRead_, discard, sizeof(discard)) > 0) { }
+    }
+}
@@ -0,0 +1,71 @@
+// Author: Derek Barnett
+
+#ifndef BUFFEREDFILESINK_H
+#define BUFFEREDFILESINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+//
+// BufferedFileSink collects a writer's output into large, aligned buffers
+// before it reaches the filesystem.
+//
+// htslib only accepts a path, so the writer is pointed at WriterPath() - the
+// write end of a pipe, as /dev/fd/N. That path exists on Linux & macOS; Open()
+// fails with an error where it doesn't. A background thread drains the pipe
+// into a buffer of bufferSize bytes & writes it out when full, optionally with
+// O_DIRECT (buffers & file offsets are kept aligned; a short write that stops
+// mid-block, or the final partial block, is written after clearing O_DIRECT).
+//
+// Call Finish() after the writer has been closed; it flushes the remaining
+// data & reports whether everything was written.
+//
+class BufferedFileSink
+{
+public:
+    static const size_t DefaultBufferSize = 8 * 1024 * 1024;
+    static const size_t Alignment = 4096;
+
+public:
+    BufferedFileSink(const std::string& filename,
+                     const size_t bufferSize = DefaultBufferSize,
+                     const bool useDirectIO = false);
+    ~BufferedFileSink(void);
+
+public:
+    bool Open(void);
+    bool Finish(void);
+
+    // path for the writer to open
+    std::string WriterPath(void) const;
+
+    const std::string& Error(void) const;
+    uint64_t BytesWritten(void) const;
+    uint64_t NumWrites(void) const;
+
+private:
+    void Run(void);
+    bool WriteBuffer(const size_t length);
+    bool ClearDirectIO(void);
+    bool WriteTail(const size_t length);
+
+private:
+    std::string filename_;
+    size_t bufferSize_;
+    bool useDirectIO_;
+
+    int fd_;
+    int pipeRead_;
+    int pipeWrite_;
+    char* buffer_;
+
+    std::thread thread_;
+    bool isOk_;
+    std::string error_;
+    uint64_t bytesWritten_;
+    uint64_t numWrites_;
+};
+
+#endif // BUFFEREDFILESINK_H
@@ -26,24 +26,26 @@ CcsConverter::CcsConverter(Settings& settings)
 
 CcsConverter::~CcsConverter(void) { }
 
-bool CcsConverter::ConvertFile(HdfCcsReader* reader,
-                               BamWriter* writer)
+bool CcsConverter::ConvertFile(HdfCcsReader* reader)
 {
     assert(reader);
 
     // initialize read scores
     InitReadScores(reader);
 
+    // non-sequencing ZMWs are skipped before reading
+    InitHoleStatus(reader);
+
     // fetch records from HDF5 file
     CCSSequence smrtRecord;
-    while (reader->GetNext(smrtRecord)) {
+    while (GetNextZmw(reader, smrtRecord, false)) {
 
         // Skip empty records
         if ((smrtRecord.length == 0) || !IsSequencingZmw(smrtRecord))
             continue;
 
-        // attempt convert BAX to BAM
-        if (!WriteRecord(smrtRecord, 0, smrtRecord.length, ReadGroupId(), writer))
+        // attempt convert BAX to BAM (into the current output part)
+        if (!WriteRecord(smrtRecord, 0, smrtRecord.length, ReadGroupId(), writer_.get()))
         {
             smrtRecord.Free();
             return false;
@@ -56,11 +58,6 @@ bool CcsConverter::ConvertFile(HdfCcsReader* reader,
     return true;
 }
 
-bool CcsConverter::ConvertFile(HdfCcsReader* reader,
-                               PacBio::BAM::BamWriter* writer,
-                               PacBio::BAM::BamWriter* scrapsWriter)
-{ return false; }
-
 void CcsConverter::SetSequenceAndQualities(PacBio::BAM::BamRecordImpl* bamRecord,
                                            const CCSSequence& smrtRead,
                                            const int start,
@@ -77,14 +74,12 @@ void CcsConverter::SetSequenceAndQualities(PacBio::BAM::BamRecordImpl* bamRecord
     }
 }
 
-void CcsConverter::AddRecordName(PacBio::BAM::BamRecordImpl* bamRecord,
-                                 const UInt holeNumber,
-                                 const int start,
-                                 const int end)
+std::string CcsConverter::RecordName(const UInt holeNumber,
+                                     const int start,
+                                     const int end) const
 {
-    const std::string name = settings_.movieName + "/"
-                      + std::to_string(holeNumber) + "/ccs";
-    bamRecord->Name(name);
+    return settings_.movieName + "/"
+           + std::to_string(holeNumber) + "/ccs";
 }
 
 void CcsConverter::AddModeTags(PacBio::BAM::TagCollection* tags,
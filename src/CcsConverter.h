@@ -18,19 +18,14 @@ public:
     ~CcsConverter(void);
 
 protected:
-    bool ConvertFile(HdfCcsReader* reader,
-                     PacBio::BAM::BamWriter* writer);
-    bool ConvertFile(HdfCcsReader* reader,
-                     PacBio::BAM::BamWriter* writer,
-                     PacBio::BAM::BamWriter* scrapsWriter);
+    bool ConvertFile(HdfCcsReader* reader);
     void SetSequenceAndQualities(PacBio::BAM::BamRecordImpl* bamRecord,
                                  const CCSSequence& smrtRecord,
                                  const int start,
                                  const int end);
-    void AddRecordName(PacBio::BAM::BamRecordImpl* bamRecord,
-                       const UInt holeNumber,
-                       const int start,
-                       const int end);
+    std::string RecordName(const UInt holeNumber,
+                           const int start,
+                           const int end) const;
     void AddModeTags(PacBio::BAM::TagCollection* tags,
                      const CCSSequence& smrtRecord,
                      const int start,
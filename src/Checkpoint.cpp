@@ -0,0 +1,220 @@
+// Author: Derek Barnett
+
+#include "Checkpoint.h"
+
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <unistd.h>
+
+#include <htslib/bgzf.h>
+#include <htslib/sam.h>
+
+namespace internal {
+
+static const char* CheckpointMagic = "bax2bam checkpoint 1";
+static const size_t BgzfHeaderSize = 18; // gzip header + BC extra subfield
+
+static std::string FormatEntry(const CheckpointEntry& entry)
+{
+    return std::to_string(entry.fileIndex) + " " +
+           std::to_string(entry.zmwIndex) + " " +
+           std::to_string(entry.holeNumber) + " " +
+           std::to_string(entry.numRecords) + " " +
+           std::to_string(entry.numScrapsRecords) + "\n";
+}
+
+// writes & syncs, so an entry is on disk before conversion moves past it
+static bool WriteSynced(FILE* fp, const std::string& text)
+{
+    return std::fwrite(text.data(), 1, text.size(), fp) == text.size() &&
+           std::fflush(fp) == 0 &&
+           fsync(fileno(fp)) == 0;
+}
+
+// compressed size of the BGZF block starting at blockAddress
+static bool ReadBlockSize(std::ifstream& in, const int64_t blockAddress, int64_t* blockSize)
+{
+    unsigned char header[BgzfHeaderSize];
+    in.clear();
+    if (!in.seekg(blockAddress) || !in.read(reinterpret_cast<char*>(header), BgzfHeaderSize))
+        return false;
+    if (header[0] != 31 || header[1] != 139 || header[12] != 'B' || header[13] != 'C')
+        return false;
+    *blockSize = static_cast<int64_t>(header[16] | (header[17] << 8)) + 1;
+    return true;
+}
+
+} // namespace internal
+
+Checkpoint::Checkpoint(const std::string& filename)
+    : filename_(filename)
+{ }
+
+const std::string& Checkpoint::Filename(void) const
+{ return filename_; }
+
+const std::string& Checkpoint::Error(void) const
+{ return error_; }
+
+bool Checkpoint::Load(std::string* options, std::vector<CheckpointEntry>* entries)
+{
+    std::ifstream in(filename_);
+    std::string line;
+    if (!in || !std::getline(in, line) || line != internal::CheckpointMagic)
+        return false;
+    if (!std::getline(in, line) || line.compare(0, 8, "options ") != 0)
+        return false;
+    *options = line.substr(8);
+
+    entries->clear();
+    while (std::getline(in, line)) {
+
+        // no newline, the run stopped while writing this entry
+        if (in.eof())
+            break;
+
+        CheckpointEntry entry;
+        std::istringstream fields(line);
+        if (!(fields >> entry.fileIndex >> entry.zmwIndex >> entry.holeNumber
+                     >> entry.numRecords >> entry.numScrapsRecords))
+            break;
+        entries->push_back(entry);
+    }
+    return true;
+}
+
+bool Checkpoint::Create(const std::string& options, const std::vector<CheckpointEntry>& entries)
+{
+    std::string text = std::string(internal::CheckpointMagic) + "\n" +
+                       "options " + options + "\n";
+    for (const CheckpointEntry& entry : entries)
+        text += internal::FormatEntry(entry);
+
+    // replaced in one step, an interrupted rewrite leaves the old file intact
+    const std::string tmpFn = filename_ + ".tmp";
+    FILE* fp = std::fopen(tmpFn.c_str(), "w");
+    if (fp == nullptr) {
+        error_ = "could not open " + tmpFn + " for writing";
+        return false;
+    }
+    const bool isWritten = internal::WriteSynced(fp, text);
+    if (std::fclose(fp) != 0 || !isWritten || std::rename(tmpFn.c_str(), filename_.c_str()) != 0) {
+        error_ = "could not write checkpoint file " + filename_;
+        std::remove(tmpFn.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::Add(const CheckpointEntry& entry)
+{
+    FILE* fp = std::fopen(filename_.c_str(), "a");
+    if (fp == nullptr) {
+        error_ = "could not open checkpoint file " + filename_;
+        return false;
+    }
+    const bool isWritten = internal::WriteSynced(fp, internal::FormatEntry(entry));
+    if (std::fclose(fp) != 0 || !isWritten) {
+        error_ = "could not write checkpoint file " + filename_;
+        return false;
+    }
+    return true;
+}
+
+void Checkpoint::Remove(void)
+{ std::remove(filename_.c_str()); }
+
+bool Checkpoint::FindRecordsEnd(const std::string& fn,
+                                const uint64_t numRecords,
+                                int64_t* blockOffset)
+{
+    std::vector<int64_t> blockOffsets;
+    if (!FindRecordsEnds(fn, std::vector<uint64_t>(1, numRecords), &blockOffsets) || blockOffsets[0] < 0)
+        return false;
+    *blockOffset = blockOffsets[0];
+    return true;
+}
+
+bool Checkpoint::FindRecordsEnds(const std::string& fn,
+                                 const std::vector<uint64_t>& numRecords,
+                                 std::vector<int64_t>* blockOffsets)
+{
+    blockOffsets->assign(numRecords.size(), -1);
+
+    BGZF* fp = bgzf_open(fn.c_str(), "r");
+    if (fp == nullptr)
+        return false;
+    std::ifstream in(fn, std::ios::binary);
+
+    // one pass over the records, stopping at each count in turn
+    bam_hdr_t* header = bam_hdr_read(fp);
+    bam1_t* record = bam_init1();
+    bool isReadable = (header != nullptr);
+    uint64_t numRead = 0;
+    for (size_t i = 0; isReadable && i < numRecords.size(); ++i) {
+        assert(i == 0 || numRecords[i - 1] <= numRecords[i]);
+        for ( ; isReadable && numRead < numRecords[i]; ++numRead)
+            isReadable = (bam_read1(fp, record) >= 0);
+        if (!isReadable)
+            break;
+
+        // the last record read must finish its block (a flushed checkpoint always does)
+        if (fp->block_offset != fp->block_length)
+            continue;
+
+        // already moved on to the next block
+        if (fp->block_length == 0) {
+            (*blockOffsets)[i] = fp->block_address;
+            continue;
+        }
+        int64_t blockSize = 0;
+        if (internal::ReadBlockSize(in, fp->block_address, &blockSize))
+            (*blockOffsets)[i] = fp->block_address + blockSize;
+    }
+
+    bam_destroy1(record);
+    if (header)
+        bam_hdr_destroy(header);
+    bgzf_close(fp);
+    return header != nullptr;
+}
+
+bool Checkpoint::Truncate(const std::string& fn,
+                          const int64_t blockOffset,
+                          std::string* error)
+{
+    if (truncate(fn.c_str(), static_cast<off_t>(blockOffset)) != 0) {
+        *error = "could not truncate " + fn + " to its last checkpoint";
+        return false;
+    }
+    return true;
+}
+
+bool Checkpoint::AppendRecordBlocks(const std::string& fn,
+                                    const std::string& fromFn,
+                                    std::string* error)
+{
+    // the header is flushed on its own, records start at the next block
+    int64_t firstBlockOffset = 0;
+    if (!FindRecordsEnd(fromFn, 0, &firstBlockOffset)) {
+        *error = "could not read the header of " + fromFn;
+        return false;
+    }
+
+    std::ifstream in(fromFn, std::ios::binary);
+    std::ofstream out(fn, std::ios::binary | std::ios::app);
+    if (!in.seekg(firstBlockOffset) || !out) {
+        *error = "could not append " + fromFn + " to " + fn;
+        return false;
+    }
+    out << in.rdbuf();
+    out.close();
+    if (!out) {
+        *error = "could not append " + fromFn + " to " + fn;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+// Author: Derek Barnett
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one point a conversion can be resumed from
+struct CheckpointEntry
+{
+    size_t fileIndex;          // input file being converted
+    size_t zmwIndex;           // ZMWs [0, zmwIndex) of that file are fully written
+    uint32_t holeNumber;       // last ZMW written (informational)
+    uint64_t numRecords;       // records in the main BAM so far
+    uint64_t numScrapsRecords; // records in the scraps BAM so far
+};
+
+//
+// Checkpoint keeps the resume points of a conversion (--checkpoint) in a small
+// text file next to its outputs.
+//
+// At each checkpoint the BAM writers are flushed, so the next record starts a
+// new BGZF block, & an entry is appended with the number of records written.
+// Entries may run ahead of what actually reached the disk, so a resumed run
+// reads each output once, noting where each entry's record count is reached,
+// & only trusts an entry if those records end exactly on a block boundary. The outputs are then cut
+// back to that boundary. Records converted from there on are written to a
+// continuation BAM whose blocks (minus its header) are appended verbatim when
+// it is complete, so a resumed output is byte-identical to an uninterrupted
+// run with the same checkpoint interval.
+//
+// The file also records the command-line options (minus --resume), so
+// a checkpoint is only used by a run with matching options.
+//
+class Checkpoint
+{
+public:
+    explicit Checkpoint(const std::string& filename);
+
+public:
+    const std::string& Filename(void) const;
+    const std::string& Error(void) const;
+
+    // returns false if there is no (readable) checkpoint file, a partly written last entry is dropped
+    bool Load(std::string* options, std::vector<CheckpointEntry>* entries);
+
+    // (re)writes the file with these entries, replacing any existing one
+    bool Create(const std::string& options, const std::vector<CheckpointEntry>& entries);
+
+    // appends an entry & syncs it to disk
+    bool Add(const CheckpointEntry& entry);
+
+    void Remove(void);
+
+public:
+    // BGZF block offset just past the first numRecords records of a (possibly
+    // truncated) BAM, or false if they are incomplete or don't end a block
+    static bool FindRecordsEnd(const std::string& fn,
+                               const uint64_t numRecords,
+                               int64_t* blockOffset);
+
+    // FindRecordsEnd() for each of a list of (non-decreasing) record counts, in a
+    // single pass; an offset is -1 where its records are incomplete or don't end
+    // a block. Returns false if the BAM's header can't be read.
+    static bool FindRecordsEnds(const std::string& fn,
+                                const std::vector<uint64_t>& numRecords,
+                                std::vector<int64_t>* blockOffsets);
+
+    static bool Truncate(const std::string& fn,
+                         const int64_t blockOffset,
+                         std::string* error);
+
+    // appends fromFn's blocks after its header (incl. its EOF marker) to fn
+    static bool AppendRecordBlocks(const std::string& fn,
+                                   const std::string& fromFn,
+                                   std::string* error);
+
+private:
+    std::string filename_;
+    std::string error_;
+};
+
+#endif // CHECKPOINT_H
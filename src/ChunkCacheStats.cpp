@@ -0,0 +1,59 @@
+// Author: Derek Barnett
+
+#include "ChunkCacheStats.h"
+
+ChunkCacheStats::ChunkCacheStats(void)
+    : hits_(0)
+    , misses_(0)
+{ }
+
+void ChunkCacheStats::AddDataset(const H5::DataSet& dataset, const size_t cacheBytes)
+{
+    const H5::DSetCreatPropList dcpl = dataset.getCreatePlist();
+    if (dcpl.getLayout() != H5D_CHUNKED || dcpl.getChunk(0, nullptr) != 1)
+        return;
+
+    hsize_t chunkElements = 0;
+    dcpl.getChunk(1, &chunkElements);
+    if (chunkElements == 0)
+        return;
+
+    const size_t chunkBytes = chunkElements * dataset.getDataType().getSize();
+    Dataset d;
+    d.chunkElements = chunkElements;
+    d.isCached = (chunkBytes <= cacheBytes);
+    d.hasLastChunk = false;
+    d.lastChunk = 0;
+    datasets_.push_back(d);
+}
+
+void ChunkCacheStats::Read(const uint64_t begin, const uint64_t end)
+{
+    if (end <= begin)
+        return;
+
+    for (Dataset& d : datasets_) {
+        const uint64_t firstChunk = begin / d.chunkElements;
+        const uint64_t lastChunk = (end - 1) / d.chunkElements;
+        for (uint64_t chunk = firstChunk; chunk <= lastChunk; ++chunk) {
+            if (d.isCached && d.hasLastChunk && chunk == d.lastChunk)
+                ++hits_;
+            else
+                ++misses_;
+            d.lastChunk = chunk;
+            d.hasLastChunk = true;
+        }
+    }
+}
+
+void ChunkCacheStats::ClearDatasets(void)
+{ datasets_.clear(); }
+
+bool ChunkCacheStats::HasDatasets(void) const
+{ return !datasets_.empty(); }
+
+uint64_t ChunkCacheStats::Hits(void) const
+{ return hits_; }
+
+uint64_t ChunkCacheStats::Misses(void) const
+{ return misses_; }
@@ -0,0 +1,58 @@
+// Author: Derek Barnett
+
+#ifndef CHUNKCACHESTATS_H
+#define CHUNKCACHESTATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <H5Cpp.h>
+
+//
+// ChunkCacheStats counts raw-data chunk cache hits & misses for the per-base
+// datasets of a bax.h5.
+//
+// HDF5 only reports metadata cache hits (H5Fget_mdc_hit_rate), so chunk
+// cache use is modeled from each dataset's chunk layout & the base range of
+// every ZMW read. ZMWs are read front to back, so a chunk is found in the
+// cache only if the previous ZMW already touched it, & only if the cache
+// holds at least one chunk (HDF5 reads larger chunks around the cache,
+// decompressing them again on every access).
+//
+class ChunkCacheStats
+{
+public:
+    ChunkCacheStats(void);
+
+public:
+    // registers a 1-D per-base dataset read with a chunk cache of cacheBytes,
+    // contiguous datasets (no chunk cache involved) are ignored
+    void AddDataset(const H5::DataSet& dataset, const size_t cacheBytes);
+
+    // a ZMW's bases [begin, end) were read from every registered dataset
+    void Read(const uint64_t begin, const uint64_t end);
+
+    // forgets the datasets (e.g. at the end of a file), keeps the counts
+    void ClearDatasets(void);
+
+    bool HasDatasets(void) const;
+    uint64_t Hits(void) const;
+    uint64_t Misses(void) const;
+
+private:
+    struct Dataset
+    {
+        uint64_t chunkElements;
+        bool isCached;       // chunk fits the cache
+        bool hasLastChunk;
+        uint64_t lastChunk;  // last chunk touched
+    };
+
+private:
+    std::vector<Dataset> datasets_;
+    uint64_t hits_;
+    uint64_t misses_;
+};
+
+#endif // CHUNKCACHESTATS_H
@@ -3,16 +3,22 @@
 #ifndef CONVERTERBASE_H
 #define CONVERTERBASE_H
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
-
 #include <pbbam/BamFile.h>
 #include <pbbam/BamHeader.h>
 #include <pbbam/BamWriter.h>
@@ -21,11 +27,29 @@
 #include <pbbam/Tag.h>
 
 #include <hdf/HDFBasReader.hpp>
+#include <hdf/HDFFile.hpp>
+#include <pbdata/reads/RegionTable.hpp>
+
+#include <htslib/hts.h>
 
-#include <libgen.h>
+#include <sys/stat.h>
 
+#include "BamRecordPool.h"
+#include "BufferedFileSink.h"
+#include "Checkpoint.h"
+#include "ChunkCacheStats.h"
+#include "HdfCacheConfig.h"
 #include "IConverter.h"
+#include "InputPrefetcher.h"
+#include "InputPreloader.h"
+#include "MetadataXml.h"
+#include "OutputPublisher.h"
+#include "RegionTableCursor.h"
+#include "MemoryBudget.h"
+#include "SequenceWriter.h"
 #include "Settings.h"
+#include "ZmwFeatureCache.h"
+#include "ZmwSelection.h"
 
 namespace PacBio {
 namespace BAM {
@@ -35,6 +59,21 @@ class BamRecordImpl;
 } // namespace BAM
 } // namespace PacBio
 
+// header info for one input file, gathered before any data is converted
+struct BaxFileInfo
+{
+    std::string filename;
+    std::string movieName;
+    std::string frameRateHz;
+    std::string bindingKit;
+    std::string sequencingKit;
+    std::string basecallerVersion;
+    HdfCacheConfig cacheConfig;
+    ZmwRange zmws;               // ZMWs selected for conversion
+    std::vector<int> numEvents;  // per-ZMW base counts, only read for --chunk
+    std::string error;           // why the scan failed, empty if it didn't
+};
+
 template<typename RecordType = SMRTSequence, typename HdfReader = HDFBasReader>
 class ConverterBase : public IConverter
 {
@@ -44,22 +83,48 @@ public:
 public:
     virtual bool Run(void) final;
 
+    // also write companion's mode, from this converter's single read of each ZMW
+    virtual void AddCompanion(ConverterBase* companion) final;
+
 protected:
     ConverterBase(Settings& settings);
 
-    virtual bool ConvertFile(HdfReader* reader,
-                             PacBio::BAM::BamWriter* writer) =0;
-
-    virtual bool ConvertFile(HdfReader* reader,
-                             PacBio::BAM::BamWriter* writer,
-                             PacBio::BAM::BamWriter* scrapsWriter) =0;
+    // converts the reader's selected ZMWs into writer_ (& scrapsWriter_, if open),
+    // which may be replaced between ZMWs as output parts roll over
+    virtual bool ConvertFile(HdfReader* reader) =0;
+
+    // converts one ZMW, as a companion of another mode (regionTable is null if not read)
+    virtual bool ConvertZmw(const RecordType& smrtRecord,
+                            RegionTable* regionTable,
+                            PacBio::BAM::BamWriter* writer,
+                            PacBio::BAM::BamWriter* scrapsWriter);
+    virtual bool ConvertCompanions(const RecordType& smrtRecord,
+                                   RegionTable* regionTable) final;
+
+    // --stats-only: visits the selected ZMWs using region tables & ZMW metadata only,
+    // SurveyZmw() counts the records its mode would write via SurveyRecord()
+    virtual bool SurveyFile(HdfReader* reader) final;
+    virtual bool SurveyZmw(const UInt holeNumber,
+                           const bool isSequencing,
+                           const int numBases,
+                           RegionTable* regionTable);
+    virtual void SurveyRecord(const std::string& kind,
+                              const int length,
+                              const bool isScrap) final;
 
     virtual bool ConvertRecord(const RecordType& smrtRecord,
                                const int start,
                                const int end,
                                const std::string& rgId,
+                               const bool withPulseFeatures,
                                PacBio::BAM::BamRecordImpl* bamRecord);
 
+    // checks & adds the requested per-base QVs, tags & frame data
+    virtual bool AddPulseFeatureTags(PacBio::BAM::TagCollection* tags,
+                                     const RecordType& smrtRecord,
+                                     const int start,
+                                     const int end);
+
     virtual bool WriteRecord(const RecordType& smrtRecord,
                              const int recordStart,
                              const int recordEnd,
@@ -91,6 +156,15 @@ protected:
                                     const std::string& readGroupId,
                                     PacBio::BAM::BamWriter* writer);
 
+    // writes a converted record, counting it for checkpoints
+    virtual bool WriteBamRecord(const PacBio::BAM::BamRecordImpl& bamRecord,
+                                PacBio::BAM::BamWriter* writer) final;
+
+    // FASTA/FASTQ output, in place of a main BAM record
+    virtual bool WriteSequenceRecord(const RecordType& smrtRecord,
+                                     const int recordStart,
+                                     const int recordEnd) final;
+
     virtual bool WriteSubreadRecord(const RecordType& smrtRecord,
                                     const int recordStart,
                                     const int recordEnd,
@@ -103,6 +177,9 @@ protected:
                                          const int start,
                                          const int length);
 
+    virtual std::string RecordName(const UInt holeNumber,
+                                   const int start,
+                                   const int end) const;
     virtual void AddRecordName(PacBio::BAM::BamRecordImpl* bamRecord,
                                const UInt holeNumber,
                                const int start,
@@ -113,13 +190,70 @@ protected:
                              const int start,
                              const int end);
 
+    virtual std::vector<std::string> IncludedFields(void) const;
     virtual HdfReader* InitHdfReader(void);
+    virtual HdfReader* OpenHdfReader(const std::string& baxFn,
+                                     const HdfCacheConfig& cacheConfig) final;
+    virtual void CloseHdfReader(HdfReader* reader) final;
+
+    // safe to call concurrently, HDF5 calls are serialized on scanMutex_
+    virtual bool ScanBaxFile(const std::string& baxFn, BaxFileInfo* info) final;
+    virtual bool ReadBaxHeader(const std::string& baxFn,
+                               BaxFileInfo* info,
+                               bool* hasChemistry,
+                               std::vector<UInt>* holeNumbers) final;
+    virtual void ScanBaxFiles(const std::vector<std::string>& baxFilenames,
+                              std::vector<BaxFileInfo>* infos) final;
+    virtual std::unique_ptr<PacBio::BAM::BamWriter> OpenBamWriter(const std::string& fn,
+                                                                  const PacBio::BAM::BamHeader& header,
+                                                                  const int compressionLevel,
+                                                                  const bool isStream) final;
+    virtual bool FinishBamOutput(const std::string& fn) final;
+    virtual bool InitCheckpoint(void) final;
+    virtual bool RecoverOutput(const std::string& fn) final;
+    virtual bool WriteCheckpoint(const size_t zmwIndex) final;
+    virtual void SetPartFilenames(void) final;
+    virtual bool IsPartFull(void) const final;
+    virtual bool RollOverOutputs(void) final;
+    virtual bool InitOutputs(void) final;
+    virtual void OpenOutputs(void) final;
+    virtual bool FinishOutputs(void) final;
+    virtual void TakeCompanionResults(ConverterBase* companion) final;
+    virtual bool ConvertBaxFile(const BaxFileInfo& baxFile) final;
     virtual void InitReadScores(HdfReader* reader) final;
+    virtual float ReadScore(const UInt holeNumber) final;
+    virtual float StreamedReadScore(const UInt holeNumber) final;
+    virtual ZmwFeatureCache& FeatureCache(void) final;
 
     virtual bool IsSequencingZmw(const RecordType& record) const final;
 
+    // read score & length prefilters, checked before a record is converted
+    // (-1 = length not checked). Counts the record & returns true if rejected.
+    virtual bool IsPrefiltered(const UInt holeNumber,
+                               const int hqLength,
+                               const int recordLength) final;
+    virtual void AddFilterStatistics(void) final;
+
+    virtual void InitHoleStatus(HdfReader* reader) final;
+    virtual bool InitBaseOffsets(HdfReader* reader) final;
+    virtual std::vector<H5::DataSet> PerBaseDatasets(HdfReader* reader) final;
+    virtual void InitPrefetcher(HdfReader* reader, const std::string& baxFn) final;
+    virtual void InitChunkCacheStats(HdfReader* reader, const HdfCacheConfig& cacheConfig) final;
+    virtual void PrefetchAhead(const bool keepNonSequencing) final;
+    virtual bool GetNextZmw(HdfReader* reader,
+                            RecordType& record,
+                            const bool keepNonSequencing) final;
+    virtual bool SkipZmws(HdfReader* reader,
+                          RecordType& record,
+                          const size_t numZmws) final;
+
+    // rough in-memory cost per base of a read, & whether the reader's next read fits --max-memory
+    virtual size_t ReadBytesPerBase(void) const final;
+    virtual bool IsNextReadInBudget(HdfReader* reader) final;
+
     virtual bool LoadChemistryFromMetadataXML(const std::string& baxFn,
-                                              const std::string& movieName) final;
+                                              const std::string& movieName,
+                                              BaxFileInfo* info) final;
 
     virtual std::string HeaderReadType(void) const =0;
     virtual std::string ScrapsReadType(void) const =0;
@@ -132,25 +266,98 @@ protected:
     virtual std::string ScrapsReadGroupId(void);
 
 protected:
-    std::vector<HdfReader*> readers_;
-    std::map<HdfReader*, std::string> filenameForReader_;
+    std::map<HdfReader*, std::string> filenameForReader_; // open readers only
 
+    MemoryBudget budget_;
+
+    // read scores, either preloaded or (if over budget) streamed from readScoresArray_ in
+    // blocks, alongside the matching block of hole numbers
     std::vector<float> readScores_;
-    std::map<UInt, size_t> indexForHoleNumber_; // helper table for read scores (holenumber -> vector index)
+    std::vector<std::pair<UInt, uint32_t> > readScoreIndex_; // helper table for read scores (holenumber -> dataset index), sorted
+    std::unique_ptr<HDFGroup> zmwMetricsGroup_;
+    std::unique_ptr<HDFArray<float> > readScoresArray_;
+    HDFArray<UInt>* readScoreHoleNumbersArray_; // current reader's hole numbers, if streaming
+    std::vector<UInt> readScoreHoleNumbers_;    // hole numbers of the streamed block
+    size_t readScoreBlockBegin_;                // dataset index of the streamed block
+    size_t numReadScores_;
+    bool isStreamingReadScores_;
+
+    // hole status of every ZMW in the current file, used to skip unwanted ZMWs before reading
+    std::vector<unsigned char> holeStatus_;
+    size_t zmwIndex_; // index of the reader's next ZMW
+    uint64_t numZmwsSkipped_;
+
+    // ZMWs in the current file's sample (--subsample-fraction), empty if not sampling
+    std::vector<unsigned char> isSampled_;
+    uint64_t numZmwsUnsampled_;
+
+    // ZMWs selected in the current file (--zmw-range, --chunk), others are never read
+    size_t zmwBegin_;
+    size_t zmwEnd_;
+    uint64_t numZmwsUnselected_;
+
+    // records rejected by the prefilters, & how many of those went to scraps
+    uint64_t numFilteredByReadScore_;
+    uint64_t numFilteredByHqLength_;
+    uint64_t numFilteredByLength_;
+    uint64_t numFilteredScrapped_;
+
+    // readahead for upcoming ZMWs
+    std::unique_ptr<InputPrefetcher> prefetcher_;
+    std::vector<uint64_t> baseOffsets_; // first base of each ZMW (+ total)
+    size_t prefetchedThrough_;          // ZMWs [0, prefetchedThrough_) already requested
+
+    // modeled chunk cache hits & misses, when the chunk cache is tuned (--chunk-cache*)
+    ChunkCacheStats chunkCacheStats_;
+
+    // --checkpoint: outputs are flushed every checkpointZmws ZMWs & their record counts noted.
+    // A resumed run cuts them back to the last complete checkpoint, converts the rest into
+    // "<output>.resume" files & appends those when they're done.
+    std::unique_ptr<Checkpoint> checkpoint_;
+    size_t fileIndex_;            // input file being converted
+    size_t nextCheckpointIndex_;
+    UInt lastHoleNumber_;
+    uint64_t numRecordsWritten_;  // incl. records kept from a resumed run
+    uint64_t numScrapsRecordsWritten_;
+    size_t resumeFileIndex_;
+    size_t resumeZmwIndex_;
+    bool isResumed_;
+
+    // split output (--split-by-*): 1-based part being written (0 = not split)
+    size_t partIndex_;
+    size_t numZmwsInPart_;
+
+    // chemistry from metadata.xml, by movie name (shared by all parts of a movie)
+    std::map<std::string, MetadataChemistry> metadataChemistry_;
+
+    // serializes the startup scans' HDF5 calls, chemistry lookups & metadataChemistry_
+    std::mutex scanMutex_;
+
+    // large-buffer output layers, by output filename
+    std::map<std::string, std::unique_ptr<BufferedFileSink> > sinks_;
+
+    // open outputs (closed before their sinks)
+    std::unique_ptr<PacBio::BAM::BamWriter> writer_;
+    std::unique_ptr<PacBio::BAM::BamWriter> scrapsWriter_;
+    std::unique_ptr<SequenceWriter> sequenceWriter_; // FASTA/FASTQ, instead of writer_
+    std::string recordQualities_;
+
+    // modes converted alongside this one, or the converter this one is a companion of
+    std::vector<ConverterBase*> companions_;
+    ConverterBase* primary_;
+
+    // HDF5 cache statistics
+    double mdcHitRateSum_;
+    size_t numFilesConverted_;
+
+    // BAM records are recycled through the pool once written
+    BamRecordPool recordPool_;
 
     // re-used containers
-    PacBio::BAM::BamRecordImpl bamRecord_;
     std::string recordSequence_;
-    PacBio::BAM::QualityValues recordDeletionQVs_;
-    PacBio::BAM::QualityValues recordInsertionQVs_;
-    PacBio::BAM::QualityValues recordMergeQVs_;
-    PacBio::BAM::QualityValues recordSubstitutionQVs_;
-    std::string recordDeletionTags_;
-    std::string recordSubstitutionTags_;
-    std::vector<uint16_t> recordRawIPDs_;
-    std::vector<uint8_t> recordEncodedIPDs_;
-    std::vector<uint16_t> recordRawPulseWidths_;
-    std::vector<uint8_t> recordEncodedPulseWidths_;
+
+    // tag data of the current ZMW, encoded once for all its records
+    ZmwFeatureCache featureCache_;
 
     // IPD downsampling
     std::vector<uint16_t> framepoints_;
@@ -261,22 +468,44 @@ const PacBio::BAM::Tag ConverterBase<RecordType, HdfReader>::normalZmwTag_ =
 template<typename RecordType, typename HdfReader>
 ConverterBase<RecordType, HdfReader>::ConverterBase(Settings& settings)
     : IConverter(settings)
+    , budget_(settings.maxMemory)
+    , readScoreHoleNumbersArray_(nullptr)
+    , readScoreBlockBegin_(0)
+    , numReadScores_(0)
+    , isStreamingReadScores_(false)
+    , zmwIndex_(0)
+    , numZmwsSkipped_(0)
+    , numZmwsUnsampled_(0)
+    , zmwBegin_(0)
+    , zmwEnd_(SIZE_MAX)
+    , numZmwsUnselected_(0)
+    , numFilteredByReadScore_(0)
+    , numFilteredByHqLength_(0)
+    , numFilteredByLength_(0)
+    , numFilteredScrapped_(0)
+    , prefetchedThrough_(0)
+    , fileIndex_(0)
+    , nextCheckpointIndex_(0)
+    , lastHoleNumber_(0)
+    , numRecordsWritten_(0)
+    , numScrapsRecordsWritten_(0)
+    , resumeFileIndex_(0)
+    , resumeZmwIndex_(0)
+    , isResumed_(false)
+    , partIndex_(0)
+    , numZmwsInPart_(0)
+    , mdcHitRateSum_(0.0)
+    , numFilesConverted_(0)
+    , primary_(nullptr)
+    , recordPool_(budget_.RecordPoolSize())
 { }
 
 // Destructor
 template<typename RecordType, typename HdfReader>
 ConverterBase<RecordType, HdfReader>::~ConverterBase(void)
 {
-    auto end  = readers_.end();
-    for (auto iter = readers_.begin(); iter != end; ++iter) {
-        HdfReader* r = (*iter);
-        if (r) {
-            r->Close();
-            delete r;
-            r = 0;
-        }
-    }
-    readers_.clear();
+    // readers are opened & closed per-file in ConvertBaxFile(), the only full open of each file
+    assert(filenameForReader_.empty());
 }
 
 template<typename RecordType, typename HdfReader>
@@ -297,12 +526,156 @@ std::string ConverterBase<RecordType, HdfReader>::ScrapsReadGroupId(void)
     return settings_.scrapsReadGroupId;
 }
 
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::AddCompanion(ConverterBase* companion)
+{
+    assert(companion && companion != this);
+    companion->primary_ = this;
+    companions_.push_back(companion);
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::ConvertZmw(const RecordType& smrtRecord,
+                                                      RegionTable* regionTable,
+                                                      PacBio::BAM::BamWriter* writer,
+                                                      PacBio::BAM::BamWriter* scrapsWriter)
+{
+    AddErrorMessage(HeaderReadType() + " output can't be combined with other modes");
+    return false;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::ConvertCompanions(const RecordType& smrtRecord,
+                                                             RegionTable* regionTable)
+{
+    for (ConverterBase* companion : companions_) {
+        if (!companion->ConvertZmw(smrtRecord,
+                                   regionTable,
+                                   companion->writer_.get(),
+                                   companion->scrapsWriter_.get()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::SurveyFile(HdfReader* reader)
+{
+    assert(reader);
+
+    // everything comes from per-ZMW metadata, bases are never read
+    InitReadScores(reader);
+    InitHoleStatus(reader);
+    std::vector<UInt> holeNumbers;
+    std::vector<int> numEvents;
+    try {
+        reader->zmwReader.holeNumberArray.ReadDataset(holeNumbers);
+        reader->zmwReader.numEventArray.ReadDataset(numEvents);
+    } catch (H5::Exception&) {
+        AddErrorMessage("could not read ZMW table of " + filenameForReader_[reader]);
+        return false;
+    }
+
+    // region table, if the file has one (modes that need it report its absence)
+    RegionTableCursor regionTableCursor(budget_.RegionWindowSize(), budget_.RegionBlockSize());
+    const bool hasRegions = regionTableCursor.Initialize(reader->pulseDataGroup);
+
+    const bool keepNonSequencing = settings_.isInternal && !settings_.scrapsBamFilename.empty();
+    const size_t endIndex = std::min(std::min(holeNumbers.size(), numEvents.size()), zmwEnd_);
+    if (zmwBegin_ > 0)
+        numZmwsUnselected_ += std::min(zmwBegin_, endIndex);
+    for (size_t i = zmwBegin_; i < endIndex; ++i) {
+
+        if (!isSampled_.empty() && isSampled_[i] == 0) {
+            ++numZmwsUnsampled_;
+            continue;
+        }
+
+        RegionTable* regionTable = nullptr;
+        try {
+            if (hasRegions)
+                regionTable = &regionTableCursor.Seek(holeNumbers[i]);
+        } catch (std::runtime_error& e) {
+            AddErrorMessage(std::string(e.what()));
+            return false;
+        }
+
+        // non-sequencing ZMWs are only converted into internal-mode scraps
+        const bool isSequencing = holeStatus_.empty() || holeStatus_[i] == 0;
+        if (!isSequencing && !keepNonSequencing) {
+            ++numZmwsSkipped_;
+            continue;
+        }
+
+        if (!SurveyZmw(holeNumbers[i], isSequencing, numEvents[i], regionTable))
+            return false;
+        for (ConverterBase* companion : companions_) {
+            if (!companion->SurveyZmw(holeNumbers[i], isSequencing, numEvents[i], regionTable))
+                return false;
+        }
+    }
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::SurveyZmw(const UInt holeNumber,
+                                                     const bool isSequencing,
+                                                     const int numBases,
+                                                     RegionTable* regionTable)
+{
+    AddErrorMessage("--stats-only is not supported for " + HeaderReadType() + " output");
+    return false;
+}
+
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::SurveyRecord(const std::string& kind,
+                                                        const int length,
+                                                        const bool isScrap)
+{
+    // per-record overhead of the output formats, approximately
+    static const size_t BamFixedBytes = 36;     // block size & fixed-length core fields
+    static const size_t NameSuffixBytes = 24;   // "/<hole number>/<start>_<end>" & its NUL, after the movie name
+    static const size_t BamTagBytes = 96;       // RG, zm, qs/qe, np, cx, rq, sn, ... as written
+    static const size_t FastxMarkupBytes = 4;   // '>' or '@', '+' & newlines
+
+    const std::string type = HeaderReadType();
+    AddStatistic(type + " " + kind + "s", 1);
+    AddStatistic(type + " " + kind + " bases", length);
+
+    // uncompressed size of the record as written: fixed fields, name & tags, then per-base data
+    const size_t nameBytes = settings_.movieName.size() + NameSuffixBytes;
+    uint64_t bytes = 0;
+    if (settings_.outputFormat == Settings::BamFormat) {
+        size_t bytesPerBase = 2; // 4-bit bases, rounded up, & the (empty) qualities
+        if (!isScrap || !settings_.isLeanScraps) {
+            if (settings_.usingDeletionQV)      ++bytesPerBase;
+            if (settings_.usingDeletionTag)     ++bytesPerBase;
+            if (settings_.usingInsertionQV)     ++bytesPerBase;
+            if (settings_.usingMergeQV)         ++bytesPerBase;
+            if (settings_.usingSubstitutionQV)  ++bytesPerBase;
+            if (settings_.usingSubstitutionTag) ++bytesPerBase;
+            if (settings_.usingIPD)             bytesPerBase += (settings_.losslessFrames ? 2 : 1);
+            if (settings_.usingPulseWidth)      bytesPerBase += (settings_.losslessFrames ? 2 : 1);
+        }
+        bytes = BamFixedBytes + nameBytes + BamTagBytes + bytesPerBase * length;
+    } else {
+        const size_t copies = (settings_.outputFormat == Settings::FastqFormat) ? 2 : 1;
+        bytes = nameBytes + FastxMarkupBytes + copies * length;
+    }
+    AddStatistic(isScrap ? "estimated scraps bytes (" + type + ", uncompressed)"
+                         : "estimated output bytes (" + type + ", uncompressed)",
+                 bytes);
+}
+
 template<typename RecordType, typename HdfReader>
 bool ConverterBase<RecordType, HdfReader>::ConvertRecord(
         const RecordType& smrtRead,
         const int subreadStart,
         const int subreadEnd,
         const std::string& rgId,
+        const bool withPulseFeatures,
         PacBio::BAM::BamRecordImpl* bamRecord)
 {
     using namespace PacBio;
@@ -320,6 +693,45 @@ bool ConverterBase<RecordType, HdfReader>::ConvertRecord(
     // NOTE - qualities are empty (per PacBio BAM spec)
     SetSequenceAndQualities(bamRecord, smrtRead, subreadStart, length);
 
+    TagCollection tags;
+    tags[Tag_RG] = rgId;
+    tags[Tag_zm] = static_cast<int32_t>(holeNumber);
+
+    // HQRegionSNR, TODO: should I do this in AddModeTags?
+    if (HeaderReadType() != "CCS")
+    {
+        // Stored as 'ACGT' in BAM, no fixed order in SMRTSequence
+        std::vector<float> hqSnr = { smrtRead.HQRegionSnr('A'),
+                                smrtRead.HQRegionSnr('C'),
+                                smrtRead.HQRegionSnr('G'),
+                                smrtRead.HQRegionSnr('T')};
+        tags[Tag_sn] = hqSnr;
+    }
+
+    AddModeTags(&tags, smrtRead, subreadStart, subreadEnd);
+
+    tags[Tag_rq] = ReadScore(holeNumber);
+
+    // per-base data, left out of lean scraps
+    if (withPulseFeatures && !AddPulseFeatureTags(&tags, smrtRead, subreadStart, subreadEnd))
+        return false;
+
+    bamRecord->Tags(tags);
+
+    // if we get here, everything should be OK
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::AddPulseFeatureTags(
+        PacBio::BAM::TagCollection* tags,
+        const RecordType& smrtRead,
+        const int subreadStart,
+        const int subreadEnd)
+{
+    const UInt holeNumber  = smrtRead.zmwData.holeNumber;
+    const DNALength length = subreadEnd - subreadStart;
+
     // check settings/existence of *QV/*Tag data
     if (settings_.usingDeletionQV && smrtRead.deletionQV.Empty())
     {
@@ -369,99 +781,36 @@ bool ConverterBase<RecordType, HdfReader>::ConvertRecord(
         return false;
     }
 
-    // fetch *QV/*Tag data
-    if (settings_.usingDeletionQV) {
-        recordDeletionQVs_.assign((uint8_t*)smrtRead.deletionQV.data + subreadStart,
-                                  (uint8_t*)smrtRead.deletionQV.data + subreadStart + length);
-    }
-    if (settings_.usingInsertionQV) {
-        recordInsertionQVs_.assign((uint8_t*)smrtRead.insertionQV.data + subreadStart,
-                                   (uint8_t*)smrtRead.insertionQV.data + subreadStart + length);
-    }
-    if (settings_.usingMergeQV) {
-        recordMergeQVs_.assign((uint8_t*)smrtRead.mergeQV.data + subreadStart,
-                               (uint8_t*)smrtRead.mergeQV.data + subreadStart + length);
-    }
-    if (settings_.usingSubstitutionQV) {
-        recordSubstitutionQVs_.assign((uint8_t*)smrtRead.substitutionQV.data + subreadStart,
-                                      (uint8_t*)smrtRead.substitutionQV.data + subreadStart + length);
-    }
-    if (settings_.usingDeletionTag) {
-        recordDeletionTags_.assign((char*)smrtRead.deletionTag + subreadStart,
-                                   (char*)smrtRead.deletionTag + subreadStart + length);
-    }
-    if (settings_.usingSubstitutionTag) {
-        recordSubstitutionTags_.assign((char*)smrtRead.substitutionTag + subreadStart,
-                                       (char*)smrtRead.substitutionTag + subreadStart + length);
-    }
-
-    // fetch IPDs, then maybe encode
-    if (settings_.usingIPD) {
-        recordRawIPDs_.assign((uint16_t*)smrtRead.preBaseFrames + subreadStart,
-                              (uint16_t*)smrtRead.preBaseFrames + subreadStart + length);
-
-        // if not using full data, encode
-        if (!settings_.losslessFrames)
-            recordEncodedIPDs_ = std::move(Frames::Encode(recordRawIPDs_));
-    }
-
-    // fetch PulseWidths, then maybe encode
-    if (settings_.usingPulseWidth) {
-        recordRawPulseWidths_.assign((uint16_t*)smrtRead.widthInFrames + subreadStart,
-                                     (uint16_t*)smrtRead.widthInFrames + subreadStart + length);
-
-        // if not using full data, encode
-        if (!settings_.losslessFrames)
-            recordEncodedPulseWidths_ = std::move(Frames::Encode(recordRawPulseWidths_));
-    }
-
-    TagCollection tags;
-    tags[Tag_RG] = rgId;
-    tags[Tag_zm] = static_cast<int32_t>(holeNumber);
-
-    // HQRegionSNR, TODO: should I do this in AddModeTags?
-    if (HeaderReadType() != "CCS")
-    {
-        // Stored as 'ACGT' in BAM, no fixed order in SMRTSequence
-        std::vector<float> hqSnr = { smrtRead.HQRegionSnr('A'),
-                                smrtRead.HQRegionSnr('C'),
-                                smrtRead.HQRegionSnr('G'),
-                                smrtRead.HQRegionSnr('T')};
-        tags[Tag_sn] = hqSnr;
-    }
-
-    AddModeTags(&tags, smrtRead, subreadStart, subreadEnd);
-
-    if (!readScores_.empty())
-        tags[Tag_rq] = static_cast<float>(readScores_.at(indexForHoleNumber_[holeNumber]));
-    else
-        tags[Tag_rq] = static_cast<float>(0.0f);
+    // full-read encodings are shared by every record of this ZMW (& by any companion modes)
+    ZmwFeatureCache& features = FeatureCache();
+    if (!features.IsFor(holeNumber))
+        features.Encode(smrtRead, settings_);
 
-    if (settings_.usingDeletionQV)      tags[Tag_dq] = recordDeletionQVs_.Fastq();
-    if (settings_.usingDeletionTag)     tags[Tag_dt] = recordDeletionTags_;
-    if (settings_.usingInsertionQV)     tags[Tag_iq] = recordInsertionQVs_.Fastq();
-    if (settings_.usingMergeQV)         tags[Tag_mq] = recordMergeQVs_.Fastq();
-    if (settings_.usingSubstitutionQV)  tags[Tag_sq] = recordSubstitutionQVs_.Fastq();
-    if (settings_.usingSubstitutionTag) tags[Tag_st] = recordSubstitutionTags_;
+    if (settings_.usingDeletionQV)      (*tags)[Tag_dq] = features.deletionQVs.substr(subreadStart, length);
+    if (settings_.usingDeletionTag)     (*tags)[Tag_dt] = features.deletionTags.substr(subreadStart, length);
+    if (settings_.usingInsertionQV)     (*tags)[Tag_iq] = features.insertionQVs.substr(subreadStart, length);
+    if (settings_.usingMergeQV)         (*tags)[Tag_mq] = features.mergeQVs.substr(subreadStart, length);
+    if (settings_.usingSubstitutionQV)  (*tags)[Tag_sq] = features.substitutionQVs.substr(subreadStart, length);
+    if (settings_.usingSubstitutionTag) (*tags)[Tag_st] = features.substitutionTags.substr(subreadStart, length);
 
     if (settings_.usingIPD) {
         if (settings_.losslessFrames)
-            tags[Tag_ip] = recordRawIPDs_;
+            (*tags)[Tag_ip] = std::vector<uint16_t>(features.rawIPDs.cbegin() + subreadStart,
+                                                    features.rawIPDs.cbegin() + subreadEnd);
         else
-            tags[Tag_ip] = recordEncodedIPDs_;
-
+            (*tags)[Tag_ip] = std::vector<uint8_t>(features.encodedIPDs.cbegin() + subreadStart,
+                                                   features.encodedIPDs.cbegin() + subreadEnd);
     }
 
     if (settings_.usingPulseWidth) {
         if (settings_.losslessFrames)
-            tags[Tag_pw] = recordRawPulseWidths_;
+            (*tags)[Tag_pw] = std::vector<uint16_t>(features.rawPulseWidths.cbegin() + subreadStart,
+                                                    features.rawPulseWidths.cbegin() + subreadEnd);
         else
-            tags[Tag_pw] = recordEncodedPulseWidths_;
+            (*tags)[Tag_pw] = std::vector<uint8_t>(features.encodedPulseWidths.cbegin() + subreadStart,
+                                                   features.encodedPulseWidths.cbegin() + subreadEnd);
     }
 
-    bamRecord->Tags(tags);
-
-    // if we get here, everything should be OK
     return true;
 }
 
@@ -472,25 +821,24 @@ bool ConverterBase<RecordType, HdfReader>::WriteRecord(const RecordType& smrtRec
                                                        const std::string& readGroupId,
                                                        PacBio::BAM::BamWriter* writer)
 {
+    // sequence-only output skips the BAM record entirely
+    if (sequenceWriter_)
+        return WriteSequenceRecord(smrtRecord, recordStart, recordEnd);
+
     // attempt convert BAX to BAM
+    BamRecordPool::Lease bamRecord = recordPool_.Acquire();
     if (!ConvertRecord(smrtRecord,
                        recordStart,
                        recordEnd,
                        readGroupId,
-                       &bamRecord_))
+                       true,
+                       bamRecord.get()))
     {
         return false;
     }
 
     // attempt write BAM to file
-    try {
-        writer->Write(bamRecord_);
-    } catch (std::exception&) {
-        AddErrorMessage("failed to write BAM record");
-        return false;
-    }
-
-    return true;
+    return WriteBamRecord(*bamRecord, writer);
 }
 
 template<typename RecordType, typename HdfReader>
@@ -501,36 +849,31 @@ bool ConverterBase<RecordType, HdfReader>::WriteFilteredRecord(const RecordType&
                                                                PacBio::BAM::BamWriter* writer)
 {
     // attempt convert BAX to BAM
+    BamRecordPool::Lease bamRecord = recordPool_.Acquire();
     if (!ConvertRecord(smrtRecord,
                        recordStart,
                        recordEnd,
                        readGroupId,
-                       &bamRecord_))
+                       !settings_.isLeanScraps,
+                       bamRecord.get()))
     {
         return false;
     }
 
     // add scrap tags
-    if (!bamRecord_.AddTag(Tag_sz, normalZmwTag_))
+    if (!bamRecord->AddTag(Tag_sz, normalZmwTag_))
     {
         AddErrorMessage("failed to add scrap's zmw classification tag");
         return false;
     }
-    if (!bamRecord_.AddTag(Tag_sc, filteredTag_))
+    if (!bamRecord->AddTag(Tag_sc, filteredTag_))
     {
         AddErrorMessage("failed to add scrap's filtered tag");
         return false;
     }
 
     // attempt write BAM to file
-    try {
-        writer->Write(bamRecord_);
-    } catch (std::exception&) {
-        AddErrorMessage("failed to write BAM record");
-        return false;
-    }
-
-    return true;
+    return WriteBamRecord(*bamRecord, writer);
 }
 
 template<typename RecordType, typename HdfReader>
@@ -542,43 +885,38 @@ bool ConverterBase<RecordType, HdfReader>::WriteFilteredRecord(const RecordType&
                                                                PacBio::BAM::BamWriter* writer)
 {
     // attempt convert BAX to BAM
+    BamRecordPool::Lease bamRecord = recordPool_.Acquire();
     if (!ConvertRecord(smrtRecord,
                        recordStart,
                        recordEnd,
                        readGroupId,
-                       &bamRecord_))
+                       !settings_.isLeanScraps,
+                       bamRecord.get()))
     {
         return false;
     }
 
     // add scrap tags
-    if (!bamRecord_.AddTag(Tag_sz, normalZmwTag_))
+    if (!bamRecord->AddTag(Tag_sz, normalZmwTag_))
     {
         AddErrorMessage("failed to add scrap's zmw classification tag");
         return false;
     }
-    if (!bamRecord_.AddTag(Tag_sc, filteredTag_))
+    if (!bamRecord->AddTag(Tag_sc, filteredTag_))
     {
         AddErrorMessage("failed to add scrap's filtered tag");
         return false;
     }
 
     // add context tag
-    if (!bamRecord_.AddTag(Tag_cx, contextFlags))
+    if (!bamRecord->AddTag(Tag_cx, contextFlags))
     {
         AddErrorMessage("failed to add context flag tag");
         return false;
     }
 
     // attempt write BAM to file
-    try {
-        writer->Write(bamRecord_);
-    } catch (std::exception&) {
-        AddErrorMessage("failed to write BAM record");
-        return false;
-    }
-
-    return true;
+    return WriteBamRecord(*bamRecord, writer);
 }
 
 template<typename RecordType, typename HdfReader>
@@ -589,36 +927,31 @@ bool ConverterBase<RecordType, HdfReader>::WriteLowQualityRecord(const RecordTyp
                                                                  PacBio::BAM::BamWriter* writer)
 {
     // attempt convert BAX to BAM
+    BamRecordPool::Lease bamRecord = recordPool_.Acquire();
     if (!ConvertRecord(smrtRecord,
                        recordStart,
                        recordEnd,
                        readGroupId,
-                       &bamRecord_))
+                       !settings_.isLeanScraps,
+                       bamRecord.get()))
     {
         return false;
     }
 
     // add scrap tags
-    if (!bamRecord_.AddTag(Tag_sz, normalZmwTag_))
+    if (!bamRecord->AddTag(Tag_sz, normalZmwTag_))
     {
         AddErrorMessage("failed to add scrap's zmw classification tag");
         return false;
     }
-    if (!bamRecord_.AddTag(Tag_sc, lowQualityTag_))
+    if (!bamRecord->AddTag(Tag_sc, lowQualityTag_))
     {
         AddErrorMessage("failed to add scrap's low-quality region tag");
         return false;
     }
 
     // attempt write BAM to file
-    try {
-        writer->Write(bamRecord_);
-    } catch (std::exception&) {
-        AddErrorMessage("failed to write BAM record");
-        return false;
-    }
-
-    return true;
+    return WriteBamRecord(*bamRecord, writer);
 }
 
 template<typename RecordType, typename HdfReader>
@@ -629,35 +962,79 @@ bool ConverterBase<RecordType, HdfReader>::WriteAdapterRecord(const RecordType&
                                                               PacBio::BAM::BamWriter* writer)
 {
     // attempt convert BAX to BAM
+    BamRecordPool::Lease bamRecord = recordPool_.Acquire();
     if (!ConvertRecord(smrtRecord,
                        recordStart,
                        recordEnd,
                        readGroupId,
-                       &bamRecord_))
+                       !settings_.isLeanScraps,
+                       bamRecord.get()))
     {
         return false;
     }
 
     // add scrap tags
-    if (!bamRecord_.AddTag(Tag_sz, normalZmwTag_))
+    if (!bamRecord->AddTag(Tag_sz, normalZmwTag_))
     {
         AddErrorMessage("failed to add scrap's zmw classification tag");
         return false;
     }
-    if (!bamRecord_.AddTag(Tag_sc, adapterTag_))
+    if (!bamRecord->AddTag(Tag_sc, adapterTag_))
     {
         AddErrorMessage("failed to add scrap's adapter tag");
         return false;
     }
 
     // attempt write BAM to file
+    return WriteBamRecord(*bamRecord, writer);
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::WriteBamRecord(const PacBio::BAM::BamRecordImpl& bamRecord,
+                                                          PacBio::BAM::BamWriter* writer)
+{
     try {
-        writer->Write(bamRecord_);
+        writer->Write(bamRecord);
     } catch (std::exception&) {
         AddErrorMessage("failed to write BAM record");
         return false;
     }
 
+    if (writer == writer_.get())
+        ++numRecordsWritten_;
+    else if (writer == scrapsWriter_.get())
+        ++numScrapsRecordsWritten_;
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::WriteSequenceRecord(const RecordType& smrtRecord,
+                                                               const int recordStart,
+                                                               const int recordEnd)
+{
+    assert(sequenceWriter_);
+    const int length = recordEnd - recordStart;
+
+    // FASTQ qualities, QVs capped at the printable range
+    recordQualities_.clear();
+    if (settings_.outputFormat == Settings::FastqFormat) {
+        if (smrtRecord.qual.Empty()) {
+            AddErrorMessage("QualityValue requested but unavailable");
+            return false;
+        }
+        recordQualities_.reserve(length);
+        for (int i = recordStart; i < recordEnd; ++i)
+            recordQualities_.push_back(static_cast<char>(std::min<int>(smrtRecord.qual.data[i], 93) + 33));
+    }
+
+    if (!sequenceWriter_->Write(RecordName(smrtRecord.zmwData.holeNumber, recordStart, recordEnd),
+                                reinterpret_cast<const char*>(smrtRecord.seq) + recordStart,
+                                length,
+                                recordQualities_))
+    {
+        AddErrorMessage(sequenceWriter_->Error());
+        return false;
+    }
     return true;
 }
 
@@ -669,32 +1046,31 @@ bool ConverterBase<RecordType, HdfReader>::WriteSubreadRecord(const RecordType&
                                                               const uint8_t contextFlags,
                                                               PacBio::BAM::BamWriter* writer)
 {
+    // sequence-only output skips the BAM record entirely
+    if (sequenceWriter_)
+        return WriteSequenceRecord(smrtRecord, recordStart, recordEnd);
+
     // attempt convert BAX to BAM
+    BamRecordPool::Lease bamRecord = recordPool_.Acquire();
     if (!ConvertRecord(smrtRecord,
                        recordStart,
                        recordEnd,
                        readGroupId,
-                       &bamRecord_))
+                       true,
+                       bamRecord.get()))
     {
         return false;
     }
 
     // Try to add the additional tag supplied by the caller
-    if (!bamRecord_.AddTag(Tag_cx, contextFlags))
+    if (!bamRecord->AddTag(Tag_cx, contextFlags))
     {
         AddErrorMessage("failed to add context flag tag");
         return false;
     }
 
     // attempt write BAM to file
-    try {
-        writer->Write(bamRecord_);
-    } catch (std::exception&) {
-        AddErrorMessage("failed to write BAM record");
-        return false;
-    }
-
-    return true;
+    return WriteBamRecord(*bamRecord, writer);
 }
 
 template<typename RecordType, typename HdfReader>
@@ -708,19 +1084,24 @@ void ConverterBase<RecordType, HdfReader>::SetSequenceAndQualities(
     bamRecord->SetSequenceAndQualities(recordSequence_);
 }
 
+template<typename RecordType, typename HdfReader>
+std::string ConverterBase<RecordType, HdfReader>::RecordName(const UInt holeNumber,
+                                                             const int start,
+                                                             const int end) const
+{
+    return settings_.movieName + "/"
+           + std::to_string(holeNumber) + "/"
+           + std::to_string(start) + "_"
+           + std::to_string(end);
+}
+
 template<typename RecordType, typename HdfReader>
 void ConverterBase<RecordType, HdfReader>::AddRecordName(
         PacBio::BAM::BamRecordImpl* bamRecord,
         const UInt holeNumber,
         const int start,
         const int end)
-{
-    const std::string name = settings_.movieName + "/"
-                      + std::to_string(holeNumber) + "/"
-                      + std::to_string(start) + "_"
-                      + std::to_string(end);
-    bamRecord->Name(name);
-}
+{ bamRecord->Name(RecordName(holeNumber, start, end)); }
 
 template<typename RecordType, typename HdfReader>
 void ConverterBase<RecordType, HdfReader>::AddModeTags(
@@ -734,23 +1115,82 @@ void ConverterBase<RecordType, HdfReader>::AddModeTags(
     (*tags)["np"] = static_cast<int32_t>(1);
 }
 
+template<typename RecordType, typename HdfReader>
+std::vector<std::string> ConverterBase<RecordType, HdfReader>::IncludedFields(void) const
+{
+    std::vector<std::string> fields;
+    fields.push_back("Basecall");
+
+    // --stats-only reads ZMW metadata, region tables & read scores, none of which need a field
+    if (settings_.isStatsOnly)
+        return fields;
+
+    if (settings_.outputFormat == Settings::FastqFormat) {
+        fields.push_back("QualityValue");
+        return fields;
+    }
+    if (settings_.outputFormat == Settings::FastaFormat)
+        return fields;
+    if (HeaderReadType() != "CCS")      fields.push_back("HQRegionSNR");
+    if (settings_.usingDeletionQV)      fields.push_back("DeletionQV");
+    if (settings_.usingDeletionTag)     fields.push_back("DeletionTag");
+    if (settings_.usingInsertionQV)     fields.push_back("InsertionQV");
+    if (settings_.usingIPD)             fields.push_back("PreBaseFrames");
+    if (settings_.usingMergeQV)         fields.push_back("MergeQV");
+    if (settings_.usingPulseWidth)      fields.push_back("WidthInFrames");
+    if (settings_.usingSubstitutionQV)  fields.push_back("SubstitutionQV");
+    if (settings_.usingSubstitutionTag) fields.push_back("SubstitutionTag");
+    return fields;
+}
+
 template<typename RecordType, typename HdfReader>
 HdfReader* ConverterBase<RecordType, HdfReader>::InitHdfReader(void)
 {
     HdfReader* reader = new HdfReader;
-    reader->IncludeField("Basecall");
-    if (HeaderReadType() != "CCS")      reader->IncludeField("HQRegionSNR");
-    if (settings_.usingDeletionQV)      reader->IncludeField("DeletionQV");
-    if (settings_.usingDeletionTag)     reader->IncludeField("DeletionTag");
-    if (settings_.usingInsertionQV)     reader->IncludeField("InsertionQV");
-    if (settings_.usingIPD)             reader->IncludeField("PreBaseFrames");
-    if (settings_.usingMergeQV)         reader->IncludeField("MergeQV");
-    if (settings_.usingPulseWidth)      reader->IncludeField("WidthInFrames");
-    if (settings_.usingSubstitutionQV)  reader->IncludeField("SubstitutionQV");
-    if (settings_.usingSubstitutionTag) reader->IncludeField("SubstitutionTag");
+    for (const std::string& field : IncludedFields())
+        reader->IncludeField(field);
+    return reader;
+}
+
+template<typename RecordType, typename HdfReader>
+HdfReader* ConverterBase<RecordType, HdfReader>::OpenHdfReader(const std::string& baxFn,
+                                                                const HdfCacheConfig& cacheConfig)
+{
+    H5::FileAccPropList fapl;
+    std::string error;
+    if (!cacheConfig.FileAccessProperties(&fapl, &error)) {
+        AddErrorMessage(error + " for " + baxFn);
+        return nullptr;
+    }
+
+    HdfReader* reader = InitHdfReader();
+    if (!reader->Initialize(baxFn, fapl)) {
+        delete reader;
+        return nullptr;
+    }
+    filenameForReader_[reader] = baxFn;
     return reader;
 }
 
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::CloseHdfReader(HdfReader* reader)
+{
+    assert(reader);
+
+    // release any handles into this file first, HDF5 keeps the file open until they're gone
+    readScoresArray_.reset();
+    zmwMetricsGroup_.reset();
+    if (prefetcher_) {
+        prefetcher_->Close();
+        AddStatistic("bytes prefetched", prefetcher_->BytesPrefetched());
+        prefetcher_.reset();
+    }
+
+    filenameForReader_.erase(reader);
+    reader->Close();
+    delete reader;
+}
+
 template<typename RecordType, typename HdfReader>
 void ConverterBase<RecordType, HdfReader>::InitReadScores(HdfReader* reader)
 {
@@ -758,208 +1198,1013 @@ void ConverterBase<RecordType, HdfReader>::InitReadScores(HdfReader* reader)
 
     // fetch read scores
     readScores_.clear();
+    readScoreIndex_.clear();
+    readScoresArray_.reset();
+    zmwMetricsGroup_.reset();
+    readScoreHoleNumbersArray_ = nullptr;
+    readScoreHoleNumbers_.clear();
+    readScoreBlockBegin_ = 0;
+    numReadScores_ = 0;
+    isStreamingReadScores_ = false;
+
+    size_t numScores = 0;
     if (reader->baseCallsGroup.ContainsObject("ZMWMetrics")) {
-        HDFGroup zmwMetricsGroup;
-        if (zmwMetricsGroup.Initialize(reader->baseCallsGroup.group, "ZMWMetrics")) {
-            if (zmwMetricsGroup.ContainsObject("ReadScore")) {
-                HDFArray<float> readScoresArray;
-                if (readScoresArray.InitializeForReading(zmwMetricsGroup, "ReadScore"))
-                    readScoresArray.ReadDataset(readScores_);
+        zmwMetricsGroup_.reset(new HDFGroup);
+        if (zmwMetricsGroup_->Initialize(reader->baseCallsGroup.group, "ZMWMetrics")) {
+            if (zmwMetricsGroup_->ContainsObject("ReadScore")) {
+                readScoresArray_.reset(new HDFArray<float>);
+                if (readScoresArray_->InitializeForReading(*zmwMetricsGroup_, "ReadScore")) {
+                    numScores = readScoresArray_->dataset.getSpace().getSimpleExtentNpoints();
+
+                    // keep scores resident only if they fit the memory budget
+                    if (budget_.CanPreloadReadScores(numScores)) {
+                        readScoresArray_->ReadDataset(readScores_);
+                        numScores = readScores_.size();
+                    } else {
+                        isStreamingReadScores_ = true;
+                        readScoreHoleNumbersArray_ = &reader->zmwReader.holeNumberArray;
+                        numReadScores_ = numScores;
+                    }
+                }
             }
         }
     }
 
-    // init holenumber -> index lookup
-    indexForHoleNumber_.clear();
-    if (!readScores_.empty()) {
-        for (size_t i = 0; i < readScores_.size(); ++i) {
+    // init holenumber -> index lookup (streamed scores are looked up per block instead)
+    if (numScores > 0 && !isStreamingReadScores_) {
+        readScoreIndex_.reserve(numScores);
+        for (size_t i = 0; i < numScores; ++i) {
             UInt holeNumber;
             reader->zmwReader.GetHoleNumberAt(i, holeNumber);
-            indexForHoleNumber_[holeNumber] = i;
+            readScoreIndex_.emplace_back(holeNumber, static_cast<uint32_t>(i));
         }
+        std::sort(readScoreIndex_.begin(), readScoreIndex_.end());
     }
 }
 
 template<typename RecordType, typename HdfReader>
-bool ConverterBase<RecordType, HdfReader>::IsSequencingZmw(const RecordType& record) const
-{ return record.zmwData.holeStatus == 0; }
+float ConverterBase<RecordType, HdfReader>::ReadScore(const UInt holeNumber)
+{
+    // companions see the primary's file
+    if (primary_)
+        return primary_->ReadScore(holeNumber);
+
+    if (isStreamingReadScores_)
+        return StreamedReadScore(holeNumber);
+
+    const auto iter = std::lower_bound(readScoreIndex_.cbegin(),
+                                       readScoreIndex_.cend(),
+                                       std::make_pair(holeNumber, static_cast<uint32_t>(0)));
+    if (iter == readScoreIndex_.cend() || iter->first != holeNumber)
+        return 0.0f;
+    return readScores_.at(iter->second);
+}
 
 template<typename RecordType, typename HdfReader>
-bool ConverterBase<RecordType, HdfReader>::LoadChemistryFromMetadataXML(
-        const std::string& baxFn,
-        const std::string& movieName)
+float ConverterBase<RecordType, HdfReader>::StreamedReadScore(const UInt holeNumber)
 {
-    using boost::property_tree::ptree;
-
-    // get the absolute path of the bax.h5 file and go up 2 directories
-    char buf[PATH_MAX + 1];
-    char *res = realpath(baxFn.c_str(), buf);
-
-    if (res == nullptr)
-        return false;
-
-    // up 1
-    res = dirname(res);
-
-    if (res == nullptr)
-        return false;
+    assert(readScoreHoleNumbersArray_);
 
-    // up 2
-    res = dirname(res);
-
-    if (res == nullptr)
-        return false;
-
-    std::string prefix(res);
-    std::string path = prefix + '/' + movieName + ".metadata.xml";
-    ptree pt;
+    // ZMWs are stored (& converted) in hole number order, so lookups move forward
+    // through the file. Start over if one ever goes back.
+    if (!readScoreHoleNumbers_.empty() && holeNumber < readScoreHoleNumbers_.front()) {
+        readScoreHoleNumbers_.clear();
+        readScoreBlockBegin_ = 0;
+    }
 
-    try
-    {
-        read_xml(path, pt);
+    while (readScoreHoleNumbers_.empty() || holeNumber > readScoreHoleNumbers_.back()) {
+        const size_t begin = readScoreBlockBegin_ + readScoreHoleNumbers_.size();
+        if (begin >= numReadScores_)
+            return 0.0f;
+        const size_t end = std::min(begin + budget_.ReadScoreBlockSize(), numReadScores_);
+        readScoreHoleNumbers_.resize(end - begin);
+        readScores_.resize(end - begin);
+        readScoreHoleNumbersArray_->Read(begin, end, readScoreHoleNumbers_.data());
+        readScoresArray_->Read(begin, end, readScores_.data());
+        readScoreBlockBegin_ = begin;
+    }
 
-        bindingKit_        = pt.get<std::string>("Metadata.BindingKit.PartNumber");
-        sequencingKit_     = pt.get<std::string>("Metadata.SequencingKit.PartNumber");
-        basecallerVersion_ = pt.get<std::string>("Metadata.InstCtrlVer");
+    const auto iter = std::lower_bound(readScoreHoleNumbers_.cbegin(),
+                                       readScoreHoleNumbers_.cend(),
+                                       holeNumber);
+    if (iter == readScoreHoleNumbers_.cend() || *iter != holeNumber)
+        return 0.0f;
+    return readScores_.at(static_cast<size_t>(iter - readScoreHoleNumbers_.cbegin()));
+}
 
-        if (!settings_.isIgnoringChemistryCheck) {
+template<typename RecordType, typename HdfReader>
+ZmwFeatureCache& ConverterBase<RecordType, HdfReader>::FeatureCache(void)
+{ return primary_ ? primary_->FeatureCache() : featureCache_; }
 
-            // throws if invalid chemistry triple
-            // we'll take the opportunity to exit early with error message
-            using PacBio::BAM::ReadGroupInfo;
-            auto chemistryCheck = ReadGroupInfo::SequencingChemistryFromTriple(bindingKit_,
-                                                                               sequencingKit_,
-                                                                               basecallerVersion_);
-        }
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::IsSequencingZmw(const RecordType& record) const
+{ return record.zmwData.holeStatus == 0; }
 
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::IsPrefiltered(const UInt holeNumber,
+                                                         const int hqLength,
+                                                         const int recordLength)
+{
+    if (settings_.minReadScore > 0.0f && ReadScore(holeNumber) < settings_.minReadScore) {
+        ++numFilteredByReadScore_;
         return true;
     }
-    catch (PacBio::BAM::InvalidSequencingChemistryException& e) {
-        AddErrorMessage(e.what());
-        return false;
+    if (hqLength >= 0 && static_cast<size_t>(hqLength) < settings_.minHqLength) {
+        ++numFilteredByHqLength_;
+        return true;
     }
-    catch (...)
-    { }
+    if (recordLength >= 0 && static_cast<size_t>(recordLength) < settings_.minSubreadLength) {
+        ++numFilteredByLength_;
+        return true;
+    }
+    return false;
+}
+
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::AddFilterStatistics(void)
+{
+    const std::string type = HeaderReadType();
+    if (settings_.minReadScore > 0.0f)
+        AddStatistic(type + " records filtered by read score", numFilteredByReadScore_);
+    if (settings_.minHqLength > 0)
+        AddStatistic(type + " records filtered by HQ region length", numFilteredByHqLength_);
+    if (settings_.minSubreadLength > 0)
+        AddStatistic(type + " records filtered by length", numFilteredByLength_);
+    if (settings_.isScrappingFiltered)
+        AddStatistic(type + " filtered records written to scraps", numFilteredScrapped_);
+}
+
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::InitHoleStatus(HdfReader* reader)
+{
+    assert(reader);
+
+    // 1 byte per ZMW, always cheap enough to keep resident
+    holeStatus_.clear();
+    zmwIndex_ = 0;
+    if (reader->zmwReader.holeStatusArray.IsInitialized())
+        reader->zmwReader.holeStatusArray.ReadDataset(holeStatus_);
+
+    // the sample only depends on hole numbers, so it's fixed before any bases are read
+    isSampled_.clear();
+    if (settings_.subsampleFraction < 1.0) {
+        std::vector<UInt> holeNumbers;
+        reader->zmwReader.holeNumberArray.ReadDataset(holeNumbers);
+        isSampled_.reserve(holeNumbers.size());
+        for (const UInt holeNumber : holeNumbers) {
+            isSampled_.push_back(ZmwSelection::IsSampled(holeNumber,
+                                                         settings_.subsampleFraction,
+                                                         settings_.subsampleSeed) ? 1 : 0);
+        }
+    }
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::SkipZmws(HdfReader* reader,
+                                                    RecordType& record,
+                                                    const size_t numZmws)
+{
+    assert(reader);
+    if (numZmws == 0)
+        return true;
+
+    // Advance() only moves the base call & ZMW positions, not the CCS reader's
+    // pass arrays, so CCS reads are always stepped through one at a time
+    if (HeaderReadType() != "CCS" &&
+        reader->Advance(static_cast<int>(numZmws)) == static_cast<int>(numZmws))
+    {
+        return true;
+    }
+
+    // readers that can't step over records read through them instead
+    for (size_t i = 0; i < numZmws; ++i) {
+        if (!reader->GetNext(record))
+            return false;
+        record.Free();
+    }
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::GetNextZmw(HdfReader* reader,
+                                                      RecordType& record,
+                                                      const bool keepNonSequencing)
+{
+    assert(reader);
+
+    // jump to the first selected ZMW, & stop after the last
+    if (zmwIndex_ < zmwBegin_) {
+        const size_t numBefore = zmwBegin_ - zmwIndex_;
+        if (!SkipZmws(reader, record, numBefore))
+            return false;
+        numZmwsUnselected_ += numBefore;
+        zmwIndex_ = zmwBegin_;
+    }
+    if (zmwIndex_ >= zmwEnd_)
+        return false;
+
+    // ZMWs [0, zmwIndex_) are fully written by now
+    if (checkpoint_ && zmwIndex_ >= nextCheckpointIndex_ && !WriteCheckpoint(zmwIndex_))
+        throw std::runtime_error("could not write checkpoint");
+
+    // step over non-sequencing & unsampled ZMWs without reading their bases & pulse features
+    const bool isSkippingNonSequencing = !keepNonSequencing && !holeStatus_.empty();
+    if (isSkippingNonSequencing || !isSampled_.empty()) {
+        const size_t numZmws = isSampled_.empty() ? holeStatus_.size() : isSampled_.size();
+        const size_t endIndex = std::min(numZmws, zmwEnd_);
+        size_t numSkipped = 0;
+        size_t numUnsampled = 0;
+        while (zmwIndex_ + numSkipped < endIndex) {
+            const size_t i = zmwIndex_ + numSkipped;
+            if (!isSampled_.empty() && isSampled_[i] == 0)
+                ++numUnsampled;
+            else if (!isSkippingNonSequencing || i >= holeStatus_.size() || holeStatus_[i] == 0)
+                break;
+            ++numSkipped;
+        }
+        numZmwsUnsampled_ += numUnsampled;
+        numZmwsSkipped_ += numSkipped - numUnsampled;
+
+        // nothing left worth reading in this file
+        if (zmwIndex_ + numSkipped == endIndex) {
+            zmwIndex_ += numSkipped;
+            return false;
+        }
+
+        if (!SkipZmws(reader, record, numSkipped))
+            return false;
+        zmwIndex_ += numSkipped;
+    }
+
+    // a ZMW is about to be read, start a new part first if this one is full
+    if (partIndex_ > 0 && IsPartFull() && !RollOverOutputs())
+        throw std::runtime_error("could not start a new output part");
+
+    if (prefetcher_)
+        PrefetchAhead(keepNonSequencing);
 
+    if (!IsNextReadInBudget(reader))
+        throw std::runtime_error("read exceeds memory budget");
+
+    if (!reader->GetNext(record))
+        return false;
+    if (chunkCacheStats_.HasDatasets() && zmwIndex_ + 1 < baseOffsets_.size())
+        chunkCacheStats_.Read(baseOffsets_[zmwIndex_], baseOffsets_[zmwIndex_ + 1]);
+    ++zmwIndex_;
+    ++numZmwsInPart_;
+    lastHoleNumber_ = record.zmwData.holeNumber;
+    featureCache_.Invalidate();
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+size_t ConverterBase<RecordType, HdfReader>::ReadBytesPerBase(void) const
+{
+    size_t numQvs = 0;
+    if (settings_.usingDeletionQV)      ++numQvs;
+    if (settings_.usingDeletionTag)     ++numQvs;
+    if (settings_.usingInsertionQV)     ++numQvs;
+    if (settings_.usingMergeQV)         ++numQvs;
+    if (settings_.usingSubstitutionQV)  ++numQvs;
+    if (settings_.usingSubstitutionTag) ++numQvs;
+    size_t numFrames = 0;
+    if (settings_.usingIPD)        ++numFrames;
+    if (settings_.usingPulseWidth) ++numFrames;
+    const size_t frameBytes = (settings_.losslessFrames ? 2 : 1);
+
+    // bax record: bases, qualities, 1 B per QV/tag & 2 B per frame feature.
+    // BAM record: bases & qualities, tags, encoded frames & their temporary uint16 copies.
+    return (2 + numQvs + 2 * numFrames) +
+           (2 + numQvs + (frameBytes + 2) * numFrames);
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::IsNextReadInBudget(HdfReader* reader)
+{
+    assert(reader);
+    if (!budget_.IsLimited())
+        return true;
+
+    int numEvents = 0;
+    try {
+        reader->zmwReader.numEventArray.Read(zmwIndex_, zmwIndex_ + 1, &numEvents);
+    } catch (H5::Exception&) {
+        return true; // GetNext() reports the unreadable ZMW
+    }
+
+    const uint64_t readBytes = static_cast<uint64_t>(std::max(numEvents, 0)) * ReadBytesPerBase();
+    if (readBytes <= budget_.MaxReadBytes())
+        return true;
+
+    UInt holeNumber = 0;
+    reader->zmwReader.GetHoleNumberAt(zmwIndex_, holeNumber);
+    const uint64_t MiB = 1024 * 1024;
+    AddErrorMessage("ZMW " + std::to_string(holeNumber) + " has " + std::to_string(numEvents) +
+                    " bases, its read buffers need ~" + std::to_string(readBytes / MiB + 1) +
+                    "MB but --max-memory leaves " + std::to_string(budget_.MaxReadBytes() / MiB) +
+                    "MB per read. Raise --max-memory, or drop pulse features or --losslessframes.");
     return false;
 }
 
 template<typename RecordType, typename HdfReader>
-bool ConverterBase<RecordType, HdfReader>::Run(void)
+bool ConverterBase<RecordType, HdfReader>::InitBaseOffsets(HdfReader* reader)
 {
-    using namespace PacBio;
-    using namespace PacBio::BAM;
+    assert(reader);
+    if (!baseOffsets_.empty())
+        return true;
 
-    std::set<std::string> movieNames;
+    // per-ZMW base offsets, to map ZMWs onto dataset ranges
+    std::vector<int> numEvents;
+    try {
+        reader->zmwReader.numEventArray.ReadDataset(numEvents);
+    } catch (H5::Exception&) {
+        return false;
+    }
+    baseOffsets_.reserve(numEvents.size() + 1);
+    baseOffsets_.push_back(0);
+    for (const int numEvent : numEvents)
+        baseOffsets_.push_back(baseOffsets_.back() + static_cast<uint64_t>(std::max(numEvent, 0)));
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+std::vector<H5::DataSet> ConverterBase<RecordType, HdfReader>::PerBaseDatasets(HdfReader* reader)
+{
+    assert(reader);
+    assert(!baseOffsets_.empty());
+
+    // per-base datasets for the fields we actually read
+    std::vector<H5::DataSet> datasets;
+    for (const std::string& field : IncludedFields()) {
+        try {
+            if (!reader->baseCallsGroup.ContainsObject(field))
+                continue;
+            const H5::DataSet dataset = reader->baseCallsGroup.group.openDataSet(field);
+            hsize_t numElements = 0;
+            const H5::DataSpace space = dataset.getSpace();
+            if (space.getSimpleExtentNdims() != 1)
+                continue;
+            space.getSimpleExtentDims(&numElements);
+            if (numElements == baseOffsets_.back())
+                datasets.push_back(dataset);
+        } catch (H5::Exception&) {
+            // just leave this one out
+        }
+    }
+    return datasets;
+}
+
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::InitPrefetcher(HdfReader* reader,
+                                                          const std::string& baxFn)
+{
+    assert(reader);
+
+    prefetcher_.reset();
+    prefetchedThrough_ = 0;
+
+    // CCS bases live in a separate group, not worth special-casing
+    if (settings_.prefetchZmws == 0 || HeaderReadType() == "CCS")
+        return;
+    if (!InitBaseOffsets(reader))
+        return;
+
+    const InputPrefetcher::Mode mode = (settings_.isPrefetchReading ? InputPrefetcher::ReadMode
+                                                                    : InputPrefetcher::AdviseMode);
+    std::unique_ptr<InputPrefetcher> prefetcher(new InputPrefetcher(mode));
+    if (!prefetcher->Open(baxFn))
+        return;
+    for (const H5::DataSet& dataset : PerBaseDatasets(reader))
+        prefetcher->AddDataset(dataset);
+    prefetcher_ = std::move(prefetcher);
+}
+
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::InitChunkCacheStats(HdfReader* reader,
+                                                               const HdfCacheConfig& cacheConfig)
+{
+    assert(reader);
+
+    chunkCacheStats_.ClearDatasets();
+
+    // only worth the base offsets when the cache is being tuned, CCS as for the prefetcher
+    if (cacheConfig.IsDefault() || HeaderReadType() == "CCS")
+        return;
+    if (!InitBaseOffsets(reader))
+        return;
+    for (const H5::DataSet& dataset : PerBaseDatasets(reader)) {
+        try {
+            chunkCacheStats_.AddDataset(dataset, cacheConfig.ChunkCacheBytes());
+        } catch (H5::Exception&) {
+            // just don't count this one
+        }
+    }
+}
 
-    // initialize input BAX readers
-    const auto baxEnd = settings_.inputBaxFilenames.cend();
-    for (auto baxIter = settings_.inputBaxFilenames.cbegin(); baxIter != baxEnd; ++baxIter) {
-        const std::string& baxFn = (*baxIter);
-        if (baxFn.empty())
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::PrefetchAhead(const bool keepNonSequencing)
+{
+    assert(prefetcher_);
+
+    // top up once the reader is halfway through the last batch requested
+    const size_t numZmws = std::min(baseOffsets_.size() - 1, zmwEnd_);
+    const size_t batchSize = settings_.prefetchZmws;
+    if (zmwIndex_ + batchSize / 2 < prefetchedThrough_ || prefetchedThrough_ >= numZmws)
+        return;
+
+    const size_t begin = std::max(prefetchedThrough_, zmwIndex_);
+    const size_t end = std::min(begin + batchSize, numZmws);
+
+    // only the bases of ZMWs GetNextZmw() will read (same masks), runs of them coalesced
+    const bool isSkippingNonSequencing = !keepNonSequencing && !holeStatus_.empty();
+    std::vector<std::pair<uint64_t, uint64_t> > baseRanges;
+    for (size_t i = begin; i < end; ++i) {
+        const bool isSkipped = (!isSampled_.empty() && isSampled_[i] == 0) ||
+                               (isSkippingNonSequencing && i < holeStatus_.size() && holeStatus_[i] != 0);
+        if (isSkipped || baseOffsets_[i] == baseOffsets_[i + 1])
             continue;
+        if (!baseRanges.empty() && baseRanges.back().second == baseOffsets_[i])
+            baseRanges.back().second = baseOffsets_[i + 1];
+        else
+            baseRanges.emplace_back(baseOffsets_[i], baseOffsets_[i + 1]);
+    }
+    prefetcher_->Prefetch(baseRanges);
+    prefetchedThrough_ = end;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::LoadChemistryFromMetadataXML(
+        const std::string& baxFn,
+        const std::string& movieName,
+        BaxFileInfo* info)
+{
+    assert(info);
+
+    // read once per movie, by the first of its files that lacks the chemistry attributes
+    MetadataChemistry chemistry;
+    bool isCached = false;
+    {
+        std::lock_guard<std::mutex> lock(scanMutex_);
+        const auto cached = metadataChemistry_.find(movieName);
+        if (cached != metadataChemistry_.end()) {
+            chemistry = cached->second;
+            isCached = true;
+        }
+    }
+    if (!isCached) {
+        const std::string path = InputPreloader::MetadataXmlPath(baxFn, movieName);
+        if (path.empty())
+            return false;
+        if (!MetadataXml::ReadChemistry(path, &chemistry))
+            return false;
+        std::lock_guard<std::mutex> lock(scanMutex_);
+        metadataChemistry_.emplace(movieName, chemistry);
+    }
+
+    info->bindingKit        = chemistry.bindingKit;
+    info->sequencingKit     = chemistry.sequencingKit;
+    info->basecallerVersion = chemistry.basecallerVersion;
+
+    if (!settings_.isIgnoringChemistryCheck) {
+
+        // throws if invalid chemistry triple
+        // we'll take the opportunity to exit early with error message
+        using PacBio::BAM::ReadGroupInfo;
+        std::lock_guard<std::mutex> lock(scanMutex_);
+        try {
+            ReadGroupInfo::SequencingChemistryFromTriple(info->bindingKit,
+                                                         info->sequencingKit,
+                                                         info->basecallerVersion);
+        } catch (PacBio::BAM::InvalidSequencingChemistryException& e) {
+            info->error = e.what();
+            return false;
+        } catch (std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::ScanBaxFile(const std::string& baxFn,
+                                                       BaxFileInfo* info)
+{
+    assert(info);
+    info->filename = baxFn;
+    info->cacheConfig = HdfCacheConfig(settings_);
+    info->zmws = ZmwRange(0, SIZE_MAX);
+
+    bool hasChemistry = false;
+    std::vector<UInt> holeNumbers;
+    {
+        std::lock_guard<std::mutex> lock(scanMutex_);
+        if (!ReadBaxHeader(baxFn, info, &hasChemistry, &holeNumbers))
+            return false;
+    }
+
+    // the rest runs alongside other files' scans
+    if (!hasChemistry && !LoadChemistryFromMetadataXML(baxFn, info->movieName, info)) {
+        if (info->error.empty())
+            info->error = "BindingKit, SequencingKit, and ChangeListID are mandatory but unavailable";
+        return false;
+    }
+
+    // ZMW subset, hole numbers are sorted within a file
+    if (settings_.zmwRangeEnd != 0)
+        info->zmws = ZmwSelection::ByHoleNumber(holeNumbers,
+                                                settings_.zmwRangeBegin,
+                                                settings_.zmwRangeEnd);
+    return true;
+}
 
-        HdfReader* reader = InitHdfReader();
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::ReadBaxHeader(const std::string& baxFn,
+                                                         BaxFileInfo* info,
+                                                         bool* hasChemistry,
+                                                         std::vector<UInt>* holeNumbers)
+{
+    assert(info);
+    assert(hasChemistry);
+    assert(holeNumbers);
+
+    // only header attributes (& the ZMW table, if selecting ZMWs) are read here, no data
+    // datasets are opened until the file's conversion starts
+    HDFFile file;
+    try {
+        file.Open(baxFn, H5F_ACC_RDONLY, H5::FileAccPropList::DEFAULT);
+    } catch (H5::Exception&) {
+        info->error = "could not open BAX file: " + baxFn;
+        return false;
+    }
 
-        // read in mandatory ReadGroupInfo from bax file
-        if (reader->Initialize(baxFn) &&
-            reader->scanDataReader.fileHasScanData &&
-            reader->scanDataReader.initializedRunInfoGroup)
+    HDFGroup scanDataGroup;
+    HDFGroup runInfoGroup;
+    HDFGroup acqParamsGroup;
+    HDFGroup pulseDataGroup;
+    HDFGroup baseCallsGroup;
+    bool result = false;
+    try {
+        if (!file.rootGroup.ContainsObject("ScanData") ||
+            !scanDataGroup.Initialize(file.rootGroup, "ScanData") ||
+            !scanDataGroup.ContainsObject("RunInfo") ||
+            !runInfoGroup.Initialize(scanDataGroup, "RunInfo") ||
+            !file.rootGroup.ContainsObject("PulseData") ||
+            !pulseDataGroup.Initialize(file.rootGroup, "PulseData") ||
+            !pulseDataGroup.ContainsObject("BaseCalls") ||
+            !baseCallsGroup.Initialize(pulseDataGroup, "BaseCalls"))
+        {
+            info->error = "Failed to properly initialize HDFBasReader";
+            file.Close();
+            return false;
+        }
+
+        // MovieName
         {
-            // FrameRate
+            HDFAtom<std::string> mnAtom;
+            if (runInfoGroup.ContainsAttribute("MovieName") &&
+                mnAtom.Initialize(runInfoGroup, "MovieName"))
             {
-                HDFAtom<float> frAtom;
-                if (reader->scanDataReader.acqParamsGroup.ContainsAttribute("FrameRate") &&
-                    frAtom.Initialize(reader->scanDataReader.acqParamsGroup, "FrameRate"))
-                {
-                    float localFrameRate;
-                    frAtom.Read(localFrameRate);
-                    frAtom.dataspace.close();
-                    frameRateHz_ = std::to_string(localFrameRate);
-                } else {
-                    AddErrorMessage("FrameRate is mandatory but unavailable");
-                    return false;
-                }
+                mnAtom.Read(info->movieName);
+                mnAtom.dataspace.close();
             }
+        }
 
-            // chemistry triple success flag
-            bool success = false;
-
-            // BindingKit
+        // FrameRate
+        {
+            HDFAtom<float> frAtom;
+            if (scanDataGroup.ContainsObject("AcqParams") &&
+                acqParamsGroup.Initialize(scanDataGroup, "AcqParams") &&
+                acqParamsGroup.ContainsAttribute("FrameRate") &&
+                frAtom.Initialize(acqParamsGroup, "FrameRate"))
             {
-                HDFAtom<std::string> bkAtom;
-                if (reader->scanDataReader.runInfoGroup.ContainsAttribute("BindingKit") &&
-                    bkAtom.Initialize(reader->scanDataReader.runInfoGroup, "BindingKit"))
-                {
-                    bkAtom.Read(bindingKit_);
-                    bkAtom.dataspace.close();
-                } else {
-                    goto fallback;
-                }
+                float localFrameRate;
+                frAtom.Read(localFrameRate);
+                frAtom.dataspace.close();
+                info->frameRateHz = std::to_string(localFrameRate);
+            } else {
+                info->error = "FrameRate is mandatory but unavailable";
+                file.Close();
+                return false;
             }
+        }
 
-            // SequencingKit
-            {
-                HDFAtom<std::string> skAtom;
-                if (reader->scanDataReader.runInfoGroup.ContainsAttribute("SequencingKit") &&
-                    skAtom.Initialize(reader->scanDataReader.runInfoGroup, "SequencingKit"))
-                {
-                    skAtom.Read(sequencingKit_);
-                    skAtom.dataspace.close();
-                } else {
-                    goto fallback;
-                }
+        // chemistry triple (ScanBaxFile() falls back to the movie's metadata.xml)
+        HDFAtom<std::string> bkAtom;
+        HDFAtom<std::string> skAtom;
+        HDFAtom<std::string> clAtom;
+        if (runInfoGroup.ContainsAttribute("BindingKit") &&
+            bkAtom.Initialize(runInfoGroup, "BindingKit") &&
+            runInfoGroup.ContainsAttribute("SequencingKit") &&
+            skAtom.Initialize(runInfoGroup, "SequencingKit") &&
+            baseCallsGroup.ContainsAttribute("ChangeListID") &&
+            clAtom.Initialize(baseCallsGroup, "ChangeListID"))
+        {
+            bkAtom.Read(info->bindingKit);
+            skAtom.Read(info->sequencingKit);
+            clAtom.Read(info->basecallerVersion);
+            *hasChemistry = true;
+        }
+        result = true;
+
+        // ZMW table, for --zmw-range/--chunk
+        if (settings_.zmwRangeEnd != 0 || settings_.chunkCount != 0) {
+            HDFGroup zmwGroup;
+            if (!baseCallsGroup.ContainsObject("ZMW") || !zmwGroup.Initialize(baseCallsGroup, "ZMW")) {
+                info->error = "could not read ZMW table of " + baxFn;
+                result = false;
+            } else if (settings_.zmwRangeEnd != 0) {
+                HDFArray<UInt> holeNumberArray;
+                holeNumberArray.InitializeForReading(zmwGroup, "HoleNumber");
+                holeNumberArray.ReadDataset(*holeNumbers);
+                holeNumberArray.Close();
+            } else {
+                HDFArray<int> numEventArray;
+                numEventArray.InitializeForReading(zmwGroup, "NumEvent");
+                numEventArray.ReadDataset(info->numEvents);
+                numEventArray.Close();
             }
+            zmwGroup.Close();
+        }
+    } catch (H5::Exception&) {
+        info->error = "could not read header or ZMW table of " + baxFn;
+        result = false;
+    }
 
-            // basecaller ChangeListID
-            {
-                HDFGroup bcGroup;
-                if (reader->pulseDataGroup.ContainsObject("BaseCalls") &&
-                    bcGroup.Initialize(reader->pulseDataGroup.group, "BaseCalls"))
-                {
-                    HDFAtom<std::string> clAtom;
-                    if (bcGroup.ContainsAttribute("ChangeListID") &&
-                        clAtom.Initialize(bcGroup.group, "ChangeListID"))
-                    {
-                        clAtom.Read(basecallerVersion_);
-                        clAtom.dataspace.close();
-                        success = true;
-                    }
-                    bcGroup.Close();
-                }
+    // size chunk caches to this file's layout (dataset creation properties only)
+    if (result && settings_.isAutoChunkCache) {
+        try {
+            info->cacheConfig.SizeToChunks(baseCallsGroup.group,
+                                           budget_.MaxChunkCacheBytes());
+        } catch (H5::Exception&) {
+            // keep defaults
+        }
+    }
+
+    baseCallsGroup.Close();
+    pulseDataGroup.Close();
+    acqParamsGroup.Close();
+    runInfoGroup.Close();
+    scanDataGroup.Close();
+    file.Close();
+    return result;
+}
+
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::ScanBaxFiles(const std::vector<std::string>& baxFilenames,
+                                                        std::vector<BaxFileInfo>* infos)
+{
+    assert(infos);
+    infos->assign(baxFilenames.size(), BaxFileInfo());
+
+    // each thread takes the next unscanned input, results stay in input order
+    std::atomic<size_t> next(0);
+    auto worker = [this, &baxFilenames, infos, &next]() {
+        size_t i;
+        while ((i = next++) < infos->size()) {
+            try {
+                ScanBaxFile(baxFilenames[i], &infos->at(i));
+            } catch (std::exception& e) {
+                infos->at(i).error = "could not scan " + baxFilenames[i] + ": " + e.what();
             }
+        }
+    };
+
+    const size_t numThreads = std::min(InputPreloader::DefaultMaxThreads, infos->size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& t : threads)
+        t.join();
+}
+
+template<typename RecordType, typename HdfReader>
+std::unique_ptr<PacBio::BAM::BamWriter>
+ConverterBase<RecordType, HdfReader>::OpenBamWriter(const std::string& fn,
+                                                    const PacBio::BAM::BamHeader& header,
+                                                    const int compressionLevel,
+                                                    const bool isStream)
+{
+    using PacBio::BAM::BamWriter;
+
+    // streams can't be written via temp file + rename, or staged
+    std::string path = (isStream ? fn : publisher_->StagedPath(fn));
+    bool useTempFile = !isStream;
+
+    // checkpointed output must be at its final path while it's written, so a later run can pick it up,
+    // & split-by-size output so its size can be checked
+    if (checkpoint_ || settings_.splitBytes > 0)
+        useTempFile = false;
+    if (checkpoint_ && isResumed_)
+        path += ".resume";
+
+    // route file output through a large-buffer sink, if requested
+    if (!isStream && settings_.writeBufferBytes > 0) {
+        std::unique_ptr<BufferedFileSink> sink(new BufferedFileSink(path,
+                                                                    settings_.writeBufferBytes,
+                                                                    settings_.isDirectIO));
+        if (!sink->Open())
+            throw std::runtime_error(sink->Error());
+        path = sink->WriterPath();
+        useTempFile = false;
+        sinks_[fn] = std::move(sink);
+    }
+
+    return std::unique_ptr<BamWriter>(new BamWriter(path,
+                                                    header,
+                                                    static_cast<BamWriter::CompressionLevel>(compressionLevel),
+                                                    budget_.WriterThreads(),
+                                                    BamWriter::BinCalculation_ON,
+                                                    useTempFile));
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::FinishBamOutput(const std::string& fn)
+{
+    using namespace PacBio::BAM;
 
-fallback:
-            if (!success && !LoadChemistryFromMetadataXML(baxFn, reader->GetMovieName()))
+    // flush buffered output (writer is closed by now)
+    const auto sinkIter = sinks_.find(fn);
+    if (sinkIter != sinks_.end()) {
+        const bool sinkOk = sinkIter->second->Finish();
+        AddStatistic("buffered output bytes", sinkIter->second->BytesWritten());
+        AddStatistic("buffered output writes", sinkIter->second->NumWrites());
+        if (!sinkOk) {
+            AddErrorMessage(sinkIter->second->Error());
+            return false;
+        }
+        sinks_.erase(sinkIter);
+    }
+
+    // a resumed output is what was kept from the stopped run, followed by the rest
+    if (isResumed_) {
+        const std::string resumeFn = fn + ".resume";
+        std::string error;
+        if (!Checkpoint::AppendRecordBlocks(fn, resumeFn, &error)) {
+            AddErrorMessage(error);
+            return false;
+        }
+        std::remove(resumeFn.c_str());
+    }
+
+    // indexes are built from the finished files, so offsets match any compression level
+    const std::string path = publisher_->StagedPath(fn);
+    PbiFile::CreateFrom(BamFile{ path });
+
+    // moves run in the background, overlapping any remaining work
+    publisher_->Publish(fn);
+    publisher_->Publish(fn + ".pbi");
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::InitCheckpoint(void)
+{
+    if (settings_.checkpointZmws == 0)
+        return true;
+    checkpoint_.reset(new Checkpoint(settings_.outputBamFilename + ".checkpoint"));
+
+    // everything but --resume must match the run being resumed
+    std::string options = settings_.args;
+    const std::string resumeArg = "--resume ";
+    for (size_t pos = options.find(resumeArg); pos != std::string::npos; pos = options.find(resumeArg, pos)) {
+        if (pos == 0 || options[pos - 1] == ' ')
+            options.erase(pos, resumeArg.size());
+        else
+            ++pos;
+    }
+
+    std::string checkpointOptions;
+    std::vector<CheckpointEntry> entries;
+    if (settings_.isResuming && checkpoint_->Load(&checkpointOptions, &entries)) {
+        if (checkpointOptions != options) {
+            AddErrorMessage("options differ from the run that wrote " + checkpoint_->Filename());
+            return false;
+        }
+        if (!RecoverOutput(settings_.outputBamFilename))
+            return false;
+        if (!settings_.scrapsBamFilename.empty() && !RecoverOutput(settings_.scrapsBamFilename))
+            return false;
+
+        // where each entry's records end, one pass over each output
+        std::vector<uint64_t> numRecords;
+        std::vector<uint64_t> numScrapsRecords;
+        for (const CheckpointEntry& entry : entries) {
+            numRecords.push_back(entry.numRecords);
+            numScrapsRecords.push_back(entry.numScrapsRecords);
+        }
+        std::vector<int64_t> offsets;
+        std::vector<int64_t> scrapsOffsets(entries.size(), 0);
+        Checkpoint::FindRecordsEnds(settings_.outputBamFilename, numRecords, &offsets);
+        if (!settings_.scrapsBamFilename.empty())
+            Checkpoint::FindRecordsEnds(settings_.scrapsBamFilename, numScrapsRecords, &scrapsOffsets);
+
+        // latest entry that every output fully reached
+        int64_t offset = 0;
+        int64_t scrapsOffset = 0;
+        size_t numEntries = entries.size();
+        for (; numEntries > 0; --numEntries) {
+            offset = offsets[numEntries - 1];
+            scrapsOffset = scrapsOffsets[numEntries - 1];
+            if (offset >= 0 && scrapsOffset >= 0)
+                break;
+        }
+
+        // otherwise start over
+        if (numEntries > 0) {
+            std::string error;
+            if (!Checkpoint::Truncate(settings_.outputBamFilename, offset, &error) ||
+                (!settings_.scrapsBamFilename.empty() &&
+                 !Checkpoint::Truncate(settings_.scrapsBamFilename, scrapsOffset, &error)))
             {
-                AddErrorMessage("BindingKit, SequencingKit, and ChangeListID are mandatory but unavailable");
+                AddErrorMessage(error);
                 return false;
             }
 
-        } else {
-            delete reader;
-            AddErrorMessage("Failed to properly initialize HDFBasReader");
-            return false;
+            entries.resize(numEntries);
+            const CheckpointEntry& entry = entries.back();
+            resumeFileIndex_ = entry.fileIndex;
+            resumeZmwIndex_ = entry.zmwIndex;
+            lastHoleNumber_ = entry.holeNumber;
+            numRecordsWritten_ = entry.numRecords;
+            numScrapsRecordsWritten_ = entry.numScrapsRecords;
+            isResumed_ = true;
+            AddStatistic("records kept from checkpoint", entry.numRecords + entry.numScrapsRecords);
         }
+    }
+    if (!isResumed_)
+        entries.clear();
 
-        movieNames.insert(reader->GetMovieName());
-        readers_.push_back(reader);
-        filenameForReader_[reader] = baxFn;
+    // entries past the resume point no longer describe the outputs
+    if (!checkpoint_->Create(options, entries)) {
+        AddErrorMessage(checkpoint_->Error());
+        return false;
     }
+    return true;
+}
 
-    if (readers_.empty()) {
-        AddErrorMessage("could not open BAX file(s)");
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::RecoverOutput(const std::string& fn)
+{
+    // a resumed run that was itself stopped left the rest of its output in a continuation file,
+    // checked against the checkpoint entries like any other partial output
+    const std::string resumeFn = fn + ".resume";
+    if (!std::ifstream(resumeFn).good())
+        return true;
+
+    // kept on failure, so nothing converted so far is lost
+    std::string error;
+    if (!Checkpoint::AppendRecordBlocks(fn, resumeFn, &error)) {
+        AddErrorMessage(error + " (continuation kept in " + resumeFn + ")");
         return false;
     }
+    std::remove(resumeFn.c_str());
+    return true;
+}
 
-    // sanity check that BAX files come from same movie
-    if (movieNames.size() != 1) {
-        AddErrorMessage("multiple movies detected:");
-        for (const auto m : movieNames)
-            AddErrorMessage(std::string("    ")+m);
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::WriteCheckpoint(const size_t zmwIndex)
+{
+    assert(checkpoint_);
+
+    // end the current BGZF blocks, so the next records start new ones
+    try {
+        if (writer_)
+            writer_->TryFlush();
+        if (scrapsWriter_)
+            scrapsWriter_->TryFlush();
+    } catch (std::exception&) {
+        AddErrorMessage("failed to flush output for checkpoint");
         return false;
     }
-    settings_.movieName = (*movieNames.cbegin());
+
+    CheckpointEntry entry;
+    entry.fileIndex = fileIndex_;
+    entry.zmwIndex = zmwIndex;
+    entry.holeNumber = lastHoleNumber_;
+    entry.numRecords = numRecordsWritten_;
+    entry.numScrapsRecords = numScrapsRecordsWritten_;
+    if (!checkpoint_->Add(entry)) {
+        AddErrorMessage(checkpoint_->Error());
+        return false;
+    }
+
+    // fixed boundaries, so a resumed run flushes where an uninterrupted one would
+    nextCheckpointIndex_ = (zmwIndex / settings_.checkpointZmws + 1) * settings_.checkpointZmws;
+    AddStatistic("checkpoints written", 1);
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::SetPartFilenames(void)
+{
+    // e.g. <prefix>.part2.subreads.bam & <prefix>.part2.scraps.bam
+    const std::string part = ".part" + std::to_string(partIndex_);
+    settings_.outputBamFilename = settings_.outputBamPrefix + part + OutputFileSuffix();
+    settings_.outputBamParts.push_back(settings_.outputBamFilename);
+    if (!settings_.scrapsBamFilename.empty()) {
+        settings_.scrapsBamFilename = settings_.outputBamPrefix + part + ScrapsFileSuffix();
+        settings_.scrapsBamParts.push_back(settings_.scrapsBamFilename);
+    }
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::IsPartFull(void) const
+{
+    // parts are never empty
+    if (numZmwsInPart_ == 0)
+        return false;
+    if (settings_.splitZmws > 0 && numZmwsInPart_ >= settings_.splitZmws)
+        return true;
+
+    // size on disk trails what's been written by the BGZF & output buffers anyway,
+    // so it's only checked every so often rather than stat'ing the file per ZMW
+    static const size_t SplitBytesCheckInterval = 64;
+    if (settings_.splitBytes > 0 && numZmwsInPart_ % SplitBytesCheckInterval == 0) {
+        struct stat s;
+        const std::string path = publisher_->StagedPath(settings_.outputBamFilename);
+        if (stat(path.c_str(), &s) == 0 && static_cast<size_t>(s.st_size) >= settings_.splitBytes)
+            return true;
+    }
+    return false;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::RollOverOutputs(void)
+{
+    // finish this part like any other output: close, index & publish
+    writer_.reset();
+    scrapsWriter_.reset();
+    if (!FinishBamOutput(settings_.outputBamFilename))
+        return false;
+    if (!settings_.scrapsBamFilename.empty() && !FinishBamOutput(settings_.scrapsBamFilename))
+        return false;
+
+    ++partIndex_;
+    numZmwsInPart_ = 0;
+    SetPartFilenames();
+    OpenOutputs();
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::ConvertBaxFile(const BaxFileInfo& baxFile)
+{
+    HdfReader* reader = OpenHdfReader(baxFile.filename, baxFile.cacheConfig);
+    if (reader == nullptr) {
+        AddErrorMessage("Failed to properly initialize HDFBasReader");
+        return false;
+    }
+    zmwBegin_ = baxFile.zmws.begin;
+    zmwEnd_ = baxFile.zmws.end;
+
+    // a resume point at the start of each file (a no-op flush for the file a resumed run starts in)
+    if (checkpoint_ && !WriteCheckpoint(zmwBegin_)) {
+        CloseHdfReader(reader);
+        return false;
+    }
+    baseOffsets_.clear();
+    if (!settings_.isStatsOnly) {
+        InitPrefetcher(reader, baxFile.filename);
+        InitChunkCacheStats(reader, baxFile.cacheConfig);
+    }
+
+    bool success = false;
+    try {
+        if (settings_.isStatsOnly)
+            success = SurveyFile(reader);
+        else
+            success = ConvertFile(reader);
+    } catch (...) {
+        CloseHdfReader(reader);
+        throw;
+    }
+
+    // HDF5 does not expose raw-data chunk cache hits, report the metadata cache's & the modeled chunk cache counts
+    double hitRate = 0.0;
+    if (H5Fget_mdc_hit_rate(reader->hdfBasFile.getId(), &hitRate) >= 0) {
+        mdcHitRateSum_ += hitRate;
+        ++numFilesConverted_;
+        SetStatistic("HDF5 metadata cache hit rate (%)",
+                     static_cast<uint64_t>(100.0 * mdcHitRateSum_ / numFilesConverted_ + 0.5));
+    }
+    const size_t chunkCacheBytes = baxFile.cacheConfig.chunkCacheBytes;
+    if (chunkCacheBytes > 0)
+        SetStatistic("HDF5 chunk cache bytes per dataset (last file)", chunkCacheBytes);
+    if (chunkCacheStats_.HasDatasets()) {
+        SetStatistic("HDF5 chunk cache hits (estimated)", chunkCacheStats_.Hits());
+        SetStatistic("HDF5 chunk cache misses (estimated)", chunkCacheStats_.Misses());
+    }
+    chunkCacheStats_.ClearDatasets();
+
+    CloseHdfReader(reader);
+    return success;
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::InitOutputs(void)
+{
+    using PacBio::BAM::MakeReadGroupId;
 
     // Use the movie name to initialize the ReadGroupId
     settings_.readGroupId = MakeReadGroupId(MovieName(), HeaderReadType());
@@ -967,58 +2212,303 @@ fallback:
     // initialize output file(s)
     if (settings_.outputBamPrefix.empty())
         settings_.outputBamPrefix = settings_.movieName;
-    settings_.outputBamFilename = settings_.outputBamPrefix + OutputFileSuffix();
+    if (!settings_.isStreamingOutput)
+        settings_.outputBamPrefix += settings_.shardLabel;
+    if (settings_.isStreamingOutput)
+        settings_.outputBamFilename = settings_.outputBamPrefix;
+    else if (settings_.outputFormat != Settings::BamFormat) {
+        // e.g. .subreads.bam -> .subreads.fasta.gz
+        const std::string bamSuffix = OutputFileSuffix();
+        settings_.outputBamFilename = settings_.outputBamPrefix
+                                      + bamSuffix.substr(0, bamSuffix.size() - 4)
+                                      + (settings_.outputFormat == Settings::FastqFormat ? ".fastq" : ".fasta")
+                                      + (settings_.isGzipOutput ? ".gz" : "");
+    }
+    else
+        settings_.outputBamFilename = settings_.outputBamPrefix + OutputFileSuffix();
 
-    // Separate single-output from dual-output jobs
-    if (HeaderReadType() == "SUBREAD" || HeaderReadType() == "HQREGION")
+    // Separate single-output from dual-output jobs (sequence-only output has no scraps)
+    const bool isDualOutput = (HeaderReadType() == "SUBREAD" || HeaderReadType() == "HQREGION") &&
+                              settings_.outputFormat == Settings::BamFormat;
+    if (isDualOutput)
     {
         // setup scram BAM file info
         settings_.scrapsReadGroupId = MakeReadGroupId(MovieName(), ScrapsReadType());
-        settings_.scrapsBamFilename = settings_.outputBamPrefix + ScrapsFileSuffix();
+        if (settings_.isStreamingOutput)
+            settings_.scrapsBamFilename = settings_.scrapsOutputFilename;
+        else
+            settings_.scrapsBamFilename = settings_.outputBamPrefix + ScrapsFileSuffix();
+    }
+    assert(isDualOutput || settings_.scrapsBamFilename.empty());
 
-        // main conversion of BAX -> BAM records for dual-output jobs
-        try {
-            BamWriter writer(settings_.outputBamFilename, CreateHeader(HeaderReadType()));
-            BamWriter scrapsWriter(settings_.scrapsBamFilename, CreateHeader(ScrapsReadType()));
+    // split output starts with .part1
+    if (settings_.splitZmws > 0 || settings_.splitBytes > 0) {
+        partIndex_ = 1;
+        SetPartFilenames();
+    }
 
-            for (HdfReader* reader : readers_) {
-                assert(reader);
-                if (!ConvertFile(reader, &writer, &scrapsWriter))
-                    return false;
-            }
-        } catch (std::exception&) {
-            // TODO: get more helpful message here
-            AddErrorMessage("failed to convert BAM file");
+    // scratch dir for staged outputs (see SetPublisher())
+    if (!publisher_)
+        publisher_ = std::make_shared<OutputPublisher>(settings_.tmpDir);
+    if (!publisher_->IsValid()) {
+        for (const std::string& e : publisher_->Errors())
+            AddErrorMessage(e);
+        return false;
+    }
+    return true;
+}
+
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::OpenOutputs(void)
+{
+    if (settings_.outputFormat != Settings::BamFormat) {
+        const std::string& fn = settings_.outputBamFilename;
+        const SequenceWriter::Format format = (settings_.outputFormat == Settings::FastqFormat) ? SequenceWriter::Fastq
+                                                                                                : SequenceWriter::Fasta;
+        sequenceWriter_.reset(new SequenceWriter(settings_.isStreamingOutput ? fn : publisher_->StagedPath(fn),
+                                                 format,
+                                                 settings_.isGzipOutput,
+                                                 settings_.compressionLevel,
+                                                 budget_.WriterThreads()));
+        if (!sequenceWriter_->Open())
+            throw std::runtime_error(sequenceWriter_->Error());
+        return;
+    }
+
+    writer_ = OpenBamWriter(settings_.outputBamFilename,
+                            CreateHeader(HeaderReadType()),
+                            settings_.compressionLevel,
+                            settings_.isStreamingOutput);
+    if (!settings_.scrapsBamFilename.empty())
+        scrapsWriter_ = OpenBamWriter(settings_.scrapsBamFilename,
+                                      CreateHeader(ScrapsReadType(), !settings_.isLeanScraps),
+                                      settings_.scrapsCompressionLevel,
+                                      false);
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::FinishOutputs(void)
+{
+    // close writers first, flushing their last blocks
+    writer_.reset();
+    scrapsWriter_.reset();
+
+    // sequence-only output has no index
+    if (sequenceWriter_) {
+        const bool isClosed = sequenceWriter_->Close();
+        AddStatistic("FASTA/FASTQ records written", sequenceWriter_->NumRecords());
+        if (!isClosed) {
+            AddErrorMessage(sequenceWriter_->Error());
+            sequenceWriter_.reset();
             return false;
         }
+        sequenceWriter_.reset();
+        if (!settings_.isStreamingOutput)
+            publisher_->Publish(settings_.outputBamFilename);
+    }
+
+    // make PBI files (a streamed BAM can't be re-read) & publish
+    if (!settings_.isStreamingOutput && settings_.outputFormat == Settings::BamFormat &&
+        !FinishBamOutput(settings_.outputBamFilename))
+        return false;
+    if (!settings_.scrapsBamFilename.empty() && !FinishBamOutput(settings_.scrapsBamFilename))
+        return false;
 
-        // make PBI files
-        PbiFile::CreateFrom(BamFile{ settings_.outputBamFilename });
-        PbiFile::CreateFrom(BamFile{ settings_.scrapsBamFilename });
+    // moves carry on in the background, Run() waits for them once every mode is finished
+    return true;
+}
 
-    } else {
+template<typename RecordType, typename HdfReader>
+void ConverterBase<RecordType, HdfReader>::TakeCompanionResults(ConverterBase* companion)
+{
+    assert(companion);
+
+    // companions report through this converter
+    for (const std::string& e : companion->errors_)
+        AddErrorMessage(e);
+    companion->errors_.clear();
+    for (const auto& stat : companion->statistics_)
+        AddStatistic(stat.first, stat.second);
+    companion->statistics_.clear();
+    AddStatistic("record pool hits", companion->recordPool_.Hits());
+    AddStatistic("record pool misses", companion->recordPool_.Misses());
+}
+
+template<typename RecordType, typename HdfReader>
+bool ConverterBase<RecordType, HdfReader>::Run(void)
+{
+    using namespace PacBio;
+    using namespace PacBio::BAM;
 
-        assert(settings_.scrapsBamFilename.empty());
+    std::set<std::string> movieNames;
+    std::vector<BaxFileInfo> baxFiles;
 
-        // main conversion of BAX -> BAM records for single-output jobs
-        try {
-            BamWriter writer(settings_.outputBamFilename, CreateHeader(HeaderReadType()));
+    std::vector<std::string> baxFilenames;
+    for (const std::string& baxFn : settings_.inputBaxFilenames) {
+        if (!baxFn.empty())
+            baxFilenames.push_back(baxFn);
+    }
 
-            for (HdfReader* reader : readers_) {
-                assert(reader);
-                if (!ConvertFile(reader, &writer))
-                    return false;
-            }
-        } catch (std::exception&) {
-            // TODO: get more helpful message here
-            AddErrorMessage("failed to convert BAM file");
+    // check inputs & warm their headers concurrently
+    std::vector<PreloadedInput> preloaded = InputPreloader().Run(baxFilenames);
+    for (PreloadedInput& input : preloaded) {
+        if (!input.error.empty()) {
+            AddErrorMessage(input.error);
             return false;
         }
+    }
 
-        // make PBI file
-        PbiFile::CreateFrom(BamFile{ settings_.outputBamFilename });
+    // validate input BAX headers up front, on worker threads (their HDF5 calls are serialized, the
+    // metadata.xml fallback, chemistry checks & ZMW selection aren't). Data readers are opened
+    // per-file during conversion.
+    std::vector<BaxFileInfo> scanned;
+    ScanBaxFiles(baxFilenames, &scanned);
+    for (BaxFileInfo& info : scanned) {
+        if (!info.error.empty()) {
+            AddErrorMessage(info.error);
+            return false;
+        }
+        movieNames.insert(info.movieName);
+        baxFiles.push_back(std::move(info));
     }
 
+    if (baxFiles.empty()) {
+        AddErrorMessage("could not open BAX file(s)");
+        return false;
+    }
+
+    // parts of one movie must agree on run info
+    for (const BaxFileInfo& info : baxFiles) {
+        const BaxFileInfo& first = baxFiles.front();
+        if (info.frameRateHz       != first.frameRateHz   ||
+            info.bindingKit        != first.bindingKit    ||
+            info.sequencingKit     != first.sequencingKit ||
+            info.basecallerVersion != first.basecallerVersion)
+        {
+            AddErrorMessage("run info (frame rate or chemistry) differs between " +
+                            first.filename + " and " + info.filename);
+            return false;
+        }
+    }
+
+    // chunk boundaries need every file's base counts
+    if (settings_.chunkCount != 0) {
+        std::vector<std::vector<int> > numEvents;
+        for (BaxFileInfo& info : baxFiles)
+            numEvents.push_back(std::move(info.numEvents));
+        const std::vector<ZmwRange> ranges = ZmwSelection::ByChunk(numEvents,
+                                                                   settings_.chunkIndex,
+                                                                   settings_.chunkCount);
+        for (size_t i = 0; i < baxFiles.size(); ++i)
+            baxFiles[i].zmws = ranges[i];
+    }
+
+    // run info for BamHeader creation
+    frameRateHz_       = baxFiles.back().frameRateHz;
+    bindingKit_        = baxFiles.back().bindingKit;
+    sequencingKit_     = baxFiles.back().sequencingKit;
+    basecallerVersion_ = baxFiles.back().basecallerVersion;
+
+    // sanity check that BAX files come from same movie
+    if (movieNames.size() != 1) {
+        AddErrorMessage("multiple movies detected:");
+        for (const auto m : movieNames)
+            AddErrorMessage(std::string("    ")+m);
+        return false;
+    }
+    settings_.movieName = (*movieNames.cbegin());
+
+    // outputs for this & any companion modes, which share the run info
+    if (!InitOutputs())
+        return false;
+    for (ConverterBase* companion : companions_) {
+        companion->settings_.movieName = settings_.movieName;
+        companion->frameRateHz_       = frameRateHz_;
+        companion->bindingKit_        = bindingKit_;
+        companion->sequencingKit_     = sequencingKit_;
+        companion->basecallerVersion_ = basecallerVersion_;
+        companion->SetPublisher(publisher_);
+        if (!companion->InitOutputs()) {
+            TakeCompanionResults(companion);
+            return false;
+        }
+    }
+
+    // main conversion of BAX -> BAM records
+    try {
+        if (!InitCheckpoint())
+            return false;
+        if (!settings_.isStatsOnly) {
+            OpenOutputs();
+            for (ConverterBase* companion : companions_)
+                companion->OpenOutputs();
+        }
+
+        for (size_t i = 0; i < baxFiles.size(); ++i) {
+            BaxFileInfo& baxFile = baxFiles[i];
+            fileIndex_ = i;
+
+            // a resumed run carries on from its checkpoint
+            if (isResumed_) {
+                if (i < resumeFileIndex_)
+                    continue;
+                if (i == resumeFileIndex_)
+                    baxFile.zmws.begin = std::max(baxFile.zmws.begin, resumeZmwIndex_);
+            }
+
+            // files outside the selection aren't opened at all
+            if (baxFile.zmws.Empty())
+                continue;
+            if (!ConvertBaxFile(baxFile)) {
+                for (ConverterBase* companion : companions_)
+                    TakeCompanionResults(companion);
+                return false;
+            }
+        }
+    } catch (std::exception&) {
+        // TODO: get more helpful message here
+        AddErrorMessage("failed to convert BAM file");
+        return false;
+    }
+
+    // index & publish everything (nothing was opened for a dry run)
+    if (!settings_.isStatsOnly && !FinishOutputs())
+        return false;
+    if (checkpoint_)
+        checkpoint_->Remove();
+    for (ConverterBase* companion : companions_) {
+        const bool companionOk = settings_.isStatsOnly || companion->FinishOutputs();
+        companion->AddFilterStatistics();
+        TakeCompanionResults(companion);
+        if (!companionOk)
+            return false;
+    }
+
+    // outputs of every mode moved into place while the others closed & indexed theirs
+    if (!settings_.isStatsOnly && !publisher_->Wait()) {
+        for (const std::string& e : publisher_->Errors())
+            AddErrorMessage(e);
+        return false;
+    }
+
+    // run statistics
+    AddStatistic("non-sequencing ZMWs skipped", numZmwsSkipped_);
+    if (settings_.subsampleFraction < 1.0)
+        AddStatistic("ZMWs outside subsample skipped", numZmwsUnsampled_);
+    if (!settings_.shardLabel.empty())
+        AddStatistic("ZMWs before selected range skipped", numZmwsUnselected_);
+    AddFilterStatistics();
+    if (partIndex_ > 0)
+        AddStatistic("output parts written", partIndex_);
+    AddStatistic("record pool hits", recordPool_.Hits());
+    AddStatistic("record pool misses", recordPool_.Misses());
+
+    // BGZF deflate backend, only when htslib confirms it (linking libdeflate here doesn't switch it)
+#if defined(HTS_FEATURE_LIBDEFLATE)
+    if (hts_features() & HTS_FEATURE_LIBDEFLATE)
+        SetStatistic("BGZF compression via libdeflate", 1);
+#endif
+
     // if we get here, return success
     return true;
 }
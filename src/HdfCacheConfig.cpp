@@ -0,0 +1,149 @@
+// Author: Derek Barnett
+
+#include "HdfCacheConfig.h"
+#include "Settings.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace internal {
+
+// HDF5 defaults (H5Pset_chunk_cache / H5Pset_cache)
+static const size_t DefaultChunkCacheBytes = 1024 * 1024;
+static const size_t DefaultChunkCacheSlots = 521;
+static const double DefaultChunkCacheW0    = 0.75;
+
+// chunks per dataset kept in auto mode: the one being read + the next one
+static const size_t AutoChunksPerDataset = 2;
+
+static bool IsPrime(const size_t n)
+{
+    if (n < 2)
+        return false;
+    for (size_t i = 2; i * i <= n; ++i) {
+        if (n % i == 0)
+            return false;
+    }
+    return true;
+}
+
+// HDF5 recommends a prime slot count ~100x the number of chunks that fit
+static size_t SlotsForChunks(const size_t numChunks)
+{
+    size_t n = std::max(numChunks * 100, DefaultChunkCacheSlots);
+    while (!IsPrime(n))
+        ++n;
+    return n;
+}
+
+} // namespace internal
+
+HdfCacheConfig::HdfCacheConfig(void)
+    : chunkCacheBytes(0)
+    , chunkCacheSlots(0)
+    , chunkCacheW0(-1.0)
+    , metadataCacheBytes(0)
+{ }
+
+HdfCacheConfig::HdfCacheConfig(const Settings& settings)
+    : chunkCacheBytes(settings.chunkCacheBytes)
+    , chunkCacheSlots(settings.chunkCacheSlots)
+    , chunkCacheW0(settings.chunkCacheW0)
+    , metadataCacheBytes(settings.metadataCacheBytes)
+{ }
+
+bool HdfCacheConfig::IsDefault(void) const
+{
+    return chunkCacheBytes == 0 &&
+           chunkCacheSlots == 0 &&
+           chunkCacheW0 < 0.0 &&
+           metadataCacheBytes == 0;
+}
+
+size_t HdfCacheConfig::ChunkCacheBytes(void) const
+{ return (chunkCacheBytes > 0 ? chunkCacheBytes : internal::DefaultChunkCacheBytes); }
+
+bool HdfCacheConfig::FileAccessProperties(H5::FileAccPropList* fapl, std::string* error) const
+{
+    assert(fapl);
+    assert(error);
+
+    if (IsDefault()) {
+        *fapl = H5::FileAccPropList::DEFAULT;
+        return true;
+    }
+
+    // raw-data chunk cache
+    const size_t nbytes = ChunkCacheBytes();
+    const size_t nslots = (chunkCacheSlots > 0 ? chunkCacheSlots : internal::DefaultChunkCacheSlots);
+    const double w0 = (chunkCacheW0 >= 0.0 ? chunkCacheW0 : internal::DefaultChunkCacheW0);
+    try {
+        fapl->setCache(0, nslots, nbytes, w0);
+    } catch (H5::Exception&) {
+        *error = "HDF5 rejected the chunk cache settings";
+        return false;
+    }
+
+    // metadata cache, errors reported here rather than as HDF5's error stack
+    if (metadataCacheBytes > 0) {
+        herr_t status = -1;
+        H5AC_cache_config_t config;
+        config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+        H5E_BEGIN_TRY {
+            status = H5Pget_mdc_config(fapl->getId(), &config);
+            if (status >= 0) {
+                config.set_initial_size = true;
+                config.initial_size = metadataCacheBytes;
+                config.max_size = std::max(config.max_size, metadataCacheBytes);
+                config.min_size = std::min(config.min_size, metadataCacheBytes);
+                status = H5Pset_mdc_config(fapl->getId(), &config);
+            }
+        } H5E_END_TRY;
+        if (status < 0) {
+            *error = "HDF5 rejected the metadata cache size " + std::to_string(metadataCacheBytes);
+            return false;
+        }
+    }
+    return true;
+}
+
+void HdfCacheConfig::SizeToChunks(const H5::Group& group, const size_t maxBytes)
+{
+    size_t largestChunk = 0;
+    size_t smallestChunk = 0;
+
+    const hsize_t numObjects = group.getNumObjs();
+    for (hsize_t i = 0; i < numObjects; ++i) {
+        if (group.getObjTypeByIdx(i) != H5G_DATASET)
+            continue;
+
+        const H5::DataSet dataset = group.openDataSet(group.getObjnameByIdx(i));
+        const H5::DSetCreatPropList dcpl = dataset.getCreatePlist();
+        if (dcpl.getLayout() != H5D_CHUNKED)
+            continue;
+
+        const int rank = dcpl.getChunk(0, nullptr);
+        std::vector<hsize_t> dims(std::max(rank, 1));
+        dcpl.getChunk(rank, dims.data());
+
+        size_t chunkBytes = dataset.getDataType().getSize();
+        for (int d = 0; d < rank; ++d)
+            chunkBytes *= dims[d];
+
+        largestChunk = std::max(largestChunk, chunkBytes);
+        smallestChunk = (smallestChunk == 0 ? chunkBytes : std::min(smallestChunk, chunkBytes));
+    }
+
+    // nothing chunked, keep defaults
+    if (largestChunk == 0)
+        return;
+
+    size_t nbytes = std::max(largestChunk * internal::AutoChunksPerDataset,
+                             internal::DefaultChunkCacheBytes);
+    nbytes = std::min(nbytes, std::max(maxBytes, largestChunk));
+
+    chunkCacheBytes = nbytes;
+    if (chunkCacheSlots == 0)
+        chunkCacheSlots = internal::SlotsForChunks(nbytes / smallestChunk);
+}
@@ -0,0 +1,53 @@
+// Author: Derek Barnett
+
+#ifndef HDFCACHECONFIG_H
+#define HDFCACHECONFIG_H
+
+#include <cstddef>
+#include <string>
+
+#include <H5Cpp.h>
+
+class Settings;
+
+//
+// HdfCacheConfig holds the HDF5 cache settings used when opening a bax.h5.
+//
+// The raw-data chunk cache is set on the file access property list, which
+// makes it the default for every dataset opened in that file (the readers
+// open their datasets internally, so per-dataset access lists can't be
+// passed down). Values left at 0 (or a negative w0) keep the HDF5 default.
+//
+class HdfCacheConfig
+{
+public:
+    // metadata cache sizes HDF5 accepts (H5C__MIN_MAX_CACHE_SIZE, H5C__MAX_MAX_CACHE_SIZE)
+    static const size_t MinMetadataCacheBytes = 1024;
+    static const size_t MaxMetadataCacheBytes = 128 * 1024 * 1024;
+
+public:
+    HdfCacheConfig(void);
+    explicit HdfCacheConfig(const Settings& settings);
+
+public:
+    // true if nothing differs from the HDF5 defaults
+    bool IsDefault(void) const;
+
+    // property list to pass to the reader's Initialize(), false (with error) if HDF5 rejects a setting
+    bool FileAccessProperties(H5::FileAccPropList* fapl, std::string* error) const;
+
+    // chunk cache size per dataset in effect (chunkCacheBytes or the HDF5 default)
+    size_t ChunkCacheBytes(void) const;
+
+    // auto mode: size the per-dataset chunk cache to hold the largest chunk of
+    // any dataset in group (plus read-ahead), capped at maxBytes
+    void SizeToChunks(const H5::Group& group, const size_t maxBytes);
+
+public:
+    size_t chunkCacheBytes;    // per dataset
+    size_t chunkCacheSlots;    // hash table slots per dataset
+    double chunkCacheW0;       // preemption policy, [0,1]
+    size_t metadataCacheBytes; // initial metadata cache size
+};
+
+#endif // HDFCACHECONFIG_H
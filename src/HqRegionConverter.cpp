@@ -1,6 +1,7 @@
 // Author: Derek Barnett
 
 #include "HqRegionConverter.h"
+#include "RegionTableCursor.h"
 
 #include <memory>
 #include <set>
@@ -10,7 +11,6 @@
 #include <pbbam/BamWriter.h>
 
 #include <alignment/utils/RegionUtils.hpp>
-#include <hdf/HDFRegionTableReader.hpp>
 
 using namespace PacBio::BAM;
 
@@ -20,163 +20,237 @@ HqRegionConverter::HqRegionConverter(Settings& settings)
 
 HqRegionConverter::~HqRegionConverter(void) { }
 
-bool HqRegionConverter::ConvertFile(HDFBasReader* reader,
-                                    PacBio::BAM::BamWriter* writer)
-{
-    return ConvertFile(reader, writer, nullptr);
-}
-
-bool HqRegionConverter::ConvertFile(HDFBasReader* reader,
-                                    PacBio::BAM::BamWriter* writer,
-                                    PacBio::BAM::BamWriter* scrapsWriter)
+bool HqRegionConverter::ConvertFile(HDFBasReader* reader)
 {
     assert(reader);
 
-    // read region table info
-    std::unique_ptr<HDFRegionTableReader> const regionTableReader(new HDFRegionTableReader);
-    RegionTable regionTable;
+    // open region table on the reader's file, rows are streamed in as ZMWs are visited
+    RegionTableCursor regionTableCursor(budget_.RegionWindowSize(), budget_.RegionBlockSize());
     std::string fn = filenameForReader_[reader];
     assert(!fn.empty());
-    if (regionTableReader->Initialize(fn) == 0) {
+    if (!regionTableCursor.Initialize(reader->pulseDataGroup)) {
         AddErrorMessage("could not read region table on "+fn);
         return false;
     }
-    regionTable.Reset();
-    regionTableReader->ReadTable(regionTable);
-    regionTableReader->Close();
 
     // initialize read scores
     InitReadScores(reader);
 
+    // non-sequencing ZMWs are only written in internal mode (to scraps)
+    InitHoleStatus(reader);
+    const bool keepNonSequencing = settings_.isInternal && scrapsWriter_;
+
     // fetch records from HDF5 file
     SMRTSequence smrtRecord;
-    int hqStart, hqEnd, score;
-    while (reader->GetNext(smrtRecord)) {
-
-        // attempt get high quality region
-        if (!LookupHQRegion(smrtRecord.zmwData.holeNumber,
-                            regionTable,
-                            hqStart,
-                            hqEnd,
-                            score))
-        {
-            std::stringstream s;
-            s << "could not find HQ region for hole number: " << smrtRecord.zmwData.holeNumber;
-            AddErrorMessage(s.str());
+    while (GetNextZmw(reader, smrtRecord, keepNonSequencing)) {
+
+        // fetch region table rows for this ZMW
+        RegionTable* regionTable = nullptr;
+        try {
+            regionTable = &regionTableCursor.Seek(smrtRecord.zmwData.holeNumber);
+        } catch (std::runtime_error& e) {
+            AddErrorMessage(std::string(e.what()));
             smrtRecord.Free();
             return false;
         }
 
-        // Catch and repair 1-off errors in the HQ region
-        hqEnd = (hqEnd == static_cast<int>(smrtRecord.length)-1) ? smrtRecord.length
-                                                                 : hqEnd;
+        // this mode's records, then any companion modes' from the same read
+        // (into the current output part, outputs may roll over between ZMWs)
+        const bool success = ConvertZmw(smrtRecord, regionTable, writer_.get(), scrapsWriter_.get()) &&
+                             ConvertCompanions(smrtRecord, regionTable);
+        smrtRecord.Free();
+        if (!success)
+            return false;
+    }
+
+    // if we get here, all OK
+    return true;
+}
 
-        // sequencing ZMW
-        if (IsSequencingZmw(smrtRecord))
+bool HqRegionConverter::ConvertZmw(const SMRTSequence& smrtRecord,
+                                   RegionTable* regionTable,
+                                   PacBio::BAM::BamWriter* writer,
+                                   PacBio::BAM::BamWriter* scrapsWriter)
+{
+    if (regionTable == nullptr) {
+        AddErrorMessage("HQ region conversion requires the region table");
+        return false;
+    }
+
+    int hqStart, hqEnd, score;
+
+    // attempt get high quality region
+    if (!LookupHQRegion(smrtRecord.zmwData.holeNumber,
+                        *regionTable,
+                        hqStart,
+                        hqEnd,
+                        score))
+    {
+        std::stringstream s;
+        s << "could not find HQ region for hole number: " << smrtRecord.zmwData.holeNumber;
+        AddErrorMessage(s.str());
+        return false;
+    }
+
+    // Catch and repair 1-off errors in the HQ region
+    hqEnd = (hqEnd == static_cast<int>(smrtRecord.length)-1) ? smrtRecord.length
+                                                             : hqEnd;
+
+    // sequencing ZMW
+    if (IsSequencingZmw(smrtRecord))
+    {
+        // prefiltered HQ regions are dropped, or kept as filtered scraps
+        const bool isFiltered = (hqStart < hqEnd) &&
+                                IsPrefiltered(smrtRecord.zmwData.holeNumber, hqEnd - hqStart, -1);
+
+        // write HQRegion to main BAM file
+        if (hqStart < hqEnd && !isFiltered)
         {
-            // write HQRegion to main BAM file
-            if (hqStart < hqEnd)
+            if (!WriteRecord(smrtRecord,
+                             hqStart,
+                             hqEnd,
+                             ReadGroupId(),
+                             writer))
+            {
+                return false;
+            }
+        }
+
+        // if scraps BAM file present
+        if (scrapsWriter)
+        {
+            // write 5'-end LQ sequence
+            if (hqStart > 0)
             {
-                if (!WriteRecord(smrtRecord,
-                                 hqStart,
-                                 hqEnd,
-                                 ReadGroupId(),
-                                 writer))
+                if (!WriteLowQualityRecord(smrtRecord,
+                                           0,
+                                           hqStart,
+                                           ScrapsReadGroupId(),
+                                           scrapsWriter))
                 {
-                    smrtRecord.Free();
                     return false;
                 }
             }
 
-            // if scraps BAM file present
-            if (scrapsWriter)
+            // write filtered HQRegion
+            if (isFiltered && settings_.isScrappingFiltered)
             {
-                // write 5'-end LQ sequence
-                if (hqStart > 0)
+                if (!WriteFilteredRecord(smrtRecord,
+                                         hqStart,
+                                         hqEnd,
+                                         ScrapsReadGroupId(),
+                                         scrapsWriter))
                 {
-                    if (!WriteLowQualityRecord(smrtRecord,
-                                               0,
-                                               hqStart,
-                                               ScrapsReadGroupId(),
-                                               scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
+                    return false;
                 }
+                ++numFilteredScrapped_;
+            }
 
-                // write 3'-end LQ sequence
-                if (static_cast<size_t>(hqEnd) < smrtRecord.length)
+            // write 3'-end LQ sequence
+            if (static_cast<size_t>(hqEnd) < smrtRecord.length)
+            {
+                if (!WriteLowQualityRecord(smrtRecord,
+                                           hqEnd,
+                                           smrtRecord.length,
+                                           ScrapsReadGroupId(),
+                                           scrapsWriter))
                 {
-                    if (!WriteLowQualityRecord(smrtRecord,
-                                               hqEnd,
-                                               smrtRecord.length,
-                                               ScrapsReadGroupId(),
-                                               scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
+                    return false;
                 }
             }
         }
+    }
 
-        // non-sequencing ZMW
-        else
-        {
-            assert(!IsSequencingZmw(smrtRecord));
+    // non-sequencing ZMW
+    else
+    {
+        assert(!IsSequencingZmw(smrtRecord));
 
-            // only write these if scraps BAM present & we are in 'internal mode'
-            if (settings_.isInternal && scrapsWriter)
+        // only write these if scraps BAM present & we are in 'internal mode'
+        if (settings_.isInternal && scrapsWriter)
+        {
+            // write 5'-end LQ sequence
+            if (hqStart > 0)
             {
-                // write 5'-end LQ sequence
-                if (hqStart > 0)
+                if (!WriteLowQualityRecord(smrtRecord,
+                                           0,
+                                           hqStart,
+                                           ScrapsReadGroupId(),
+                                           scrapsWriter))
                 {
-                    if (!WriteLowQualityRecord(smrtRecord,
-                                               0,
-                                               hqStart,
-                                               ScrapsReadGroupId(),
-                                               scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
+                    return false;
                 }
+            }
 
-                // write HQRegion to scraps BAM file
-                if (hqStart < hqEnd)
+            // write HQRegion to scraps BAM file
+            if (hqStart < hqEnd)
+            {
+                if (!WriteFilteredRecord(smrtRecord,
+                                         hqStart,
+                                         hqEnd,
+                                         ScrapsReadGroupId(),
+                                         scrapsWriter))
                 {
-                    if (!WriteFilteredRecord(smrtRecord,
-                                             hqStart,
-                                             hqEnd,
-                                             ScrapsReadGroupId(),
-                                             scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
+                    return false;
                 }
+            }
 
-                // write 3'-end LQ sequence
-                if (static_cast<size_t>(hqEnd) < smrtRecord.length)
+            // write 3'-end LQ sequence
+            if (static_cast<size_t>(hqEnd) < smrtRecord.length)
+            {
+                if (!WriteLowQualityRecord(smrtRecord,
+                                           hqEnd,
+                                           smrtRecord.length,
+                                           ScrapsReadGroupId(),
+                                           scrapsWriter))
                 {
-                    if (!WriteLowQualityRecord(smrtRecord,
-                                               hqEnd,
-                                               smrtRecord.length,
-                                               ScrapsReadGroupId(),
-                                               scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
+                    return false;
                 }
             }
         }
+    }
 
-        smrtRecord.Free();
+    return true;
+}
+
+bool HqRegionConverter::SurveyZmw(const UInt holeNumber,
+                                  const bool isSequencing,
+                                  const int numBases,
+                                  RegionTable* regionTable)
+{
+    if (regionTable == nullptr) {
+        AddErrorMessage("HQ region conversion requires the region table");
+        return false;
     }
 
-    // if we get here, all OK
+    int hqStart, hqEnd, score;
+    if (!LookupHQRegion(holeNumber, *regionTable, hqStart, hqEnd, score)) {
+        std::stringstream s;
+        s << "could not find HQ region for hole number: " << holeNumber;
+        AddErrorMessage(s.str());
+        return false;
+    }
+    hqEnd = (hqEnd == numBases - 1) ? numBases : hqEnd;
+
+    // same records as ConvertZmw()
+    const bool hasScraps = !settings_.scrapsBamFilename.empty();
+    if (hqStart < hqEnd) {
+        if (!isSequencing)
+            SurveyRecord("filtered HQ region", hqEnd - hqStart, true);
+        else if (IsPrefiltered(holeNumber, hqEnd - hqStart, -1)) {
+            if (settings_.isScrappingFiltered && hasScraps) {
+                SurveyRecord("filtered HQ region", hqEnd - hqStart, true);
+                ++numFilteredScrapped_;
+            }
+        } else
+            SurveyRecord("HQ region", hqEnd - hqStart, false);
+    }
+    if (hasScraps) {
+        if (hqStart > 0)
+            SurveyRecord("LQ region", hqStart, true);
+        if (hqEnd < numBases)
+            SurveyRecord("LQ region", numBases - hqEnd, true);
+    }
     return true;
 }
 
@@ -1,6 +1,7 @@
 // Author: Derek Barnett
 
 #include "IConverter.h"
+#include "OutputPublisher.h"
 #include <pbbam/BamRecord.h>
 #include <algorithm>
 #include <iostream>
@@ -17,10 +18,37 @@ IConverter::IConverter(Settings& settings)
 
 IConverter::~IConverter(void) { }
 
+void IConverter::SetPublisher(const std::shared_ptr<OutputPublisher>& publisher)
+{ publisher_ = publisher; }
+
 void IConverter::AddErrorMessage(const std::string& e)
 { errors_.push_back(e); }
 
-BamHeader IConverter::CreateHeader(const std::string& modeString)
+void IConverter::AddStatistic(const std::string& name, const uint64_t value)
+{
+    // repeated names accumulate (e.g. per-file counts)
+    for (auto& stat : statistics_) {
+        if (stat.first == name) {
+            stat.second += value;
+            return;
+        }
+    }
+    statistics_.push_back(std::make_pair(name, value));
+}
+
+void IConverter::SetStatistic(const std::string& name, const uint64_t value)
+{
+    for (auto& stat : statistics_) {
+        if (stat.first == name) {
+            stat.second = value;
+            return;
+        }
+    }
+    statistics_.push_back(std::make_pair(name, value));
+}
+
+BamHeader IConverter::CreateHeader(const std::string& modeString,
+                                   const bool withPulseFeatures)
 {
     BamHeader header;
 
@@ -37,23 +65,25 @@ BamHeader IConverter::CreateHeader(const std::string& modeString)
       .BasecallerVersion(basecallerVersion_)
       .FrameRateHz(frameRateHz_);
 
-    if (settings_.usingDeletionQV)      rg.BaseFeatureTag(BaseFeature::DELETION_QV,      "dq");
-    if (settings_.usingDeletionTag)     rg.BaseFeatureTag(BaseFeature::DELETION_TAG,     "dt");
-    if (settings_.usingInsertionQV)     rg.BaseFeatureTag(BaseFeature::INSERTION_QV,     "iq");
-    if (settings_.usingMergeQV)         rg.BaseFeatureTag(BaseFeature::MERGE_QV,         "mq");
-    if (settings_.usingSubstitutionQV)  rg.BaseFeatureTag(BaseFeature::SUBSTITUTION_QV,  "sq");
-    if (settings_.usingSubstitutionTag) rg.BaseFeatureTag(BaseFeature::SUBSTITUTION_TAG, "st");
-    if (settings_.usingIPD) {
-        FrameCodec codec = FrameCodec::V1;
-        if (settings_.losslessFrames)
-            codec = FrameCodec::RAW;
-        rg.IpdCodec(codec, "ip");
-    }
-    if (settings_.usingPulseWidth) {
-        FrameCodec codec = FrameCodec::V1;
-        if (settings_.losslessFrames)
-            codec = FrameCodec::RAW;
-        rg.PulseWidthCodec(codec, "pw");
+    if (withPulseFeatures) {
+        if (settings_.usingDeletionQV)      rg.BaseFeatureTag(BaseFeature::DELETION_QV,      "dq");
+        if (settings_.usingDeletionTag)     rg.BaseFeatureTag(BaseFeature::DELETION_TAG,     "dt");
+        if (settings_.usingInsertionQV)     rg.BaseFeatureTag(BaseFeature::INSERTION_QV,     "iq");
+        if (settings_.usingMergeQV)         rg.BaseFeatureTag(BaseFeature::MERGE_QV,         "mq");
+        if (settings_.usingSubstitutionQV)  rg.BaseFeatureTag(BaseFeature::SUBSTITUTION_QV,  "sq");
+        if (settings_.usingSubstitutionTag) rg.BaseFeatureTag(BaseFeature::SUBSTITUTION_TAG, "st");
+        if (settings_.usingIPD) {
+            FrameCodec codec = FrameCodec::V1;
+            if (settings_.losslessFrames)
+                codec = FrameCodec::RAW;
+            rg.IpdCodec(codec, "ip");
+        }
+        if (settings_.usingPulseWidth) {
+            FrameCodec codec = FrameCodec::V1;
+            if (settings_.losslessFrames)
+                codec = FrameCodec::RAW;
+            rg.PulseWidthCodec(codec, "pw");
+        }
     }
 
     header.AddReadGroup(rg);
@@ -76,3 +106,6 @@ BamHeader IConverter::CreateHeader(const std::string& modeString)
 
 std::vector<std::string> IConverter::Errors(void) const
 { return errors_; }
+
+std::vector<std::pair<std::string, uint64_t> > IConverter::Statistics(void) const
+{ return statistics_; }
@@ -3,8 +3,11 @@
 #ifndef ICONVERTER_H
 #define ICONVERTER_H
 
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <pbbam/BamHeader.h>
@@ -21,6 +24,8 @@ class BamRecordImpl;
 } // namespace BAM
 } // namespace PacBio
 
+class OutputPublisher;
+
 class IConverter
 {
 public:
@@ -28,14 +33,22 @@ public:
 
 public:
     virtual std::vector<std::string> Errors(void) const final;
+    virtual std::vector<std::pair<std::string, uint64_t> > Statistics(void) const final;
     virtual bool Run(void) =0;
 
+    // stages outputs through publisher (--tmpdir) instead of a publisher of its own
+    virtual void SetPublisher(const std::shared_ptr<OutputPublisher>& publisher) final;
+
 protected:
     IConverter(Settings& settings);
 
     virtual void AddErrorMessage(const std::string& e) final;
+    virtual void AddStatistic(const std::string& name, const uint64_t value) final;
+    virtual void SetStatistic(const std::string& name, const uint64_t value) final;
 
-    virtual PacBio::BAM::BamHeader CreateHeader(const std::string& modeString) final;
+    // withPulseFeatures = false advertises no base features (lean scraps)
+    virtual PacBio::BAM::BamHeader CreateHeader(const std::string& modeString,
+                                                const bool withPulseFeatures = true) final;
 
     virtual std::string HeaderReadType(void) const =0;
     virtual std::string OutputFileSuffix(void) const =0;
@@ -44,6 +57,10 @@ protected:
     // common state
     Settings& settings_;
     std::vector<std::string> errors_;
+    std::vector<std::pair<std::string, uint64_t> > statistics_; // in order first reported
+
+    // moves staged outputs into place, one per run (shared by all modes & the dataset XML)
+    std::shared_ptr<OutputPublisher> publisher_;
 
     // run info for BamHeader creation
     std::string bindingKit_;
@@ -0,0 +1,220 @@
+// Author: Derek Barnett
+
+#include "InputPrefetcher.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace internal {
+
+// scratch buffer for ReadMode
+static const size_t ReadBufferSize = 4 * 1024 * 1024;
+
+} // namespace internal
+
+InputPrefetcher::InputPrefetcher(const Mode mode)
+    : mode_(mode)
+    , fd_(-1)
+    , isDone_(false)
+    , bytesPrefetched_(0)
+{ }
+
+InputPrefetcher::~InputPrefetcher(void)
+{ Close(); }
+
+bool InputPrefetcher::Open(const std::string& filename)
+{
+    Close();
+
+    fd_ = open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        return false;
+
+    isDone_ = false;
+    thread_ = std::thread(&InputPrefetcher::Run, this);
+    return true;
+}
+
+void InputPrefetcher::Close(void)
+{
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            isDone_ = true;
+            queue_.clear();
+        }
+        condition_.notify_one();
+        thread_.join();
+    }
+
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+
+    for (const DatasetLayout& layout : datasets_)
+        H5Idec_ref(layout.id);
+    datasets_.clear();
+}
+
+bool InputPrefetcher::AddDataset(const H5::DataSet& dataset)
+{
+    const H5::DataSpace space = dataset.getSpace();
+    if (space.getSimpleExtentNdims() != 1)
+        return false;
+
+    DatasetLayout layout;
+    layout.id = dataset.getId();
+    layout.elementSize = dataset.getDataType().getSize();
+    space.getSimpleExtentDims(&layout.numElements);
+    layout.chunkSize = 0;
+    layout.contiguousOffset = HADDR_UNDEF;
+
+    const H5::DSetCreatPropList dcpl = dataset.getCreatePlist();
+    switch (dcpl.getLayout())
+    {
+        case H5D_CHUNKED :
+        {
+#if H5_VERSION_GE(1,10,5)
+            dcpl.getChunk(1, &layout.chunkSize);
+            break;
+#else
+            // chunk addresses can't be queried before 1.10.5
+            return false;
+#endif
+        }
+        case H5D_CONTIGUOUS :
+        {
+            layout.contiguousOffset = H5Dget_offset(layout.id);
+            if (layout.contiguousOffset == HADDR_UNDEF)
+                return false;
+            break;
+        }
+        default:
+            return false;
+    }
+
+    // keep the dataset open for chunk lookups
+    H5Iinc_ref(layout.id);
+    datasets_.push_back(layout);
+    return true;
+}
+
+void InputPrefetcher::AddRanges(const DatasetLayout& layout,
+                                const uint64_t begin,
+                                const uint64_t end,
+                                std::vector<ByteRange>* ranges) const
+{
+    assert(ranges);
+
+    const uint64_t last = std::min(end, static_cast<uint64_t>(layout.numElements));
+    if (begin >= last)
+        return;
+
+    // contiguous: one range
+    if (layout.chunkSize == 0) {
+        ranges->push_back(ByteRange{ layout.contiguousOffset + begin * layout.elementSize,
+                                     (last - begin) * layout.elementSize });
+        return;
+    }
+
+#if H5_VERSION_GE(1,10,5)
+    // chunked: every (stored) chunk overlapping the range
+    for (hsize_t chunk = begin / layout.chunkSize; chunk * layout.chunkSize < last; ++chunk) {
+        const hsize_t coord = chunk * layout.chunkSize;
+        unsigned filterMask = 0;
+        haddr_t address = HADDR_UNDEF;
+        hsize_t size = 0;
+        if (H5Dget_chunk_info_by_coord(layout.id, &coord, &filterMask, &address, &size) >= 0 &&
+            address != HADDR_UNDEF && size > 0)
+        {
+            ranges->push_back(ByteRange{ address, size });
+        }
+    }
+#endif
+}
+
+void InputPrefetcher::Prefetch(const uint64_t begin, const uint64_t end)
+{
+    Prefetch(std::vector<std::pair<uint64_t, uint64_t> >(1, std::make_pair(begin, end)));
+}
+
+void InputPrefetcher::Prefetch(const std::vector<std::pair<uint64_t, uint64_t> >& baseRanges)
+{
+    if (fd_ < 0 || datasets_.empty())
+        return;
+
+    // look up chunk addresses here, HDF5 must only be called from the converter thread
+    std::vector<ByteRange> ranges;
+    for (const DatasetLayout& layout : datasets_) {
+        for (const auto& baseRange : baseRanges)
+            AddRanges(layout, baseRange.first, baseRange.second, &ranges);
+    }
+    if (ranges.empty())
+        return;
+
+    // merge neighboring & shared ranges, datasets are usually laid out near each other
+    std::sort(ranges.begin(), ranges.end(), [](const ByteRange& lhs, const ByteRange& rhs)
+                                            { return lhs.offset < rhs.offset; });
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ByteRange current = ranges.front();
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            if (ranges[i].offset <= current.offset + current.length) {
+                current.length = std::max(current.length,
+                                          ranges[i].offset + ranges[i].length - current.offset);
+            } else {
+                queue_.push_back(current);
+                current = ranges[i];
+            }
+        }
+        queue_.push_back(current);
+    }
+    condition_.notify_one();
+}
+
+uint64_t InputPrefetcher::BytesPrefetched(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytesPrefetched_;
+}
+
+void InputPrefetcher::Run(void)
+{
+    std::vector<char> buffer;
+    if (mode_ == ReadMode)
+        buffer.resize(internal::ReadBufferSize);
+
+    while (true) {
+
+        ByteRange range;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return isDone_ || !queue_.empty(); });
+            if (isDone_)
+                return;
+            range = queue_.front();
+            queue_.pop_front();
+        }
+
+        if (mode_ == AdviseMode) {
+            posix_fadvise(fd_, range.offset, range.length, POSIX_FADV_WILLNEED);
+        } else {
+            uint64_t offset = range.offset;
+            const uint64_t end = range.offset + range.length;
+            while (offset < end) {
+                const size_t length = std::min(static_cast<uint64_t>(buffer.size()), end - offset);
+                const ssize_t numRead = pread(fd_, buffer.data(), length, offset);
+                if (numRead <= 0)
+                    break;
+                offset += numRead;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        bytesPrefetched_ += range.length;
+    }
+}
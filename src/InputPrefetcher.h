@@ -0,0 +1,91 @@
+// Author: Derek Barnett
+
+#ifndef INPUTPREFETCHER_H
+#define INPUTPREFETCHER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <H5Cpp.h>
+
+//
+// InputPrefetcher warms the page cache for upcoming bax.h5 reads.
+//
+// The converter thread tells it which per-base datasets will be read and,
+// ahead of time, which base range the next batch of ZMWs covers. File byte
+// ranges are worked out from each dataset's chunk layout and handed to a
+// background thread, which either issues posix_fadvise(WILLNEED) or (for
+// network filesystems that ignore advice) reads the ranges itself, so the
+// data is resident by the time HDF5 asks for it.
+//
+class InputPrefetcher
+{
+public:
+    enum Mode { AdviseMode // posix_fadvise(WILLNEED)
+              , ReadMode   // explicit pread into a scratch buffer
+              };
+
+public:
+    explicit InputPrefetcher(const Mode mode = AdviseMode);
+    ~InputPrefetcher(void);
+
+public:
+    bool Open(const std::string& filename);
+    void Close(void);
+
+    // registers a 1-D per-base dataset, returns false if its layout isn't supported
+    bool AddDataset(const H5::DataSet& dataset);
+
+    // queues the byte ranges holding bases [begin, end) of every registered dataset
+    void Prefetch(const uint64_t begin, const uint64_t end);
+
+    // as above for several base ranges at once, byte ranges they share are queued once
+    void Prefetch(const std::vector<std::pair<uint64_t, uint64_t> >& baseRanges);
+
+    uint64_t BytesPrefetched(void) const;
+
+private:
+    struct ByteRange
+    {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct DatasetLayout
+    {
+        hid_t id;
+        size_t elementSize;
+        hsize_t numElements;
+        hsize_t chunkSize;     // elements per chunk, 0 if contiguous
+        haddr_t contiguousOffset;
+    };
+
+private:
+    void AddRanges(const DatasetLayout& layout,
+                   const uint64_t begin,
+                   const uint64_t end,
+                   std::vector<ByteRange>* ranges) const;
+    void Run(void);
+
+private:
+    Mode mode_;
+    int fd_;
+    std::vector<DatasetLayout> datasets_;
+
+    // background thread & its queue
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<ByteRange> queue_;
+    bool isDone_;
+    uint64_t bytesPrefetched_;
+};
+
+#endif // INPUTPREFETCHER_H
@@ -0,0 +1,96 @@
+// Author: Derek Barnett
+
+#include "InputPreloader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+
+InputPreloader::InputPreloader(const size_t maxThreads, const size_t headBytes)
+    : maxThreads_(std::max(maxThreads, static_cast<size_t>(1)))
+    , headBytes_(headBytes)
+{ }
+
+std::vector<PreloadedInput> InputPreloader::Run(const std::vector<std::string>& filenames) const
+{
+    std::vector<PreloadedInput> inputs(filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i)
+        inputs[i].filename = filenames[i];
+
+    // each thread takes the next unclaimed input
+    std::atomic<size_t> next(0);
+    auto worker = [this, &inputs, &next]() {
+        size_t i;
+        while ((i = next++) < inputs.size())
+            Preload(&inputs[i]);
+    };
+
+    const size_t numThreads = std::min(maxThreads_, inputs.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < numThreads; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& t : threads)
+        t.join();
+
+    return inputs;
+}
+
+void InputPreloader::Preload(PreloadedInput* input) const
+{
+    assert(input);
+
+    // check input is readable & warm its head
+    const int fd = open(input->filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        input->error = "could not open " + input->filename + ": " + std::strerror(errno);
+        return;
+    }
+    if (headBytes_ > 0) {
+        posix_fadvise(fd, 0, headBytes_, POSIX_FADV_WILLNEED);
+        std::vector<char> buffer(std::min(headBytes_, static_cast<size_t>(64 * 1024)));
+        size_t offset = 0;
+        while (offset < headBytes_) {
+            const ssize_t n = pread(fd, buffer.data(), std::min(buffer.size(), headBytes_ - offset), offset);
+            if (n <= 0)
+                break;
+            offset += n;
+        }
+    }
+    close(fd);
+}
+
+std::string InputPreloader::MetadataXmlPath(const std::string& baxFn,
+                                            const std::string& movieName)
+{
+    // get the absolute path of the bax.h5 file and go up 2 directories
+    char buf[PATH_MAX + 1];
+    char *res = realpath(baxFn.c_str(), buf);
+
+    if (res == nullptr)
+        return std::string();
+
+    // up 1
+    res = dirname(res);
+
+    if (res == nullptr)
+        return std::string();
+
+    // up 2
+    res = dirname(res);
+
+    if (res == nullptr)
+        return std::string();
+
+    std::string prefix(res);
+    return prefix + '/' + movieName + ".metadata.xml";
+}
@@ -0,0 +1,53 @@
+// Author: Derek Barnett
+
+#ifndef INPUTPRELOADER_H
+#define INPUTPRELOADER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//
+// InputPreloader does the I/O-bound part of startup for all inputs at once.
+//
+// HDF5 can't be called from several threads (a thread-safe build serializes
+// every call anyway), so the header scans that follow (ConverterBase::
+// ScanBaxFiles) take turns for their HDF5 reads. What can run concurrently is
+// everything around them: checking each input can be opened & pulling the
+// head of each file (superblock, root & ScanData object headers) into the
+// page cache, so those HDF5 reads don't wait on storage. A movie's
+// metadata.xml is only read by the scans, for files lacking the chemistry.
+//
+struct PreloadedInput
+{
+    std::string filename;
+    std::string error;           // empty if the file could be opened
+};
+
+class InputPreloader
+{
+public:
+    static const size_t DefaultHeadBytes = 1024 * 1024;
+    static const size_t DefaultMaxThreads = 8;
+
+public:
+    explicit InputPreloader(const size_t maxThreads = DefaultMaxThreads,
+                            const size_t headBytes = DefaultHeadBytes);
+
+public:
+    std::vector<PreloadedInput> Run(const std::vector<std::string>& filenames) const;
+
+public:
+    // <dir of bax>/../<movieName>.metadata.xml, empty if the bax path can't be resolved
+    static std::string MetadataXmlPath(const std::string& baxFn,
+                                       const std::string& movieName);
+
+private:
+    void Preload(PreloadedInput* input) const;
+
+private:
+    size_t maxThreads_;
+    size_t headBytes_;
+};
+
+#endif // INPUTPRELOADER_H
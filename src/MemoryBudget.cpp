@@ -0,0 +1,159 @@
+// Author: Derek Barnett
+
+#include "MemoryBudget.h"
+#include "BamRecordPool.h"
+#include "RegionTableCursor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
+
+namespace internal {
+
+// untracked allocations: HDF5 metadata & chunk caches, library state
+static const size_t ReservedBytes = 96 * 1024 * 1024;
+
+// rough resident cost of one ZMW in the region window (rows + map node)
+static const size_t BytesPerWindowHole = 512;
+
+// raw region table row: 5 x int32
+static const size_t BytesPerRegionRow = 20;
+
+// preloaded: hole number -> index entry + float score
+static const size_t BytesPerReadScore = 12;
+
+// streamed: hole number + float score, per ZMW in a block
+static const size_t BytesPerStreamedReadScore = 8;
+
+// BGZF blocks in flight per compression thread (input + output, queued)
+static const size_t BytesPerWriterThread = 1024 * 1024;
+
+static const size_t DefaultWriterThreads = 4;
+
+// datasets read in lockstep, each with its own chunk cache
+static const size_t CachedDatasets = 10;
+
+// pooled record buffers: a long polymerase read with all pulse features
+static const size_t BytesPerPooledRecord = 256 * 1024;
+
+template<typename T>
+inline T Clamp(const T value, const T low, const T high)
+{ return std::max(low, std::min(value, high)); }
+
+} // namespace internal
+
+MemoryBudget::MemoryBudget(const size_t maxBytes)
+    : maxBytes_(maxBytes)
+{ }
+
+bool MemoryBudget::IsLimited(void) const
+{ return maxBytes_ != Unlimited; }
+
+size_t MemoryBudget::MaxBytes(void) const
+{ return maxBytes_; }
+
+size_t MemoryBudget::Share(const double fraction) const
+{
+    assert(IsLimited());
+    if (maxBytes_ <= internal::ReservedBytes)
+        return 0;
+    return static_cast<size_t>((maxBytes_ - internal::ReservedBytes) * fraction);
+}
+
+size_t MemoryBudget::RegionWindowSize(void) const
+{
+    if (!IsLimited())
+        return RegionTableCursor::DefaultWindowSize;
+    return internal::Clamp(Share(0.25) / internal::BytesPerWindowHole,
+                           static_cast<size_t>(64),
+                           static_cast<size_t>(65536));
+}
+
+size_t MemoryBudget::RegionBlockSize(void) const
+{
+    if (!IsLimited())
+        return RegionTableCursor::DefaultBlockSize;
+    return internal::Clamp(Share(0.05) / internal::BytesPerRegionRow,
+                           static_cast<size_t>(256),
+                           RegionTableCursor::DefaultBlockSize);
+}
+
+bool MemoryBudget::CanPreloadReadScores(const size_t numZmws) const
+{
+    if (!IsLimited())
+        return true;
+    return numZmws * internal::BytesPerReadScore <= Share(0.10);
+}
+
+size_t MemoryBudget::ReadScoreBlockSize(void) const
+{
+    if (!IsLimited())
+        return RegionTableCursor::DefaultBlockSize;
+    return internal::Clamp(Share(0.01) / internal::BytesPerStreamedReadScore,
+                           static_cast<size_t>(256),
+                           RegionTableCursor::DefaultBlockSize);
+}
+
+size_t MemoryBudget::MaxReadBytes(void) const
+{
+    if (!IsLimited())
+        return std::numeric_limits<size_t>::max();
+    return Share(0.25);
+}
+
+size_t MemoryBudget::WriterThreads(void) const
+{
+    if (!IsLimited())
+        return internal::DefaultWriterThreads;
+    return internal::Clamp(Share(0.05) / internal::BytesPerWriterThread,
+                           static_cast<size_t>(1),
+                           internal::DefaultWriterThreads);
+}
+
+size_t MemoryBudget::RecordPoolSize(void) const
+{
+    if (!IsLimited())
+        return BamRecordPool::DefaultMaxIdle;
+    return internal::Clamp(Share(0.05) / internal::BytesPerPooledRecord,
+                           static_cast<size_t>(1),
+                           BamRecordPool::DefaultMaxIdle);
+}
+
+size_t MemoryBudget::MaxChunkCacheBytes(void) const
+{
+    if (!IsLimited())
+        return std::numeric_limits<size_t>::max();
+    return Share(0.25) / internal::CachedDatasets;
+}
+
+bool MemoryBudget::ParseSize(const std::string& s, size_t* bytes)
+{
+    assert(bytes);
+
+    if (s.empty() || !std::isdigit(static_cast<unsigned char>(s.front())))
+        return false;
+
+    char* suffix = nullptr;
+    errno = 0;
+    const unsigned long long value = std::strtoull(s.c_str(), &suffix, 10);
+    if (errno == ERANGE)
+        return false;
+
+    size_t multiplier = 1;
+    const std::string unit(suffix);
+    if      (unit.empty())                  multiplier = 1;
+    else if (unit == "K" || unit == "k")    multiplier = 1ULL << 10;
+    else if (unit == "M" || unit == "m")    multiplier = 1ULL << 20;
+    else if (unit == "G" || unit == "g")    multiplier = 1ULL << 30;
+    else if (unit == "T" || unit == "t")    multiplier = 1ULL << 40;
+    else
+        return false;
+
+    if (value > std::numeric_limits<size_t>::max() / multiplier)
+        return false;
+    *bytes = static_cast<size_t>(value) * multiplier;
+    return true;
+}
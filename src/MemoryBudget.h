@@ -0,0 +1,64 @@
+// Author: Derek Barnett
+
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <cstddef>
+#include <string>
+
+//
+// MemoryBudget translates a user-requested memory limit (--max-memory) into
+// sizes for the buffers & tables held during conversion.
+//
+// With no limit, the defaults match the behavior of an unconstrained run.
+// With a limit, each consumer gets a fixed share of the budget (after a
+// reserve for library/HDF5 overhead). Anything that no longer fits is
+// streamed from disk instead, trading speed for a smaller resident set.
+//
+class MemoryBudget
+{
+public:
+    static const size_t Unlimited = 0;
+
+public:
+    explicit MemoryBudget(const size_t maxBytes = Unlimited);
+
+public:
+    bool IsLimited(void) const;
+    size_t MaxBytes(void) const;
+
+    // region table cursor: hole numbers per window & rows per disk read
+    size_t RegionWindowSize(void) const;
+    size_t RegionBlockSize(void) const;
+
+    // ZMW metric tables (e.g. ReadScore), otherwise streamed in blocks of ReadScoreBlockSize() ZMWs
+    bool CanPreloadReadScores(const size_t numZmws) const;
+    size_t ReadScoreBlockSize(void) const;
+
+    // buffers for a single read (bases, pulse features & its BAM records),
+    // conversion stops with an error rather than exceed this
+    size_t MaxReadBytes(void) const;
+
+    // BGZF compression threads per output BAM, bounds in-flight blocks
+    size_t WriterThreads(void) const;
+
+    // idle BAM records kept for re-use
+    size_t RecordPoolSize(void) const;
+
+    // upper bound for an automatically sized HDF5 chunk cache (per dataset)
+    size_t MaxChunkCacheBytes(void) const;
+
+public:
+    // parses sizes like "512M", "4G", "1048576" (suffixes: K, M, G, T), false if
+    // malformed or too large for size_t. "0" is valid, callers that need a
+    // non-zero size check for it.
+    static bool ParseSize(const std::string& s, size_t* bytes);
+
+private:
+    size_t Share(const double fraction) const;
+
+private:
+    size_t maxBytes_;
+};
+
+#endif // MEMORYBUDGET_H
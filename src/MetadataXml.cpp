@@ -0,0 +1,262 @@
+// Author: Derek Barnett
+
+#include "MetadataXml.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+namespace internal {
+
+// reads up to (and consumes) delimiter, false on EOF
+static bool ReadUntil(std::istream& in, const std::string& delimiter, std::string* text)
+{
+    assert(!delimiter.empty());
+    text->clear();
+    char c;
+    while (in.get(c)) {
+        text->push_back(c);
+        if (text->size() >= delimiter.size() &&
+            text->compare(text->size() - delimiter.size(), delimiter.size(), delimiter) == 0)
+        {
+            text->erase(text->size() - delimiter.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+// reads the rest of a tag (after '<'), honoring quoted attribute values
+static bool ReadTag(std::istream& in, std::string* tag)
+{
+    tag->clear();
+    char quote = 0;
+    char c;
+    while (in.get(c)) {
+        if (quote) {
+            if (c == quote)
+                quote = 0;
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            return true;
+        }
+        tag->push_back(c);
+    }
+    return false;
+}
+
+// element name without any namespace prefix ("pbmeta:BindingKit" -> "BindingKit")
+static std::string LocalName(const std::string& tag, const size_t start)
+{
+    size_t end = start;
+    while (end < tag.size() && tag[end] != '/' && tag[end] != ' ' &&
+           tag[end] != '\t' && tag[end] != '\n' && tag[end] != '\r')
+    {
+        ++end;
+    }
+    const size_t colon = tag.rfind(':', end);
+    const size_t nameStart = (colon != std::string::npos && colon >= start) ? colon + 1 : start;
+    return tag.substr(nameStart, end - nameStart);
+}
+
+static void AppendUtf8(const unsigned long codePoint, std::string* out)
+{
+    if (codePoint < 0x80) {
+        out->push_back(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        out->push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out->push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        out->push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        out->push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+// appends character data, resolving predefined & numeric references in one
+// pass (so "&amp;lt;" stays "&lt;"), false on an unknown or malformed one
+static bool AppendDecoded(const std::string& text, std::string* out)
+{
+    static const char* entities[][2] = { {"lt", "<"}, {"gt", ">"}, {"quot", "\""},
+                                         {"apos", "'"}, {"amp", "&"} };
+    size_t pos = 0;
+    while (pos < text.size()) {
+        const size_t amp = text.find('&', pos);
+        if (amp == std::string::npos) {
+            out->append(text, pos, std::string::npos);
+            break;
+        }
+        out->append(text, pos, amp - pos);
+        const size_t semicolon = text.find(';', amp);
+        if (semicolon == std::string::npos)
+            return false;
+        const std::string name = text.substr(amp + 1, semicolon - amp - 1);
+
+        if (name.size() > 1 && name[0] == '#') {
+            const bool isHex = (name[1] == 'x' || name[1] == 'X');
+            const std::string digits = name.substr(isHex ? 2 : 1);
+            char* end = nullptr;
+            const unsigned long codePoint = std::strtoul(digits.c_str(), &end, isHex ? 16 : 10);
+            if (digits.empty() || *end != '\0' || codePoint == 0 || codePoint > 0x10FFFF)
+                return false;
+            AppendUtf8(codePoint, out);
+        } else {
+            bool isKnown = false;
+            for (const auto& entity : entities) {
+                if (name == entity[0]) {
+                    out->append(entity[1]);
+                    isKnown = true;
+                    break;
+                }
+            }
+            if (!isKnown)
+                return false;
+        }
+        pos = semicolon + 1;
+    }
+    return true;
+}
+
+} // namespace internal
+
+bool MetadataXml::ReadChemistry(const std::string& filename, MetadataChemistry* chemistry)
+{
+    assert(chemistry);
+
+    std::ifstream in(filename);
+    if (!in)
+        return false;
+    if (ScanChemistry(in, chemistry))
+        return true;
+    return ParseChemistry(filename, chemistry);
+}
+
+bool MetadataXml::ScanChemistry(std::istream& in, MetadataChemistry* chemistry)
+{
+    assert(chemistry);
+
+    // element paths of interest (local names), & where their text goes
+    struct Field
+    {
+        std::vector<std::string> path;
+        std::string* value;
+        bool found;
+    };
+    Field fields[] = {
+        { { "Metadata", "BindingKit", "PartNumber" },    &chemistry->bindingKit,        false },
+        { { "Metadata", "SequencingKit", "PartNumber" }, &chemistry->sequencingKit,     false },
+        { { "Metadata", "InstCtrlVer" },                 &chemistry->basecallerVersion, false }
+    };
+    size_t numFound = 0;
+
+    std::vector<std::string> path;
+    std::string text;
+    std::string tag;
+    Field* current = nullptr; // field whose element is open
+
+    // only the field element's own text counts, not that of any children (as in a ptree)
+    auto isDirectChild = [&]() { return current && path.size() == current->path.size(); };
+
+    while (numFound < 3) {
+
+        // text up to the next tag
+        if (!internal::ReadUntil(in, "<", &text))
+            return false;
+        if (isDirectChild() && !internal::AppendDecoded(text, current->value))
+            return false;
+
+        // skip comments, declarations & processing instructions, CDATA is text as-is
+        const int next = in.peek();
+        if (next == '!') {
+            std::string skipped;
+            char start[3] = { };
+            in.read(start, 3);
+            if (std::string(start, 3) == "!--") {
+                if (!internal::ReadUntil(in, "-->", &skipped))
+                    return false;
+            } else if (std::string(start, 3) == "![C") {
+                if (!internal::ReadUntil(in, "[", &skipped) ||
+                    !internal::ReadUntil(in, "]]>", &skipped))
+                {
+                    return false;
+                }
+                if (isDirectChild())
+                    *current->value += skipped;
+            } else if (!internal::ReadTag(in, &skipped)) {
+                return false;
+            }
+            continue;
+        }
+        if (next == '?') {
+            std::string skipped;
+            if (!internal::ReadUntil(in, "?>", &skipped))
+                return false;
+            continue;
+        }
+
+        if (!internal::ReadTag(in, &tag))
+            return false;
+
+        // end tag
+        if (!tag.empty() && tag[0] == '/') {
+            if (isDirectChild()) {
+                current->found = true;
+                ++numFound;
+                current = nullptr;
+            }
+            if (!path.empty())
+                path.pop_back();
+            continue;
+        }
+
+        // start (or empty) tag
+        const bool isEmpty = (!tag.empty() && tag.back() == '/');
+        path.push_back(internal::LocalName(tag, 0));
+
+        if (current == nullptr) {
+            for (Field& field : fields) {
+                if (!field.found && field.path == path) {
+                    current = &field;
+                    current->value->clear();
+                    break;
+                }
+            }
+        }
+
+        if (isEmpty) {
+            if (isDirectChild()) {
+                current->found = true;
+                ++numFound;
+                current = nullptr;
+            }
+            path.pop_back();
+        }
+    }
+    return true;
+}
+
+bool MetadataXml::ParseChemistry(const std::string& filename, MetadataChemistry* chemistry)
+{
+    using boost::property_tree::ptree;
+
+    try {
+        ptree pt;
+        read_xml(filename, pt);
+        chemistry->bindingKit        = pt.get<std::string>("Metadata.BindingKit.PartNumber");
+        chemistry->sequencingKit     = pt.get<std::string>("Metadata.SequencingKit.PartNumber");
+        chemistry->basecallerVersion = pt.get<std::string>("Metadata.InstCtrlVer");
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
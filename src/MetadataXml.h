@@ -0,0 +1,40 @@
+// Author: Derek Barnett
+
+#ifndef METADATAXML_H
+#define METADATAXML_H
+
+#include <istream>
+#include <string>
+
+// chemistry triple from a <movie>.metadata.xml
+struct MetadataChemistry
+{
+    std::string bindingKit;        // Metadata/BindingKit/PartNumber
+    std::string sequencingKit;     // Metadata/SequencingKit/PartNumber
+    std::string basecallerVersion; // Metadata/InstCtrlVer
+};
+
+//
+// MetadataXml pulls the chemistry triple out of a movie's metadata.xml.
+//
+// Rather than building a full property tree, the document is scanned as a
+// stream of tags, tracking only the current element path, & reading stops as
+// soon as all three fields have been seen. Elements are matched on their
+// local name, so namespace-prefixed tags (<pbmeta:BindingKit>) are found too.
+// As with boost::property_tree, a field's value is its own text (& CDATA),
+// not that of any child elements. Anything the scanner doesn't find falls
+// back to a full ptree parse.
+//
+class MetadataXml
+{
+public:
+    static bool ReadChemistry(const std::string& filename, MetadataChemistry* chemistry);
+
+    // streaming scan only, false if any field is missing
+    static bool ScanChemistry(std::istream& in, MetadataChemistry* chemistry);
+
+private:
+    static bool ParseChemistry(const std::string& filename, MetadataChemistry* chemistry);
+};
+
+#endif // METADATAXML_H
@@ -0,0 +1,219 @@
+// Author: Derek Barnett
+
+#include "OutputPublisher.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace internal {
+
+static const size_t CopyBufferSize = 4 * 1024 * 1024;
+
+static std::string Basename(const std::string& path)
+{
+    const size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos)
+        return path;
+    return path.substr(slash + 1);
+}
+
+static std::string ErrorString(const std::string& what, const std::string& path)
+{ return what + " " + path + ": " + std::strerror(errno); }
+
+static bool CopyFile(const std::string& from,
+                     const std::string& to,
+                     std::string* error)
+{
+    const int in = open(from.c_str(), O_RDONLY);
+    if (in < 0) {
+        *error = ErrorString("could not open", from);
+        return false;
+    }
+    const int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0) {
+        *error = ErrorString("could not create", to);
+        close(in);
+        return false;
+    }
+
+    bool success = true;
+    std::vector<char> buffer(CopyBufferSize);
+    while (success) {
+        const ssize_t numRead = read(in, buffer.data(), buffer.size());
+        if (numRead == 0)
+            break;
+        if (numRead < 0) {
+            if (errno == EINTR)
+                continue;
+            *error = ErrorString("could not read", from);
+            success = false;
+            break;
+        }
+
+        ssize_t numWritten = 0;
+        while (numWritten < numRead) {
+            const ssize_t n = write(out, buffer.data() + numWritten, numRead - numWritten);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                *error = ErrorString("could not write", to);
+                success = false;
+                break;
+            }
+            numWritten += n;
+        }
+    }
+
+    // make sure the data is on disk before the rename makes it visible
+    if (success && fsync(out) != 0) {
+        *error = ErrorString("could not sync", to);
+        success = false;
+    }
+    close(in);
+    if (close(out) != 0 && success) {
+        *error = ErrorString("could not close", to);
+        success = false;
+    }
+    return success;
+}
+
+} // namespace internal
+
+OutputPublisher::OutputPublisher(const std::string& tmpDir)
+    : isValid_(true)
+    , isBusy_(false)
+    , isDone_(false)
+{
+    if (tmpDir.empty())
+        return;
+
+    // private per-run directory, so concurrent jobs can share tmpDir
+    std::string pattern = tmpDir + "/bax2bam.XXXXXX";
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back('\0');
+    if (mkdtemp(buffer.data()) == nullptr) {
+        isValid_ = false;
+        errors_.push_back(internal::ErrorString("could not create staging directory in", tmpDir));
+        return;
+    }
+    stagingDir_ = buffer.data();
+    thread_ = std::thread(&OutputPublisher::Run, this);
+}
+
+OutputPublisher::~OutputPublisher(void)
+{
+    if (thread_.joinable()) {
+        Wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            isDone_ = true;
+        }
+        condition_.notify_one();
+        thread_.join();
+    }
+
+    // leaves anything unpublished (e.g. after an error) in place
+    if (!stagingDir_.empty())
+        rmdir(stagingDir_.c_str());
+}
+
+bool OutputPublisher::IsStaging(void) const
+{ return !stagingDir_.empty(); }
+
+bool OutputPublisher::IsValid(void) const
+{ return isValid_; }
+
+const std::string& OutputPublisher::StagingDir(void) const
+{ return stagingDir_; }
+
+std::string OutputPublisher::StagedPath(const std::string& finalPath) const
+{
+    if (!IsStaging())
+        return finalPath;
+    return stagingDir_ + "/" + internal::Basename(finalPath);
+}
+
+void OutputPublisher::Publish(const std::string& finalPath)
+{
+    if (!IsStaging())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(finalPath);
+    }
+    condition_.notify_one();
+}
+
+bool OutputPublisher::Wait(void)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idleCondition_.wait(lock, [this]() { return queue_.empty() && !isBusy_; });
+    return errors_.empty();
+}
+
+std::vector<std::string> OutputPublisher::Errors(void) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return errors_;
+}
+
+bool OutputPublisher::Move(const std::string& from,
+                           const std::string& to,
+                           std::string* error)
+{
+    if (rename(from.c_str(), to.c_str()) == 0)
+        return true;
+    if (errno != EXDEV) {
+        *error = internal::ErrorString("could not move " + from + " to", to);
+        return false;
+    }
+
+    // different filesystem: copy alongside the destination, then rename into place
+    const std::string partial = to + ".tmp";
+    if (!internal::CopyFile(from, partial, error)) {
+        unlink(partial.c_str());
+        return false;
+    }
+    if (rename(partial.c_str(), to.c_str()) != 0) {
+        *error = internal::ErrorString("could not rename " + partial + " to", to);
+        unlink(partial.c_str());
+        return false;
+    }
+    unlink(from.c_str());
+    return true;
+}
+
+void OutputPublisher::Run(void)
+{
+    while (true) {
+
+        std::string finalPath;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this]() { return isDone_ || !queue_.empty(); });
+            if (queue_.empty())
+                return;
+            finalPath = queue_.front();
+            queue_.pop_front();
+            isBusy_ = true;
+        }
+
+        std::string error;
+        const bool success = Move(StagedPath(finalPath), finalPath, &error);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!success)
+                errors_.push_back(error);
+            isBusy_ = false;
+        }
+        idleCondition_.notify_all();
+    }
+}
@@ -0,0 +1,72 @@
+// Author: Derek Barnett
+
+#ifndef OUTPUTPUBLISHER_H
+#define OUTPUTPUBLISHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//
+// OutputPublisher stages output files in a scratch directory (--tmpdir) and
+// moves each one to its final location once it is complete.
+//
+// Files are written to StagedPath(finalPath). Publish() queues the move, which
+// runs on a background thread so it can overlap with further conversion work.
+// A move within one filesystem is a rename; across filesystems the file is
+// copied next to its destination first & then renamed into place, so a
+// final path never refers to a partial file.
+//
+// One publisher is shared by every output of a run (all modes & the dataset
+// XML), so they land in a single staging directory & one mode's outputs move
+// while the others are still being closed & indexed.
+//
+// Without a staging directory, StagedPath() is the final path & Publish() is
+// a no-op.
+//
+class OutputPublisher
+{
+public:
+    explicit OutputPublisher(const std::string& tmpDir = std::string());
+    ~OutputPublisher(void);
+
+public:
+    bool IsStaging(void) const;
+    bool IsValid(void) const;
+    const std::string& StagingDir(void) const;
+
+    std::string StagedPath(const std::string& finalPath) const;
+
+    // queues the move of StagedPath(finalPath) -> finalPath
+    void Publish(const std::string& finalPath);
+
+    // blocks until all queued moves have finished, returns false if any failed
+    bool Wait(void);
+    std::vector<std::string> Errors(void) const;
+
+public:
+    static bool Move(const std::string& from,
+                     const std::string& to,
+                     std::string* error);
+
+private:
+    void Run(void);
+
+private:
+    std::string stagingDir_; // per-run directory created under tmpDir
+    bool isValid_;
+
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::condition_variable idleCondition_;
+    std::deque<std::string> queue_;
+    bool isBusy_;
+    bool isDone_;
+    std::vector<std::string> errors_;
+};
+
+#endif // OUTPUTPUBLISHER_H
@@ -1,49 +1,91 @@
 // Author: Derek Barnett
 
 #include "PolymeraseReadConverter.h"
+
+#include <algorithm>
+
 #include <pbbam/BamRecord.h>
 #include <pbbam/BamWriter.h>
 
+#include <alignment/utils/RegionUtils.hpp>
+
 PolymeraseReadConverter::PolymeraseReadConverter(Settings& settings)
     : ConverterBase(settings)
 { }
 
 PolymeraseReadConverter::~PolymeraseReadConverter(void) { }
 
-bool PolymeraseReadConverter::ConvertFile(HDFBasReader* reader,
-                                          PacBio::BAM::BamWriter* writer)
+bool PolymeraseReadConverter::ConvertFile(HDFBasReader* reader)
 {
     assert(reader);
 
     // initialize read scores
     InitReadScores(reader);
 
+    // non-sequencing ZMWs are never written here
+    InitHoleStatus(reader);
+
     // fetch records from HDF5 file
     SMRTSequence smrtRecord;
-    while (reader->GetNext(smrtRecord)) {
-
-        // Skip empty records
-        if ((smrtRecord.length == 0) || !IsSequencingZmw(smrtRecord))
-            continue;
-
-        // attempt convert BAX to BAM
-        if (!WriteRecord(smrtRecord, 0, smrtRecord.length, ReadGroupId(), writer))
-        {
-            smrtRecord.Free();
-            return false;
-        }
+    while (GetNextZmw(reader, smrtRecord, false)) {
 
+        // this mode's record, then any companion modes' from the same read
+        // (into the current output part, outputs may roll over between ZMWs)
+        const bool success = ConvertZmw(smrtRecord, nullptr, writer_.get(), nullptr) &&
+                             ConvertCompanions(smrtRecord, nullptr);
         smrtRecord.Free();
+        if (!success)
+            return false;
     }
 
     // if we get here, all OK
     return true;
 }
 
-bool PolymeraseReadConverter::ConvertFile(HDFBasReader* reader,
-                                          PacBio::BAM::BamWriter* writer,
-                                          PacBio::BAM::BamWriter* scrapsWriter)
-{ return false; }
+bool PolymeraseReadConverter::ConvertZmw(const SMRTSequence& smrtRecord,
+                                         RegionTable* regionTable,
+                                         PacBio::BAM::BamWriter* writer,
+                                         PacBio::BAM::BamWriter* scrapsWriter)
+{
+    // Skip empty records
+    if ((smrtRecord.length == 0) || !IsSequencingZmw(smrtRecord))
+        return true;
+
+    // read score filter (& the HQ region's length, if known from a companion's region table)
+    int hqLength = -1;
+    int hqStart, hqEnd, score;
+    if (regionTable && settings_.minHqLength > 0 &&
+        LookupHQRegion(smrtRecord.zmwData.holeNumber, *regionTable, hqStart, hqEnd, score))
+    {
+        hqLength = std::max(hqEnd - hqStart, 0);
+    }
+    if (IsPrefiltered(smrtRecord.zmwData.holeNumber, hqLength, -1))
+        return true;
+
+    // attempt convert BAX to BAM
+    return WriteRecord(smrtRecord, 0, smrtRecord.length, ReadGroupId(), writer);
+}
+
+bool PolymeraseReadConverter::SurveyZmw(const UInt holeNumber,
+                                        const bool isSequencing,
+                                        const int numBases,
+                                        RegionTable* regionTable)
+{
+    // same filters as ConvertZmw(), HQ length only with the region table at hand
+    if (numBases <= 0 || !isSequencing)
+        return true;
+
+    int hqLength = -1;
+    int hqStart, hqEnd, score;
+    if (regionTable && settings_.minHqLength > 0 &&
+        LookupHQRegion(holeNumber, *regionTable, hqStart, hqEnd, score))
+    {
+        hqLength = std::max(hqEnd - hqStart, 0);
+    }
+    if (!IsPrefiltered(holeNumber, hqLength, -1))
+        SurveyRecord("polymerase read", numBases, false);
+    return true;
+}
 
 std::string PolymeraseReadConverter::HeaderReadType(void) const
 { return "POLYMERASE"; }
@@ -0,0 +1,171 @@
+// Author: Derek Barnett
+
+#include "RegionTableCursor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include <hdf/HDFAtom.hpp>
+
+RegionTableCursor::RegionTableCursor(const size_t windowSize,
+                                     const size_t blockSize)
+    : pulseData_(nullptr)
+    , isOwner_(false)
+    , windowBegin_(0)
+    , windowEnd_(0)
+    , windowSize_(std::max(windowSize, static_cast<size_t>(1)))
+    , windowLoaded_(false)
+    , blockSize_(std::max(blockSize, static_cast<size_t>(1)))
+    , blockRow_(0)
+    , blockNumRows_(0)
+    , nextRow_(0)
+    , numRows_(0)
+    , lastHoleNumber_(0)
+    , isOpen_(false)
+{ }
+
+RegionTableCursor::~RegionTableCursor(void)
+{ Close(); }
+
+bool RegionTableCursor::Initialize(const std::string& baxFilename)
+{
+    Close();
+
+    try {
+        file_.Open(baxFilename, H5F_ACC_RDONLY, H5::FileAccPropList::DEFAULT);
+    } catch (H5::Exception&) {
+        return false;
+    }
+    isOpen_ = true;
+    isOwner_ = true;
+
+    if (pulseDataGroup_.Initialize(file_.rootGroup, "PulseData") == 0)
+        return false;
+    pulseData_ = &pulseDataGroup_;
+    return InitializeRegions();
+}
+
+bool RegionTableCursor::Initialize(HDFGroup& pulseDataGroup)
+{
+    Close();
+
+    isOpen_ = true;
+    isOwner_ = false;
+    pulseData_ = &pulseDataGroup;
+    return InitializeRegions();
+}
+
+bool RegionTableCursor::InitializeRegions(void)
+{
+    assert(pulseData_);
+    if (!pulseData_->ContainsObject("Regions") ||
+        regions_.Initialize(*pulseData_, "Regions") == 0)
+    {
+        return false;
+    }
+
+    // region type names, used to map each row's type index
+    HDFAtom<std::vector<std::string> > regionTypesAtom;
+    if (regionTypesAtom.Initialize(regions_.dataset, "RegionTypes") == 0)
+        return false;
+    regionTypesAtom.Read(regionTypes_);
+
+    numRows_ = regions_.GetNRows();
+    nextRow_ = 0;
+    blockRow_ = 0;
+    blockNumRows_ = 0;
+    lastHoleNumber_ = 0;
+    windowLoaded_ = false;
+    return true;
+}
+
+void RegionTableCursor::Close(void)
+{
+    if (!isOpen_)
+        return;
+
+    regions_.Close();
+    if (isOwner_) {
+        pulseDataGroup_.Close();
+        file_.Close();
+    }
+    pulseData_ = nullptr;
+    isOwner_ = false;
+
+    window_.Reset();
+    block_.clear();
+    regionTypes_.clear();
+    isOpen_ = false;
+}
+
+RegionTable& RegionTableCursor::Seek(const UInt holeNumber)
+{
+    if (!windowLoaded_ || holeNumber < windowBegin_ || holeNumber >= windowEnd_)
+        LoadWindow(holeNumber);
+    return window_;
+}
+
+void RegionTableCursor::LoadWindow(const UInt holeNumber)
+{
+    constexpr int HoleNumberCol = RegionAnnotation::HOLENUMBERCOL;
+    constexpr int NumCols = RegionAnnotation::NCOLS;
+
+    if (windowLoaded_ && holeNumber < windowBegin_)
+        throw std::runtime_error("region table cursor cannot seek backwards to hole number: " +
+                                 std::to_string(holeNumber));
+
+    windowBegin_ = holeNumber;
+    windowEnd_   = holeNumber + static_cast<UInt>(windowSize_);
+    windowLoaded_ = true;
+
+    std::vector<RegionAnnotation> annotations;
+    while (blockRow_ < blockNumRows_ || ReadBlock()) {
+
+        const int* row = &block_[blockRow_ * NumCols];
+        const UInt rowHoleNumber = static_cast<UInt>(row[HoleNumberCol]);
+
+        // rows for ZMWs already passed are simply dropped
+        if (rowHoleNumber < windowBegin_) {
+            ++blockRow_;
+            continue;
+        }
+
+        // leave rows beyond this window for the next one
+        if (rowHoleNumber >= windowEnd_)
+            break;
+
+        RegionAnnotation annotation;
+        std::copy(row, row + NumCols, annotation.row);
+        annotations.push_back(annotation);
+        ++blockRow_;
+    }
+
+    window_.Reset();
+    window_.ConstructTable(annotations, regionTypes_);
+}
+
+bool RegionTableCursor::ReadBlock(void)
+{
+    constexpr int HoleNumberCol = RegionAnnotation::HOLENUMBERCOL;
+    constexpr int NumCols = RegionAnnotation::NCOLS;
+
+    if (nextRow_ >= numRows_)
+        return false;
+
+    const DSLength endRow = std::min(nextRow_ + static_cast<DSLength>(blockSize_), numRows_);
+    blockNumRows_ = endRow - nextRow_;
+    block_.resize(blockNumRows_ * NumCols);
+    regions_.Read(nextRow_, endRow, block_.data());
+    nextRow_ = endRow;
+    blockRow_ = 0;
+
+    // the cursor relies on rows arriving in hole-number order
+    for (size_t i = 0; i < blockNumRows_; ++i) {
+        const UInt rowHoleNumber = static_cast<UInt>(block_[i * NumCols + HoleNumberCol]);
+        if (rowHoleNumber < lastHoleNumber_)
+            throw std::runtime_error("region table is not sorted by hole number");
+        lastHoleNumber_ = rowHoleNumber;
+    }
+    return true;
+}
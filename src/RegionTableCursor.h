@@ -0,0 +1,83 @@
+// Author: Derek Barnett
+
+#ifndef REGIONTABLECURSOR_H
+#define REGIONTABLECURSOR_H
+
+#include <string>
+#include <vector>
+
+#include <hdf/HDF2DArray.hpp>
+#include <hdf/HDFFile.hpp>
+#include <hdf/HDFGroup.hpp>
+#include <pbdata/reads/RegionTable.hpp>
+
+//
+// RegionTableCursor provides forward-only access to a bax.h5 region table.
+//
+// Rather than loading (and sorting) the entire table up front, only the rows
+// for a window of hole numbers starting at the requested ZMW are kept in
+// memory. Rows are read from disk in blocks as the cursor advances & rows for
+// ZMWs that have been passed are discarded.
+//
+// Region rows must be stored in hole-number order (as written by primary
+// analysis); Seek() throws std::runtime_error otherwise.
+//
+// The cursor can either open the bax.h5 itself or attach to the PulseData
+// group of a reader that already has the file open (avoiding a second open).
+// An attached cursor must be closed before the reader's file. The converters
+// always attach; together with the attribute-only header scan at startup,
+// that opens each bax file's data once per run. Opening by filename is left
+// for callers without a reader (e.g. tests).
+//
+class RegionTableCursor
+{
+public:
+    static const size_t DefaultWindowSize = 4096; // hole numbers
+    static const size_t DefaultBlockSize  = 16384; // rows per disk read
+
+public:
+    explicit RegionTableCursor(const size_t windowSize = DefaultWindowSize,
+                               const size_t blockSize = DefaultBlockSize);
+    ~RegionTableCursor(void);
+
+public:
+    bool Initialize(const std::string& baxFilename);
+    bool Initialize(HDFGroup& pulseDataGroup);
+    void Close(void);
+
+    // Returns a table containing (at least) all regions for holeNumber.
+    // Hole numbers must be requested in non-decreasing order.
+    RegionTable& Seek(const UInt holeNumber);
+
+private:
+    bool InitializeRegions(void);
+    void LoadWindow(const UInt holeNumber);
+    bool ReadBlock(void);
+
+private:
+    HDFFile file_;
+    HDFGroup pulseDataGroup_;       // if opened here
+    HDFGroup* pulseData_;           // group in use (own or attached)
+    bool isOwner_;
+    HDF2DArray<int> regions_;
+    std::vector<std::string> regionTypes_;
+
+    // current window [windowBegin_, windowEnd_) of hole numbers
+    RegionTable window_;
+    UInt windowBegin_;
+    UInt windowEnd_;
+    size_t windowSize_;
+    bool windowLoaded_;
+
+    // raw rows read from disk, not yet consumed
+    std::vector<int> block_;
+    size_t blockSize_;
+    size_t blockRow_;
+    size_t blockNumRows_;
+    DSLength nextRow_;
+    DSLength numRows_;
+    UInt lastHoleNumber_;
+    bool isOpen_;
+};
+
+#endif // REGIONTABLECURSOR_H
@@ -0,0 +1,129 @@
+// Author: Derek Barnett
+
+#include "SequenceWriter.h"
+
+#include <cerrno>
+#include <cstring>
+
+namespace internal {
+
+// plain text output is collected in this much memory between writes
+static const size_t StdioBufferSize = 4 * 1024 * 1024;
+
+} // namespace internal
+
+SequenceWriter::SequenceWriter(const std::string& filename,
+                               const Format format,
+                               const bool isGzip,
+                               const int compressionLevel,
+                               const size_t numThreads)
+    : filename_(filename)
+    , format_(format)
+    , isGzip_(isGzip)
+    , compressionLevel_(compressionLevel)
+    , numThreads_(numThreads)
+    , bgzf_(nullptr)
+    , file_(nullptr)
+    , numRecords_(0)
+{ }
+
+SequenceWriter::~SequenceWriter(void)
+{ Close(); }
+
+bool SequenceWriter::Open(void)
+{
+    if (isGzip_) {
+        std::string mode = "w";
+        if (compressionLevel_ >= 0 && compressionLevel_ <= 9)
+            mode += static_cast<char>('0' + compressionLevel_);
+        bgzf_ = bgzf_open(filename_.c_str(), mode.c_str());
+        if (bgzf_ == nullptr) {
+            error_ = "could not open " + filename_;
+            return false;
+        }
+        if (numThreads_ > 1)
+            bgzf_mt(bgzf_, static_cast<int>(numThreads_), 256);
+    }
+    else {
+        file_ = (filename_ == "-") ? stdout : std::fopen(filename_.c_str(), "w");
+        if (file_ == nullptr) {
+            error_ = "could not open " + filename_ + ": " + std::strerror(errno);
+            return false;
+        }
+        std::setvbuf(file_, nullptr, _IOFBF, internal::StdioBufferSize);
+    }
+    return true;
+}
+
+bool SequenceWriter::Close(void)
+{
+    bool isOk = error_.empty();
+    if (bgzf_) {
+        if (bgzf_close(bgzf_) != 0 && isOk) {
+            error_ = "could not finish writing " + filename_;
+            isOk = false;
+        }
+        bgzf_ = nullptr;
+    }
+    if (file_) {
+        const bool closed = (file_ == stdout) ? (std::fflush(file_) == 0)
+                                              : (std::fclose(file_) == 0);
+        if (!closed && isOk) {
+            error_ = "could not finish writing " + filename_ + ": " + std::strerror(errno);
+            isOk = false;
+        }
+        file_ = nullptr;
+    }
+    return isOk;
+}
+
+bool SequenceWriter::Write(const std::string& name,
+                           const char* sequence,
+                           const size_t length,
+                           const std::string& qualities)
+{
+    // whole record in one write
+    buffer_.clear();
+    buffer_.push_back(format_ == Fastq ? '@' : '>');
+    buffer_.append(name);
+    buffer_.push_back('\n');
+    buffer_.append(sequence, length);
+    buffer_.push_back('\n');
+    if (format_ == Fastq) {
+        buffer_.append("+\n");
+        buffer_.append(qualities);
+        buffer_.push_back('\n');
+    }
+
+    if (!WriteBuffer())
+        return false;
+    ++numRecords_;
+    return true;
+}
+
+bool SequenceWriter::WriteBuffer(void)
+{
+    if (bgzf_) {
+        if (bgzf_write(bgzf_, buffer_.data(), buffer_.size()) < 0) {
+            error_ = "could not write to " + filename_;
+            return false;
+        }
+    }
+    else if (file_) {
+        if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+            error_ = "could not write to " + filename_ + ": " + std::strerror(errno);
+            return false;
+        }
+    }
+    else {
+        error_ = filename_ + " is not open";
+        return false;
+    }
+    return true;
+}
+
+const std::string& SequenceWriter::Error(void) const
+{ return error_; }
+
+uint64_t SequenceWriter::NumRecords(void) const
+{ return numRecords_; }
@@ -0,0 +1,66 @@
+// Author: Derek Barnett
+
+#ifndef SEQUENCEWRITER_H
+#define SEQUENCEWRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include <htslib/bgzf.h>
+
+//
+// SequenceWriter writes FASTA or FASTQ text, plain or gzip-compressed.
+//
+// Compressed output goes through BGZF (valid multi-member gzip, readable by
+// gunzip & zcat) so it can use htslib's compression threads. Plain output
+// goes through a large stdio buffer. A filename of "-" writes to stdout.
+//
+class SequenceWriter
+{
+public:
+    enum Format { Fasta
+                , Fastq
+                };
+
+public:
+    SequenceWriter(const std::string& filename,
+                   const Format format,
+                   const bool isGzip,
+                   const int compressionLevel = -1,
+                   const size_t numThreads = 1);
+    ~SequenceWriter(void);
+
+public:
+    bool Open(void);
+    bool Close(void);
+
+    // qualities are FASTQ-encoded, ignored for FASTA
+    bool Write(const std::string& name,
+               const char* sequence,
+               const size_t length,
+               const std::string& qualities);
+
+    const std::string& Error(void) const;
+    uint64_t NumRecords(void) const;
+
+private:
+    bool WriteBuffer(void);
+
+private:
+    std::string filename_;
+    Format format_;
+    bool isGzip_;
+    int compressionLevel_;
+    size_t numThreads_;
+
+    BGZF* bgzf_;
+    FILE* file_;
+    std::string buffer_; // re-used for each record's text
+
+    std::string error_;
+    uint64_t numRecords_;
+};
+
+#endif // SEQUENCEWRITER_H
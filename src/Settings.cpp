@@ -1,8 +1,14 @@
 // Author: Derek Barnett
 
 #include "Settings.h"
+#include "BufferedFileSink.h"
+#include "HdfCacheConfig.h"
+#include "MemoryBudget.h"
 #include "OptionParser.h"
 
+#include <cerrno>
+#include <cstdlib>
+#include <limits>
 #include <sstream>
 
 #include <boost/algorithm/string.hpp>
@@ -11,6 +17,8 @@
 
 #include <hdf/HDFNewBasReader.hpp>
 
+#include <sys/stat.h>
+
 namespace internal {
 
 static
@@ -75,6 +83,57 @@ void H5FilenamesFromBasH5(const std::string& basFileName,
         output->push_back(basFileName);
 }
 
+static
+bool ParseCompressionLevel(const std::string& s, int* level)
+{
+    if (s.size() != 1 || s[0] < '0' || s[0] > '9')
+        return false;
+    *level = s[0] - '0';
+    return true;
+}
+
+static
+bool ParseCount(const std::string& s, size_t* count)
+{
+    if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos)
+        return false;
+    errno = 0;
+    const unsigned long long value = std::strtoull(s.c_str(), nullptr, 10);
+    if (errno == ERANGE || value > std::numeric_limits<size_t>::max())
+        return false;
+    *count = static_cast<size_t>(value);
+    return true;
+}
+
+// "start:end"
+static
+bool ParseZmwRange(const std::string& s, size_t* begin, size_t* end)
+{
+    const size_t colon = s.find(':');
+    return colon != std::string::npos &&
+           ParseCount(s.substr(0, colon), begin) &&
+           ParseCount(s.substr(colon + 1), end) &&
+           *begin < *end;
+}
+
+// "i/N"
+static
+bool ParseChunk(const std::string& s, size_t* index, size_t* count)
+{
+    const size_t slash = s.find('/');
+    return slash != std::string::npos &&
+           ParseCount(s.substr(0, slash), index) &&
+           ParseCount(s.substr(slash + 1), count) &&
+           *index >= 1 && *index <= *count;
+}
+
+static
+bool IsFifo(const std::string& fileName)
+{
+    struct stat s;
+    return stat(fileName.c_str(), &s) == 0 && S_ISFIFO(s.st_mode);
+}
+
 } // namespace internal
 
 // option names
@@ -92,10 +151,61 @@ const char* Settings::Option::internalMode_   = "internalMode";
 const char* Settings::Option::outputXml_      = "outputXml";
 const char* Settings::Option::sequelPlatform_ = "sequelPlatform";
 const char* Settings::Option::allowUnsupportedChem_  = "allowUnsupportedChem";
+const char* Settings::Option::maxMemory_      = "maxMemory";
+const char* Settings::Option::stats_          = "stats";
+const char* Settings::Option::chunkCache_     = "chunkCache";
+const char* Settings::Option::chunkCacheSlots_ = "chunkCacheSlots";
+const char* Settings::Option::chunkCacheW0_   = "chunkCacheW0";
+const char* Settings::Option::metadataCache_  = "metadataCache";
+const char* Settings::Option::prefetch_       = "prefetch";
+const char* Settings::Option::prefetchMode_   = "prefetchMode";
+const char* Settings::Option::scrapsOutput_   = "scrapsOutput";
+const char* Settings::Option::tmpDir_         = "tmpDir";
+const char* Settings::Option::writeBuffer_    = "writeBuffer";
+const char* Settings::Option::directIO_       = "directIO";
+const char* Settings::Option::compressionLevel_ = "compressionLevel";
+const char* Settings::Option::scrapsCompressionLevel_ = "scrapsCompressionLevel";
+const char* Settings::Option::zmwRange_       = "zmwRange";
+const char* Settings::Option::chunk_          = "chunk";
+const char* Settings::Option::minReadScore_   = "minReadScore";
+const char* Settings::Option::minSubreadLength_ = "minSubreadLength";
+const char* Settings::Option::minHqLength_    = "minHqLength";
+const char* Settings::Option::scrapFiltered_  = "scrapFiltered";
+const char* Settings::Option::subsampleFraction_ = "subsampleFraction";
+const char* Settings::Option::subsampleSeed_  = "subsampleSeed";
+const char* Settings::Option::fastaOutput_    = "fastaOutput";
+const char* Settings::Option::fastqOutput_    = "fastqOutput";
+const char* Settings::Option::gzipOutput_     = "gzipOutput";
+const char* Settings::Option::statsOnly_      = "statsOnly";
+const char* Settings::Option::checkpoint_     = "checkpoint";
+const char* Settings::Option::resume_         = "resume";
+const char* Settings::Option::leanScraps_     = "leanScraps";
+const char* Settings::Option::splitByZmws_    = "splitByZmws";
+const char* Settings::Option::splitByBytes_   = "splitByBytes";
 
 Settings::Settings(void)
     : mode(Settings::SubreadMode)
     , isInternal(false)
+    , isLeanScraps(false)
+    , isStreamingOutput(false)
+    , writeBufferBytes(0)
+    , isDirectIO(false)
+    , outputFormat(Settings::BamFormat)
+    , isGzipOutput(false)
+    , checkpointZmws(0)
+    , isResuming(false)
+    , splitZmws(0)
+    , splitBytes(0)
+    , zmwRangeBegin(0)
+    , zmwRangeEnd(0)
+    , chunkIndex(0)
+    , chunkCount(0)
+    , subsampleFraction(1.0)
+    , subsampleSeed(0)
+    , minReadScore(0.0f)
+    , minSubreadLength(0)
+    , minHqLength(0)
+    , isScrappingFiltered(false)
     , isSequelInput(false)
     , isIgnoringChemistryCheck(false)
     , usingDeletionQV(true)
@@ -107,6 +217,18 @@ Settings::Settings(void)
     , usingSubstitutionQV(true)
     , usingSubstitutionTag(false)
     , losslessFrames(false)
+    , compressionLevel(-1)
+    , scrapsCompressionLevel(-1)
+    , maxMemory(MemoryBudget::Unlimited)
+    , chunkCacheBytes(0)
+    , chunkCacheSlots(0)
+    , chunkCacheW0(-1.0)
+    , isAutoChunkCache(false)
+    , metadataCacheBytes(0)
+    , prefetchZmws(0)
+    , isPrefetchReading(false)
+    , isReportingStats(false)
+    , isStatsOnly(false)
 { }
 
 Settings Settings::FromCommandLine(optparse::OptionParser& parser,
@@ -131,6 +253,73 @@ Settings Settings::FromCommandLine(optparse::OptionParser& parser,
     settings.outputBamPrefix = options[Settings::Option::output_];
     settings.outputXmlFilename = options[Settings::Option::outputXml_];
 
+    // streaming output: main BAM to stdout ('-') or a named pipe
+    if (settings.outputBamPrefix == "-" || internal::IsFifo(settings.outputBamPrefix)) {
+        settings.isStreamingOutput = true;
+        if (!settings.outputXmlFilename.empty())
+            settings.errors.push_back("--output-xml is not supported when streaming BAM output");
+    }
+    // scratch dir
+    if (options.is_set(Settings::Option::tmpDir_)) {
+        settings.tmpDir = options[Settings::Option::tmpDir_];
+        struct stat s;
+        if (stat(settings.tmpDir.c_str(), &s) != 0 || !S_ISDIR(s.st_mode))
+            settings.errors.push_back(std::string("--tmpdir is not a directory: ") + settings.tmpDir);
+    }
+    // output buffering
+    if (options.is_set(Settings::Option::writeBuffer_)) {
+        const std::string writeBuffer = options[Settings::Option::writeBuffer_];
+        if (!MemoryBudget::ParseSize(writeBuffer, &settings.writeBufferBytes))
+            settings.errors.push_back(std::string("invalid write buffer size: ") + writeBuffer);
+    }
+    settings.isDirectIO = options.is_set(Settings::Option::directIO_) ? options.get(Settings::Option::directIO_)
+                                                                      : false;
+    if (settings.isDirectIO && settings.writeBufferBytes == 0)
+        settings.writeBufferBytes = BufferedFileSink::DefaultBufferSize;
+
+    if (options.is_set(Settings::Option::scrapsOutput_)) {
+        settings.scrapsOutputFilename = options[Settings::Option::scrapsOutput_];
+        if (!settings.isStreamingOutput)
+            settings.errors.push_back("--scraps-output requires streaming output (-o - or a named pipe)");
+    }
+
+    // ZMW subset
+    if (options.is_set(Settings::Option::zmwRange_)) {
+        const std::string zmwRange = options[Settings::Option::zmwRange_];
+        if (internal::ParseZmwRange(zmwRange, &settings.zmwRangeBegin, &settings.zmwRangeEnd)) {
+            settings.shardLabel = ".zmws" + std::to_string(settings.zmwRangeBegin) +
+                                  "-" + std::to_string(settings.zmwRangeEnd);
+        } else
+            settings.errors.push_back(std::string("invalid ZMW range (must be start:end, start < end): ") + zmwRange);
+    }
+    if (options.is_set(Settings::Option::chunk_)) {
+        const std::string chunk = options[Settings::Option::chunk_];
+        if (settings.zmwRangeEnd != 0)
+            settings.errors.push_back("--zmw-range and --chunk are mutually exclusive");
+        else if (internal::ParseChunk(chunk, &settings.chunkIndex, &settings.chunkCount)) {
+            settings.shardLabel = ".chunk" + std::to_string(settings.chunkIndex) +
+                                  "of" + std::to_string(settings.chunkCount);
+        } else
+            settings.errors.push_back(std::string("invalid chunk (must be i/N, 1 <= i <= N): ") + chunk);
+    }
+
+    // ZMW sample
+    if (options.is_set(Settings::Option::subsampleFraction_)) {
+        const std::string fraction = options[Settings::Option::subsampleFraction_];
+        char* end = nullptr;
+        settings.subsampleFraction = std::strtod(fraction.c_str(), &end);
+        if (fraction.empty() || *end != '\0' || !(settings.subsampleFraction > 0.0) || settings.subsampleFraction > 1.0)
+            settings.errors.push_back(std::string("invalid subsample fraction (must be in (0,1]): ") + fraction);
+    }
+    if (options.is_set(Settings::Option::subsampleSeed_)) {
+        const std::string seed = options[Settings::Option::subsampleSeed_];
+        size_t value = 0;
+        if (internal::ParseCount(seed, &value))
+            settings.subsampleSeed = value;
+        else
+            settings.errors.push_back(std::string("invalid subsample seed: ") + seed);
+    }
+
     // input files from dataset XML ?
     if ( options.is_set(Settings::Option::datasetXml_) ) {
         settings.datasetXmlFilename = options[Settings::Option::datasetXml_];
@@ -174,27 +363,60 @@ Settings Settings::FromCommandLine(optparse::OptionParser& parser,
             options.is_set(Settings::Option::ccsMode_) ? options.get(Settings::Option::ccsMode_)
                                                        : false;
 
-    int modeCount = 0;
-    if (isSubreadMode)    ++modeCount;
-    if (isHQRegionMode)   ++modeCount;
-    if (isPolymeraseMode) ++modeCount;
-    if (isCCS)            ++modeCount;
-
-    if (modeCount == 0)
+    // subread, HQ region & polymerase reads can be written from the same pass,
+    // the first selected (in that order) drives the conversion
+    std::vector<Settings::Mode> modes;
+    if (isSubreadMode)    modes.push_back(Settings::SubreadMode);
+    if (isHQRegionMode)   modes.push_back(Settings::HQRegionMode);
+    if (isPolymeraseMode) modes.push_back(Settings::PolymeraseMode);
+
+    if (isCCS) {
+        settings.mode = Settings::CCSMode;
+        if (!modes.empty())
+            settings.errors.push_back("--ccs cannot be combined with other modes");
+    }
+    else if (modes.empty())
         settings.mode = Settings::SubreadMode;
-    else if (modeCount == 1) {
-        if (isSubreadMode)    settings.mode = Settings::SubreadMode;
-        if (isHQRegionMode)   settings.mode = Settings::HQRegionMode;
-        if (isPolymeraseMode) settings.mode = Settings::PolymeraseMode;
-        if (isCCS)            settings.mode = Settings::CCSMode;
+    else {
+        settings.mode = modes.front();
+        settings.additionalModes.assign(modes.begin() + 1, modes.end());
+        if (!settings.additionalModes.empty() && settings.isStreamingOutput)
+            settings.errors.push_back("multiple modes are not supported when streaming BAM output");
     }
-    else
-        settings.errors.push_back("multiple modes selected");
+
+    // prefilters
+    if (options.is_set(Settings::Option::minReadScore_)) {
+        const std::string score = options[Settings::Option::minReadScore_];
+        char* end = nullptr;
+        settings.minReadScore = std::strtof(score.c_str(), &end);
+        if (score.empty() || *end != '\0' || settings.minReadScore < 0.0f || settings.minReadScore > 1.0f)
+            settings.errors.push_back(std::string("invalid minimum read score (must be in [0,1]): ") + score);
+    }
+    if (options.is_set(Settings::Option::minSubreadLength_)) {
+        const std::string length = options[Settings::Option::minSubreadLength_];
+        if (!internal::ParseCount(length, &settings.minSubreadLength))
+            settings.errors.push_back(std::string("invalid minimum subread length: ") + length);
+    }
+    if (options.is_set(Settings::Option::minHqLength_)) {
+        const std::string length = options[Settings::Option::minHqLength_];
+        if (!internal::ParseCount(length, &settings.minHqLength))
+            settings.errors.push_back(std::string("invalid minimum HQ region length: ") + length);
+    }
+    settings.isScrappingFiltered = options.is_set(Settings::Option::scrapFiltered_) ? options.get(Settings::Option::scrapFiltered_)
+                                                                                    : false;
+    if (isCCS && (settings.minReadScore > 0.0f || settings.minSubreadLength > 0 || settings.minHqLength > 0))
+        settings.errors.push_back("read score & length filters are not supported in CCS mode");
 
     // internal file mode
     settings.isInternal = options.is_set(Settings::Option::internalMode_) ? options.get(Settings::Option::internalMode_)
                                                                           : false;
 
+    // scraps without pulse features
+    settings.isLeanScraps = options.is_set(Settings::Option::leanScraps_) ? options.get(Settings::Option::leanScraps_)
+                                                                          : false;
+    if (settings.isLeanScraps && isCCS)
+        settings.errors.push_back("--lean-scraps is not supported in CCS mode");
+
     // strict/relaxed chemistry check
     settings.isIgnoringChemistryCheck = options.is_set(Settings::Option::allowUnsupportedChem_) ? options.get(Settings::Option::allowUnsupportedChem_)
                                                                                                 : false;
@@ -207,6 +429,83 @@ Settings Settings::FromCommandLine(optparse::OptionParser& parser,
     settings.losslessFrames = options.is_set(Settings::Option::losslessFrames_) ? options.get(Settings::Option::losslessFrames_)
                                                                                 : false;
 
+    // run statistics
+    settings.isReportingStats = options.is_set(Settings::Option::stats_) ? options.get(Settings::Option::stats_)
+                                                                         : false;
+    settings.isStatsOnly = options.is_set(Settings::Option::statsOnly_) ? options.get(Settings::Option::statsOnly_)
+                                                                        : false;
+    if (settings.isStatsOnly) {
+        settings.isReportingStats = true;
+        if (settings.mode == Settings::CCSMode)
+            settings.errors.push_back("--stats-only is not supported in CCS mode");
+    }
+
+    // compression levels, scraps follow the main BAM unless set
+    if (options.is_set(Settings::Option::compressionLevel_)) {
+        const std::string level = options[Settings::Option::compressionLevel_];
+        if (!internal::ParseCompressionLevel(level, &settings.compressionLevel))
+            settings.errors.push_back(std::string("invalid compression level (must be 0-9): ") + level);
+    }
+    settings.scrapsCompressionLevel = settings.compressionLevel;
+    if (options.is_set(Settings::Option::scrapsCompressionLevel_)) {
+        const std::string level = options[Settings::Option::scrapsCompressionLevel_];
+        if (!internal::ParseCompressionLevel(level, &settings.scrapsCompressionLevel))
+            settings.errors.push_back(std::string("invalid scraps compression level (must be 0-9): ") + level);
+    }
+
+    // memory budget
+    if (options.is_set(Settings::Option::maxMemory_)) {
+        if (!MemoryBudget::ParseSize(options[Settings::Option::maxMemory_], &settings.maxMemory) ||
+            settings.maxMemory == MemoryBudget::Unlimited)
+        {
+            settings.errors.push_back(std::string("invalid memory size: ") + options[Settings::Option::maxMemory_]);
+        }
+    }
+
+    // HDF5 chunk & metadata caches
+    if (options.is_set(Settings::Option::chunkCache_)) {
+        const std::string chunkCache = options[Settings::Option::chunkCache_];
+        if (chunkCache == "auto")
+            settings.isAutoChunkCache = true;
+        else if (!MemoryBudget::ParseSize(chunkCache, &settings.chunkCacheBytes))
+            settings.errors.push_back(std::string("invalid chunk cache size: ") + chunkCache);
+    }
+    if (options.is_set(Settings::Option::chunkCacheSlots_)) {
+        const std::string slots = options[Settings::Option::chunkCacheSlots_];
+        if (!internal::ParseCount(slots, &settings.chunkCacheSlots) || settings.chunkCacheSlots == 0)
+            settings.errors.push_back(std::string("invalid chunk cache slot count: ") + slots);
+    }
+    if (options.is_set(Settings::Option::chunkCacheW0_)) {
+        const std::string w0 = options[Settings::Option::chunkCacheW0_];
+        char* end = nullptr;
+        settings.chunkCacheW0 = std::strtod(w0.c_str(), &end);
+        if (w0.empty() || *end != '\0' || settings.chunkCacheW0 < 0.0 || settings.chunkCacheW0 > 1.0)
+            settings.errors.push_back(std::string("invalid chunk cache w0 (must be in [0,1]): ") + w0);
+    }
+    if (options.is_set(Settings::Option::metadataCache_)) {
+        const std::string metadataCache = options[Settings::Option::metadataCache_];
+        if (!MemoryBudget::ParseSize(metadataCache, &settings.metadataCacheBytes) ||
+            settings.metadataCacheBytes < HdfCacheConfig::MinMetadataCacheBytes ||
+            settings.metadataCacheBytes > HdfCacheConfig::MaxMetadataCacheBytes)
+        {
+            settings.errors.push_back(std::string("invalid metadata cache size (must be 1K to 128M): ") + metadataCache);
+        }
+    }
+
+    // input readahead
+    if (options.is_set(Settings::Option::prefetch_)) {
+        const std::string prefetch = options[Settings::Option::prefetch_];
+        if (!internal::ParseCount(prefetch, &settings.prefetchZmws) || settings.prefetchZmws == 0)
+            settings.errors.push_back(std::string("invalid prefetch ZMW count (must be > 0): ") + prefetch);
+    }
+    if (options.is_set(Settings::Option::prefetchMode_)) {
+        const std::string prefetchMode = options[Settings::Option::prefetchMode_];
+        if (prefetchMode == "read")
+            settings.isPrefetchReading = true;
+        else if (prefetchMode != "advise")
+            settings.errors.push_back(std::string("unknown prefetch mode: ") + prefetchMode);
+    }
+
     // pulse features list
     if (options.is_set(Settings::Option::pulseFeatures_)) {
 
@@ -237,6 +536,89 @@ Settings Settings::FromCommandLine(optparse::OptionParser& parser,
         }
     }
 
+    // sequence-only output
+    const bool isFasta = options.is_set(Settings::Option::fastaOutput_) ? options.get(Settings::Option::fastaOutput_)
+                                                                        : false;
+    const bool isFastq = options.is_set(Settings::Option::fastqOutput_) ? options.get(Settings::Option::fastqOutput_)
+                                                                        : false;
+    settings.isGzipOutput = options.is_set(Settings::Option::gzipOutput_) ? options.get(Settings::Option::gzipOutput_)
+                                                                          : false;
+    if (isFasta && isFastq)
+        settings.errors.push_back("--fasta and --fastq are mutually exclusive");
+    else if (isFasta)
+        settings.outputFormat = Settings::FastaFormat;
+    else if (isFastq)
+        settings.outputFormat = Settings::FastqFormat;
+
+    if (settings.outputFormat == Settings::BamFormat) {
+        if (settings.isGzipOutput)
+            settings.errors.push_back("--gzip requires --fasta or --fastq");
+    } else {
+        if (options.is_set(Settings::Option::pulseFeatures_))
+            settings.errors.push_back("--pulsefeatures is not supported with FASTA/FASTQ output");
+        if (!settings.scrapsOutputFilename.empty())
+            settings.errors.push_back("--scraps-output is not supported with FASTA/FASTQ output");
+        if (settings.isLeanScraps)
+            settings.errors.push_back("--lean-scraps is not supported with FASTA/FASTQ output");
+
+        // bases (& qualities) only
+        settings.usingDeletionQV = false;
+        settings.usingDeletionTag = false;
+        settings.usingInsertionQV = false;
+        settings.usingIPD = false;
+        settings.usingMergeQV = false;
+        settings.usingPulseWidth = false;
+        settings.usingSubstitutionQV = false;
+        settings.usingSubstitutionTag = false;
+    }
+
+    // checkpoints, BAM files only
+    if (options.is_set(Settings::Option::checkpoint_)) {
+        const std::string interval = options[Settings::Option::checkpoint_];
+        if (!internal::ParseCount(interval, &settings.checkpointZmws) || settings.checkpointZmws == 0)
+            settings.errors.push_back(std::string("invalid checkpoint interval: ") + interval);
+    }
+    settings.isResuming = options.is_set(Settings::Option::resume_) ? options.get(Settings::Option::resume_)
+                                                                    : false;
+    if (settings.isResuming && settings.checkpointZmws == 0)
+        settings.errors.push_back("--resume requires --checkpoint");
+    if (settings.checkpointZmws > 0) {
+        if (settings.isStreamingOutput)
+            settings.errors.push_back("--checkpoint is not supported when streaming BAM output");
+        if (settings.outputFormat != Settings::BamFormat)
+            settings.errors.push_back("--checkpoint is not supported with FASTA/FASTQ output");
+        if (!settings.additionalModes.empty())
+            settings.errors.push_back("--checkpoint is not supported with multiple modes");
+        if (!settings.tmpDir.empty())
+            settings.errors.push_back("--checkpoint is not supported with --tmpdir");
+        if (settings.isStatsOnly)
+            settings.errors.push_back("--checkpoint is not supported with --stats-only");
+    }
+
+    // split outputs, BAM files only
+    if (options.is_set(Settings::Option::splitByZmws_)) {
+        const std::string count = options[Settings::Option::splitByZmws_];
+        if (!internal::ParseCount(count, &settings.splitZmws) || settings.splitZmws == 0)
+            settings.errors.push_back(std::string("invalid ZMW count per part: ") + count);
+    }
+    if (options.is_set(Settings::Option::splitByBytes_)) {
+        const std::string size = options[Settings::Option::splitByBytes_];
+        if (!MemoryBudget::ParseSize(size, &settings.splitBytes) || settings.splitBytes == 0)
+            settings.errors.push_back(std::string("invalid part size: ") + size);
+    }
+    if (settings.splitZmws > 0 || settings.splitBytes > 0) {
+        if (settings.isStreamingOutput)
+            settings.errors.push_back("split output is not supported when streaming BAM output");
+        if (settings.outputFormat != Settings::BamFormat)
+            settings.errors.push_back("split output is not supported with FASTA/FASTQ output");
+        if (!settings.additionalModes.empty())
+            settings.errors.push_back("split output is not supported with multiple modes");
+        if (settings.checkpointZmws > 0)
+            settings.errors.push_back("split output is not supported with --checkpoint");
+        if (settings.isStatsOnly)
+            settings.errors.push_back("split output is not supported with --stats-only");
+    }
+
     // always disable PulseWidth tag in CCS mode
     if (isCCS)
         settings.usingPulseWidth = false;
@@ -2,6 +2,7 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -16,6 +17,11 @@ public:
               , CCSMode
               };
 
+    enum OutputFormat { BamFormat
+                      , FastaFormat
+                      , FastqFormat
+                      };
+
     struct Option {
         static const char* datasetXml_;
         static const char* hqRegionMode_;
@@ -31,6 +37,37 @@ public:
         static const char* outputXml_;
         static const char* sequelPlatform_;
         static const char* allowUnsupportedChem_;
+        static const char* maxMemory_;
+        static const char* stats_;
+        static const char* chunkCache_;
+        static const char* chunkCacheSlots_;
+        static const char* chunkCacheW0_;
+        static const char* metadataCache_;
+        static const char* prefetch_;
+        static const char* prefetchMode_;
+        static const char* scrapsOutput_;
+        static const char* tmpDir_;
+        static const char* writeBuffer_;
+        static const char* directIO_;
+        static const char* compressionLevel_;
+        static const char* scrapsCompressionLevel_;
+        static const char* zmwRange_;
+        static const char* chunk_;
+        static const char* minReadScore_;
+        static const char* minSubreadLength_;
+        static const char* minHqLength_;
+        static const char* scrapFiltered_;
+        static const char* subsampleFraction_;
+        static const char* subsampleSeed_;
+        static const char* fastaOutput_;
+        static const char* fastqOutput_;
+        static const char* gzipOutput_;
+        static const char* statsOnly_;
+        static const char* checkpoint_;
+        static const char* resume_;
+        static const char* leanScraps_;
+        static const char* splitByZmws_;
+        static const char* splitByBytes_;
     };
 
 public:
@@ -49,10 +86,44 @@ public:
     std::string outputBamFilename;
     std::string scrapsBamFilename;
     std::string outputXmlFilename;
+    std::string scrapsOutputFilename; // streaming only, scraps disabled if empty
+    bool isStreamingOutput;           // main BAM goes to stdout/pipe, no PBI or XML
+    std::string tmpDir;               // stage outputs here, then move into place
+    size_t writeBufferBytes;          // 0 = write through htslib directly
+    bool isDirectIO;
+    OutputFormat outputFormat;        // sequence-only text output has no pulse features, scraps, PBI or XML
+    bool isGzipOutput;                // FASTA/FASTQ only
+
+    // periodic resume points (0 = off), see Checkpoint
+    size_t checkpointZmws;
+    bool isResuming;
+
+    // roll over to a new .partK output (pair) at a ZMW boundary (0 = off)
+    size_t splitZmws;
+    size_t splitBytes;     // main BAM size on disk
+
+    // ZMW subset, for splitting a movie across jobs
+    size_t zmwRangeBegin;  // hole numbers [begin, end), end = 0 for all
+    size_t zmwRangeEnd;
+    size_t chunkIndex;     // 1-based chunk of chunkCount, 0 for all
+    size_t chunkCount;
+    std::string shardLabel; // added to output names, empty for all ZMWs
+
+    // seeded sample of ZMWs by hole number (1 = all)
+    double subsampleFraction;
+    uint64_t subsampleSeed;
+
+    // prefilters, checked before records are converted (0 = off)
+    float minReadScore;
+    size_t minSubreadLength;
+    size_t minHqLength;
+    bool isScrappingFiltered; // write rejected records to scraps (sc:F)
 
     // mode
     Mode mode;
+    std::vector<Mode> additionalModes; // also written from mode's pass
     bool isInternal;
+    bool isLeanScraps; // scraps carry bases & per-record tags only, no pulse features
 
     // platform
     bool isSequelInput;
@@ -73,6 +144,28 @@ public:
     // frame data encoding
     bool losslessFrames;
 
+    // BGZF compression levels, 0-9 (-1 = default)
+    int compressionLevel;
+    int scrapsCompressionLevel;
+
+    // resource limits (0 = unlimited)
+    size_t maxMemory;
+
+    // HDF5 caches (0 or negative w0 = HDF5 default)
+    size_t chunkCacheBytes;
+    size_t chunkCacheSlots;
+    double chunkCacheW0;
+    bool isAutoChunkCache;
+    size_t metadataCacheBytes;
+
+    // input readahead (ZMWs ahead of the reader, 0 = off)
+    size_t prefetchZmws;
+    bool isPrefetchReading; // explicit reads instead of posix_fadvise
+
+    // print run statistics to stderr
+    bool isReportingStats;
+    bool isStatsOnly; // count records & estimate output size from ZMW metadata, write nothing
+
     // program info
     std::string program;
     std::string args;
@@ -83,6 +176,8 @@ public:
     std::string movieName;
     std::string readGroupId;
     std::string scrapsReadGroupId;
+    std::vector<std::string> outputBamParts;  // every part written, if split
+    std::vector<std::string> scrapsBamParts;
 
     // command line parsing
     std::vector<std::string> errors;
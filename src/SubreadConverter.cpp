@@ -1,6 +1,7 @@
 // Author: Derek Barnett
 
 #include "SubreadConverter.h"
+#include "RegionTableCursor.h"
 
 #include <algorithm>
 #include <deque>
@@ -10,7 +11,6 @@
 #include <pbbam/BamWriter.h>
 
 #include <alignment/utils/RegionUtils.hpp>
-#include <hdf/HDFRegionTableReader.hpp>
 
 #define MAX( A, B )     ( (A)>(B) ? (A) : (B) )
 #define MAX3( A, B, C ) MAX( MAX( A, B ), C )
@@ -139,245 +139,298 @@ SubreadInterval ComputeSubreadIntervals(std::deque<SubreadInterval>* const inter
 
 } // anon
 
-bool SubreadConverter::ConvertFile(HDFBasReader* reader,
-                                   PacBio::BAM::BamWriter* writer)
-{
-    return ConvertFile(reader, writer, nullptr);
-}
-
-bool SubreadConverter::ConvertFile(HDFBasReader* reader,
-                                   PacBio::BAM::BamWriter* writer,
-                                   PacBio::BAM::BamWriter* scrapsWriter)
+bool SubreadConverter::ConvertFile(HDFBasReader* reader)
 {
     assert(reader);
 
     // initialize with default values (shared across all unmapped subreads)
     BamRecordImpl bamRecord;
 
-    // read region table info
-    std::unique_ptr<HDFRegionTableReader> const regionTableReader(new HDFRegionTableReader);
-    RegionTable regionTable;
+    // open region table on the reader's file, rows are streamed in as ZMWs are visited
+    RegionTableCursor regionTableCursor(budget_.RegionWindowSize(), budget_.RegionBlockSize());
     std::string fn = filenameForReader_[reader];
     assert(!fn.empty());
-    if (regionTableReader->Initialize(fn) == 0) {
+    if (!regionTableCursor.Initialize(reader->pulseDataGroup)) {
         AddErrorMessage("could not read region table on "+fn);
         return false;
     }
-    regionTable.Reset();
-    regionTableReader->ReadTable(regionTable);
-    regionTableReader->Close();
 
     // initialize read scores
     InitReadScores(reader);
 
+    // non-sequencing ZMWs are only written in internal mode (to scraps)
+    InitHoleStatus(reader);
+    const bool keepNonSequencing = settings_.isInternal && scrapsWriter_;
+
     // fetch records from HDF5 file
     SMRTSequence smrtRecord;
-    while (reader->GetNext(smrtRecord)) {
+    while (GetNextZmw(reader, smrtRecord, keepNonSequencing)) {
 
-        // compute subread & adapter intervals
-        SubreadInterval hqInterval;
-        std::deque<SubreadInterval> subreadIntervals;
-        std::deque<SubreadInterval> adapterIntervals;
+        // fetch region table rows for this ZMW
+        RegionTable* regionTable = nullptr;
         try {
-            hqInterval = ComputeSubreadIntervals(&subreadIntervals,
-                                                 &adapterIntervals,
-                                                 regionTable,
-                                                 smrtRecord.zmwData.holeNumber,
-                                                 smrtRecord.length);
+            regionTable = &regionTableCursor.Seek(smrtRecord.zmwData.holeNumber);
         } catch (std::runtime_error& e) {
             AddErrorMessage(std::string(e.what()));
             smrtRecord.Free();
             return false;
         }
 
-        // sequencing ZMW
-        if (IsSequencingZmw(smrtRecord))
+        // this mode's records, then any companion modes' from the same read
+        // (into the current output part, outputs may roll over between ZMWs)
+        const bool success = ConvertZmw(smrtRecord, regionTable, writer_.get(), scrapsWriter_.get()) &&
+                             ConvertCompanions(smrtRecord, regionTable);
+        smrtRecord.Free();
+        if (!success)
+            return false;
+    }
+
+    // if we get here, all OK
+    return true;
+}
+
+bool SubreadConverter::ConvertZmw(const SMRTSequence& smrtRecord,
+                                  RegionTable* regionTable,
+                                  PacBio::BAM::BamWriter* writer,
+                                  PacBio::BAM::BamWriter* scrapsWriter)
+{
+    if (regionTable == nullptr) {
+        AddErrorMessage("subread conversion requires the region table");
+        return false;
+    }
+
+    // compute subread & adapter intervals
+    SubreadInterval hqInterval;
+    std::deque<SubreadInterval> subreadIntervals;
+    std::deque<SubreadInterval> adapterIntervals;
+    try {
+        hqInterval = ComputeSubreadIntervals(&subreadIntervals,
+                                             &adapterIntervals,
+                                             *regionTable,
+                                             smrtRecord.zmwData.holeNumber,
+                                             smrtRecord.length);
+    } catch (std::runtime_error& e) {
+        AddErrorMessage(std::string(e.what()));
+        return false;
+    }
+
+    // subreads & adapters for the scraps BAM, if any
+    std::deque<SubreadInterval> scrapSubreads;
+    bool isWritingScraps = false;
+
+    // sequencing ZMW
+    if (IsSequencingZmw(smrtRecord))
+    {
+        const int hqLength = (hqInterval.End > hqInterval.Start) ? static_cast<int>(hqInterval.End - hqInterval.Start)
+                                                                 : 0;
+
+        // write subreads to main BAM file
+        for (const SubreadInterval& interval : subreadIntervals)
         {
-            // write subreads to main BAM file
-            for (const SubreadInterval& interval : subreadIntervals)
+            // skip invalid or 0-sized intervals
+            if (interval.End <= interval.Start)
+                continue;
+
+            // prefiltered subreads are dropped, or kept as filtered scraps
+            if (IsPrefiltered(smrtRecord.zmwData.holeNumber,
+                              hqLength,
+                              static_cast<int>(interval.End - interval.Start)))
             {
-                // skip invalid or 0-sized intervals
-                if (interval.End <= interval.Start)
-                    continue;
-
-                if (!WriteSubreadRecord(smrtRecord,
-                                        interval.Start,
-                                        interval.End,
-                                        ReadGroupId(),
-                                        static_cast<uint8_t>(interval.LocalContextFlags),
-                                        writer))
-                {
-                    smrtRecord.Free();
-                    return false;
+                if (settings_.isScrappingFiltered && scrapsWriter) {
+                    scrapSubreads.push_back(interval);
+                    ++numFilteredScrapped_;
                 }
+                continue;
             }
 
-            // if scraps BAM file present
-            if (scrapsWriter)
+            if (!WriteSubreadRecord(smrtRecord,
+                                    interval.Start,
+                                    interval.End,
+                                    ReadGroupId(),
+                                    static_cast<uint8_t>(interval.LocalContextFlags),
+                                    writer))
             {
-                // write 5-end LQ sequence
-                if (hqInterval.Start > 0)
-                {
-                    if (!WriteLowQualityRecord(smrtRecord,
-                                               0,
-                                               hqInterval.Start,
-                                               ScrapsReadGroupId(),
-                                               scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
-                }
+                return false;
+            }
+        }
 
-                // write adapters
-                for (const SubreadInterval& interval : adapterIntervals) {
-
-                    // skip invalid or 0-sized adapters
-                    if (interval.End <= interval.Start)
-                        continue;
-
-                    if (!WriteAdapterRecord(smrtRecord,
-                                            interval.Start,
-                                            interval.End,
-                                            ScrapsReadGroupId(),
-                                            scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
-                }
+        // skip invalid or 0-sized adapters
+        adapterIntervals.erase(std::remove_if(adapterIntervals.begin(),
+                                              adapterIntervals.end(),
+                                              [](const SubreadInterval& interval)
+                                              { return interval.End <= interval.Start; }),
+                               adapterIntervals.end());
 
-                // write 3'-end LQ sequence
-                if (hqInterval.End < smrtRecord.length)
-                {
-                    if (!WriteLowQualityRecord(smrtRecord,
-                                               hqInterval.End,
-                                               smrtRecord.length,
-                                               ScrapsReadGroupId(),
-                                               scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
-                }
-            }
-        } // sequencing ZMW
+        // if scraps BAM file present
+        isWritingScraps = (scrapsWriter != nullptr);
 
-        // non-sequencing ZMW
-        else
-        {
-            assert(!IsSequencingZmw(smrtRecord));
+    } // sequencing ZMW
+
+    // non-sequencing ZMW
+    else
+    {
+        assert(!IsSequencingZmw(smrtRecord));
+
+        // only write these if scraps BAM present & we are in 'internal mode'
+        scrapSubreads = std::move(subreadIntervals);
+        isWritingScraps = (settings_.isInternal && scrapsWriter);
 
-            // only write these if scraps BAM present & we are in 'internal mode'
-            if (settings_.isInternal && scrapsWriter)
+    } // non-sequencing ZMW
+
+    if (isWritingScraps)
+    {
+        // write 5-end LQ sequence to scraps BAM
+        if (hqInterval.Start > 0)
+        {
+            if (!WriteLowQualityRecord(smrtRecord,
+                                       0,
+                                       hqInterval.Start,
+                                       ScrapsReadGroupId(),
+                                       scrapsWriter))
             {
-                // write 5-end LQ sequence to scraps BAM
-                if (hqInterval.Start > 0)
-                {
-                    if (!WriteLowQualityRecord(smrtRecord,
-                                               0,
-                                               hqInterval.Start,
-                                               ScrapsReadGroupId(),
-                                               scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
-                }
+                return false;
+            }
+        }
 
-                // write subreads & adapters to scraps BAM, sorted by query start
-                while (!subreadIntervals.empty() && !adapterIntervals.empty()) {
-
-                    const SubreadInterval& subread = subreadIntervals.front();
-                    const SubreadInterval& adapter = adapterIntervals.front();
-                    assert(subread.Start != adapter.Start);
-
-                    if (subread.Start < adapter.Start)
-                    {
-                        if (!WriteFilteredRecord(smrtRecord,
-                                                 subread.Start,
-                                                 subread.End,
-                                                 ScrapsReadGroupId(),
-                                                 static_cast<uint8_t>(subread.LocalContextFlags),
-                                                 scrapsWriter))
-                        {
-                            smrtRecord.Free();
-                            return false;
-                        }
-
-                        subreadIntervals.pop_front();
-                    }
-                    else
-                    {
-                        if (!WriteAdapterRecord(smrtRecord,
-                                                adapter.Start,
-                                                adapter.End,
-                                                ScrapsReadGroupId(),
-                                                scrapsWriter))
-                        {
-                            smrtRecord.Free();
-                            return false;
-                        }
-                        adapterIntervals.pop_front();
-                    }
-                }
+        // write (filtered) subreads & adapters to scraps BAM, sorted by query start
+        while (!scrapSubreads.empty() && !adapterIntervals.empty()) {
 
-                // flush any traling subread intervals
-                while (!subreadIntervals.empty())
-                {
-                    assert(adapterIntervals.empty());
-                    const SubreadInterval& subread = subreadIntervals.front();
-                    if (!WriteFilteredRecord(smrtRecord,
-                                             subread.Start,
-                                             subread.End,
-                                             ScrapsReadGroupId(),
-                                             static_cast<uint8_t>(subread.LocalContextFlags),
-                                             scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
-
-                    subreadIntervals.pop_front();
-                }
+            const SubreadInterval& subread = scrapSubreads.front();
+            const SubreadInterval& adapter = adapterIntervals.front();
+            assert(subread.Start != adapter.Start);
 
-                // flush any remaining adapter intervals
-                while (!adapterIntervals.empty())
+            if (subread.Start < adapter.Start)
+            {
+                if (!WriteFilteredRecord(smrtRecord,
+                                         subread.Start,
+                                         subread.End,
+                                         ScrapsReadGroupId(),
+                                         static_cast<uint8_t>(subread.LocalContextFlags),
+                                         scrapsWriter))
                 {
-                    assert(subreadIntervals.empty());
-                    const SubreadInterval& adapter = adapterIntervals.front();
-                    if (!WriteAdapterRecord(smrtRecord,
-                                            adapter.Start,
-                                            adapter.End,
-                                            ScrapsReadGroupId(),
-                                            scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
-                    adapterIntervals.pop_front();
+                    return false;
                 }
 
-                // write 3'-end LQ sequence to scraps BAM
-                if (hqInterval.End < smrtRecord.length)
+                scrapSubreads.pop_front();
+            }
+            else
+            {
+                if (!WriteAdapterRecord(smrtRecord,
+                                        adapter.Start,
+                                        adapter.End,
+                                        ScrapsReadGroupId(),
+                                        scrapsWriter))
                 {
-                    if (!WriteLowQualityRecord(smrtRecord,
-                                               hqInterval.End,
-                                               smrtRecord.length,
-                                               ScrapsReadGroupId(),
-                                               scrapsWriter))
-                    {
-                        smrtRecord.Free();
-                        return false;
-                    }
+                    return false;
                 }
+                adapterIntervals.pop_front();
             }
-        } // non-sequencing ZMW
+        }
 
-        smrtRecord.Free();
+        // flush any traling subread intervals
+        while (!scrapSubreads.empty())
+        {
+            assert(adapterIntervals.empty());
+            const SubreadInterval& subread = scrapSubreads.front();
+            if (!WriteFilteredRecord(smrtRecord,
+                                     subread.Start,
+                                     subread.End,
+                                     ScrapsReadGroupId(),
+                                     static_cast<uint8_t>(subread.LocalContextFlags),
+                                     scrapsWriter))
+            {
+                return false;
+            }
+
+            scrapSubreads.pop_front();
+        }
+
+        // flush any remaining adapter intervals
+        while (!adapterIntervals.empty())
+        {
+            assert(scrapSubreads.empty());
+            const SubreadInterval& adapter = adapterIntervals.front();
+            if (!WriteAdapterRecord(smrtRecord,
+                                    adapter.Start,
+                                    adapter.End,
+                                    ScrapsReadGroupId(),
+                                    scrapsWriter))
+            {
+                return false;
+            }
+            adapterIntervals.pop_front();
+        }
+
+        // write 3'-end LQ sequence to scraps BAM
+        if (hqInterval.End < smrtRecord.length)
+        {
+            if (!WriteLowQualityRecord(smrtRecord,
+                                       hqInterval.End,
+                                       smrtRecord.length,
+                                       ScrapsReadGroupId(),
+                                       scrapsWriter))
+            {
+                return false;
+            }
+        }
     }
 
-    // if we get here, all OK
+    return true;
+}
+
+bool SubreadConverter::SurveyZmw(const UInt holeNumber,
+                                 const bool isSequencing,
+                                 const int numBases,
+                                 RegionTable* regionTable)
+{
+    if (regionTable == nullptr) {
+        AddErrorMessage("subread conversion requires the region table");
+        return false;
+    }
+
+    // same intervals as ConvertZmw(), from the region table alone
+    SubreadInterval hqInterval;
+    std::deque<SubreadInterval> subreadIntervals;
+    std::deque<SubreadInterval> adapterIntervals;
+    try {
+        hqInterval = ComputeSubreadIntervals(&subreadIntervals,
+                                             &adapterIntervals,
+                                             *regionTable,
+                                             holeNumber,
+                                             std::max(numBases, 0));
+    } catch (std::runtime_error& e) {
+        AddErrorMessage(std::string(e.what()));
+        return false;
+    }
+
+    const bool hasScraps = !settings_.scrapsBamFilename.empty();
+    const int hqLength = (hqInterval.End > hqInterval.Start) ? static_cast<int>(hqInterval.End - hqInterval.Start)
+                                                             : 0;
+    for (const SubreadInterval& interval : subreadIntervals) {
+        if (interval.End <= interval.Start)
+            continue;
+        const int length = static_cast<int>(interval.End - interval.Start);
+        if (!isSequencing) {
+            SurveyRecord("filtered subread", length, true);
+        } else if (IsPrefiltered(holeNumber, hqLength, length)) {
+            if (settings_.isScrappingFiltered && hasScraps) {
+                SurveyRecord("filtered subread", length, true);
+                ++numFilteredScrapped_;
+            }
+        } else
+            SurveyRecord("subread", length, false);
+    }
+
+    if (hasScraps) {
+        for (const SubreadInterval& interval : adapterIntervals) {
+            if (interval.End > interval.Start)
+                SurveyRecord("adapter", static_cast<int>(interval.End - interval.Start), true);
+        }
+        if (hqInterval.Start > 0)
+            SurveyRecord("LQ region", static_cast<int>(hqInterval.Start), true);
+        if (static_cast<int>(hqInterval.End) < numBases)
+            SurveyRecord("LQ region", numBases - static_cast<int>(hqInterval.End), true);
+    }
     return true;
 }
 
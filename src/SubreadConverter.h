@@ -12,11 +12,15 @@ public:
     ~SubreadConverter(void);
 
 protected:
-    bool ConvertFile(HDFBasReader* reader,
-                     PacBio::BAM::BamWriter* writer);
-    bool ConvertFile(HDFBasReader* reader,
-                     PacBio::BAM::BamWriter* writer,
-                     PacBio::BAM::BamWriter* scrapsWriter);
+    bool ConvertFile(HDFBasReader* reader);
+    bool ConvertZmw(const SMRTSequence& smrtRecord,
+                    RegionTable* regionTable,
+                    PacBio::BAM::BamWriter* writer,
+                    PacBio::BAM::BamWriter* scrapsWriter);
+    bool SurveyZmw(const UInt holeNumber,
+                   const bool isSequencing,
+                   const int numBases,
+                   RegionTable* regionTable);
     std::string HeaderReadType(void) const;
     std::string ScrapsReadType(void) const;
     std::string OutputFileSuffix(void) const;
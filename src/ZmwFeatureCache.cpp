@@ -0,0 +1,75 @@
+// Author: Derek Barnett
+
+#include "ZmwFeatureCache.h"
+
+#include <pbbam/Frames.h>
+#include <pbbam/QualityValues.h>
+
+namespace internal {
+
+static void EncodeQVs(const unsigned char* data, const DNALength length, std::string* fastq)
+{
+    PacBio::BAM::QualityValues qvs;
+    qvs.assign(data, data + length);
+    *fastq = qvs.Fastq();
+}
+
+static void EncodeFrames(const uint16_t* data,
+                         const DNALength length,
+                         const bool isLossless,
+                         std::vector<uint16_t>* raw,
+                         std::vector<uint8_t>* encoded)
+{
+    raw->assign(data, data + length);
+    if (isLossless)
+        encoded->clear();
+    else
+        *encoded = PacBio::BAM::Frames::Encode(*raw);
+}
+
+} // namespace internal
+
+ZmwFeatureCache::ZmwFeatureCache(void)
+    : isValid_(false)
+    , holeNumber_(0)
+{ }
+
+bool ZmwFeatureCache::IsFor(const UInt holeNumber) const
+{ return isValid_ && holeNumber_ == holeNumber; }
+
+void ZmwFeatureCache::Invalidate(void)
+{ isValid_ = false; }
+
+void ZmwFeatureCache::Encode(const SMRTSequence& read, const Settings& settings)
+{
+    // availability of each requested feature is checked by the caller
+    const DNALength length = read.length;
+
+    if (settings.usingDeletionQV)
+        internal::EncodeQVs(reinterpret_cast<const unsigned char*>(read.deletionQV.data), length, &deletionQVs);
+    if (settings.usingInsertionQV)
+        internal::EncodeQVs(reinterpret_cast<const unsigned char*>(read.insertionQV.data), length, &insertionQVs);
+    if (settings.usingMergeQV)
+        internal::EncodeQVs(reinterpret_cast<const unsigned char*>(read.mergeQV.data), length, &mergeQVs);
+    if (settings.usingSubstitutionQV)
+        internal::EncodeQVs(reinterpret_cast<const unsigned char*>(read.substitutionQV.data), length, &substitutionQVs);
+
+    if (settings.usingDeletionTag) {
+        const char* tags = reinterpret_cast<const char*>(read.deletionTag);
+        deletionTags.assign(tags, tags + length);
+    }
+    if (settings.usingSubstitutionTag) {
+        const char* tags = reinterpret_cast<const char*>(read.substitutionTag);
+        substitutionTags.assign(tags, tags + length);
+    }
+
+    if (settings.usingIPD)
+        internal::EncodeFrames(reinterpret_cast<const uint16_t*>(read.preBaseFrames), length, settings.losslessFrames,
+                               &rawIPDs, &encodedIPDs);
+    if (settings.usingPulseWidth)
+        internal::EncodeFrames(reinterpret_cast<const uint16_t*>(read.widthInFrames), length, settings.losslessFrames,
+                               &rawPulseWidths, &encodedPulseWidths);
+
+    holeNumber_ = read.zmwData.holeNumber;
+    isValid_ = true;
+}
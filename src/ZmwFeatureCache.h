@@ -0,0 +1,54 @@
+// Author: Derek Barnett
+
+#ifndef ZMWFEATURECACHE_H
+#define ZMWFEATURECACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <pbdata/SMRTSequence.hpp>
+
+#include "Settings.h"
+
+//
+// ZmwFeatureCache holds the per-base tag data of one ZMW's full read, encoded
+// once (QVs to FASTQ, frames to the lossy 8-bit codec) & then sliced for each
+// record taken from that ZMW: subreads, adapters, LQ/HQ regions & polymerase
+// reads alike. All of these encodings are per-base, so slicing the encoded
+// read gives the same bytes as encoding each slice.
+//
+class ZmwFeatureCache
+{
+public:
+    ZmwFeatureCache(void);
+
+public:
+    // true if Encode() was called for this ZMW since the last Invalidate()
+    bool IsFor(const UInt holeNumber) const;
+
+    void Encode(const SMRTSequence& read, const Settings& settings);
+    void Invalidate(void);
+
+public:
+    // FASTQ-encoded QVs
+    std::string deletionQVs;
+    std::string insertionQVs;
+    std::string mergeQVs;
+    std::string substitutionQVs;
+
+    std::string deletionTags;
+    std::string substitutionTags;
+
+    // frames, raw (lossless) or encoded
+    std::vector<uint16_t> rawIPDs;
+    std::vector<uint16_t> rawPulseWidths;
+    std::vector<uint8_t> encodedIPDs;
+    std::vector<uint8_t> encodedPulseWidths;
+
+private:
+    bool isValid_;
+    UInt holeNumber_;
+};
+
+#endif // ZMWFEATURECACHE_H
@@ -0,0 +1,81 @@
+// Author: Derek Barnett
+
+#include "ZmwSelection.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace internal {
+
+// splitmix64 finalizer, spreads consecutive hole numbers over the whole range
+static inline
+uint64_t Mix(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+} // namespace internal
+
+ZmwRange ZmwSelection::ByHoleNumber(const std::vector<uint32_t>& holeNumbers,
+                                    const uint64_t first,
+                                    const uint64_t last)
+{
+    const auto begin = std::lower_bound(holeNumbers.begin(), holeNumbers.end(), first);
+    const auto end   = std::lower_bound(begin, holeNumbers.end(), last);
+    return ZmwRange(begin - holeNumbers.begin(), end - holeNumbers.begin());
+}
+
+std::vector<ZmwRange> ZmwSelection::ByChunk(const std::vector<std::vector<int> >& numEvents,
+                                            const size_t chunk,
+                                            const size_t numChunks)
+{
+    assert(chunk >= 1 && chunk <= numChunks);
+
+    // weigh ZMWs by bases, or count them if there are no bases at all
+    uint64_t total = 0;
+    for (const std::vector<int>& fileEvents : numEvents) {
+        for (const int numEvent : fileEvents)
+            total += static_cast<uint64_t>(std::max(numEvent, 0));
+    }
+    const bool isCountingZmws = (total == 0);
+    if (isCountingZmws) {
+        for (const std::vector<int>& fileEvents : numEvents)
+            total += fileEvents.size();
+    }
+
+    // a ZMW belongs to the chunk its first base falls in
+    const uint64_t lo = total * (chunk - 1) / numChunks;
+    const uint64_t hi = total * chunk / numChunks;
+    const bool isLastChunk = (chunk == numChunks);
+
+    std::vector<ZmwRange> ranges;
+    uint64_t offset = 0;
+    for (const std::vector<int>& fileEvents : numEvents) {
+        ZmwRange range;
+        bool isInChunk = false;
+        for (size_t i = 0; i < fileEvents.size(); ++i) {
+            if (offset >= lo && (offset < hi || isLastChunk)) {
+                if (!isInChunk)
+                    range.begin = i;
+                range.end = i + 1;
+                isInChunk = true;
+            }
+            offset += (isCountingZmws ? 1 : static_cast<uint64_t>(std::max(fileEvents[i], 0)));
+        }
+        ranges.push_back(range);
+    }
+    return ranges;
+}
+
+bool ZmwSelection::IsSampled(const uint32_t holeNumber,
+                             const double fraction,
+                             const uint64_t seed)
+{
+    const uint64_t hash = internal::Mix(holeNumber + seed * 0x9e3779b97f4a7c15ULL);
+
+    // top 53 bits as a uniform double in [0,1)
+    const double u = static_cast<double>(hash >> 11) * (1.0 / 9007199254740992.0);
+    return u < fraction;
+}
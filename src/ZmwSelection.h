@@ -0,0 +1,48 @@
+// Author: Derek Barnett
+
+#ifndef ZMWSELECTION_H
+#define ZMWSELECTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// [begin, end) ZMW indices within one bax file
+struct ZmwRange
+{
+    size_t begin;
+    size_t end;
+
+    ZmwRange(void) : begin(0), end(0) { }
+    ZmwRange(const size_t b, const size_t e) : begin(b), end(e) { }
+
+    bool Empty(void) const { return end <= begin; }
+};
+
+//
+// ZmwSelection maps a subset of a movie's ZMWs (for --zmw-range or --chunk)
+// onto per-file index ranges, so converters can step over everything else
+// without reading it. Subsampling (--subsample-fraction) picks ZMWs by a hash
+// of the hole number, so the same seed selects the same ZMWs on every run.
+//
+class ZmwSelection
+{
+public:
+    // ZMWs whose hole numbers are in [first, last), holeNumbers must be sorted
+    static ZmwRange ByHoleNumber(const std::vector<uint32_t>& holeNumbers,
+                                 const uint64_t first,
+                                 const uint64_t last);
+
+    // chunk (1-based) of numChunks, balanced by base count across all files
+    // (numEvents holds each file's per-ZMW base counts, in conversion order)
+    static std::vector<ZmwRange> ByChunk(const std::vector<std::vector<int> >& numEvents,
+                                         const size_t chunk,
+                                         const size_t numChunks);
+
+    // true if holeNumber is in the seeded sample of fraction (0-1) of all ZMWs
+    static bool IsSampled(const uint32_t holeNumber,
+                          const double fraction,
+                          const uint64_t seed);
+};
+
+#endif // ZMWSELECTION_H
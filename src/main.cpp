@@ -1,5 +1,6 @@
 // Author: Derek Barnett
 
+#include "BamMerger.h"
 #include "Bax2Bam.h"
 #include "OptionParser.h"
 #include "Settings.h"
@@ -7,11 +8,57 @@
 #include <string>
 #include <cstdlib>
 
+// bax2bam merge -o OUT.bam IN.bam ...
+static int RunMerge(int argc, char* argv[])
+{
+    optparse::OptionParser parser;
+    parser.description("Merges BAM files converted in shards (--chunk, --zmw-range) into one "
+                       "BAM & PBI, without recompressing records. Inputs are given in order.");
+    parser.prog("bax2bam merge");
+    parser.usage("%prog -o OUT.bam IN.bam [IN.bam ...]");
+    parser.add_help_option(true);
+    parser.add_option("-o")
+          .dest("output")
+          .metavar("STRING")
+          .help("Output BAM filename, its PBI is written alongside.");
+    parser.add_option("--stats")
+          .dest("stats")
+          .action("store_true")
+          .help("Print merge statistics to stderr when finished.");
+
+    const optparse::Values options = parser.parse_args(argc, argv);
+    const std::string outputFilename = options["output"];
+    if (outputFilename.empty() || parser.args().empty()) {
+        std::cerr << std::endl << "ERROR: output filename and input BAM files are required"
+                  << std::endl << std::endl;
+        parser.print_help();
+        return EXIT_FAILURE;
+    }
+
+    BamMerger merger(outputFilename, parser.args());
+    const bool success = merger.Run();
+    if (options.is_set("stats") && options.get("stats")) {
+        std::cerr << "BGZF blocks copied: " << merger.BlocksCopied() << std::endl
+                  << "bytes copied: " << merger.BytesCopied() << std::endl;
+    }
+    if (!success) {
+        for (const std::string& e : merger.Errors())
+            std::cerr << "ERROR: " << e << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char* argv[])
 {
+    // subcommands
+    if (argc > 1 && std::string(argv[1]) == "merge")
+        return RunMerge(argc - 1, argv + 1);
+
     // setup help & options
     optparse::OptionParser parser;
-    parser.description("bax2bam converts the legacy PacBio basecall format (bax.h5) into the BAM basecall format.");
+    parser.description("bax2bam converts the legacy PacBio basecall format (bax.h5) into the BAM basecall format. "
+                       "Run 'bax2bam merge --help' for joining shard outputs.");
     parser.prog("bax2bam");
     parser.version("0.0.8");
     parser.add_version_option(true);
@@ -33,7 +80,18 @@ int main(int argc, char* argv[])
     ioGroup.add_option("-o")
            .dest(Settings::Option::output_)
 	   .metavar("STRING")
-           .help("Prefix of output filenames. Movie name will be used if no prefix provided");
+           .help("Prefix of output filenames. Movie name will be used if no prefix provided. "
+                 "Use '-' (or the path of a named pipe) to stream the main BAM instead; "
+                 "no PBI or dataset XML is written in that case");
+    ioGroup.add_option("--scraps-output")
+           .dest(Settings::Option::scrapsOutput_)
+           .metavar("STRING")
+           .help("When streaming, write the scraps BAM to this file. Scraps are not written otherwise");
+    ioGroup.add_option("--tmpdir")
+           .dest(Settings::Option::tmpDir_)
+           .metavar("STRING")
+           .help("Write outputs (BAMs, PBIs, XML) to this scratch directory first, then move "
+                 "each into place once it is complete");
     ioGroup.add_option("--output-xml")
            .dest(Settings::Option::outputXml_)
            .metavar("STRING")
@@ -48,7 +106,9 @@ int main(int argc, char* argv[])
                  .help("Specify that input data is from Sequel. "
                        "bax2bam will assume RS unless this option is specified");
 
-    auto readModeGroup = optparse::OptionGroup(parser, "Output read types (mutually exclusive)");
+    auto readModeGroup = optparse::OptionGroup(parser, "Output read types");
+    readModeGroup.group_description("--subread, --hqregion & --polymeraseread may be combined, each ZMW is then "
+                                    "read once & written to every selected output. --ccs cannot be combined.");
     readModeGroup.add_option("--subread")
                  .dest(Settings::Option::subreadMode_)
                  .action("store_true")
@@ -67,6 +127,24 @@ int main(int argc, char* argv[])
                  .help("Output CCS sequences (requires ccs.h5 input)");
     parser.add_option_group(readModeGroup);
 
+    auto textGroup = optparse::OptionGroup(parser, "Sequence-only output");
+    textGroup.group_description("Write reads as FASTA/FASTQ text instead of BAM, for consumers that only need "
+                                "bases. Only base calls (& qualities for FASTQ) are read; no pulse features, "
+                                "scraps, PBI or dataset XML are written.");
+    textGroup.add_option("--fasta")
+             .dest(Settings::Option::fastaOutput_)
+             .action("store_true")
+             .help("Output FASTA.");
+    textGroup.add_option("--fastq")
+             .dest(Settings::Option::fastqOutput_)
+             .action("store_true")
+             .help("Output FASTQ.");
+    textGroup.add_option("--gzip")
+             .dest(Settings::Option::gzipOutput_)
+             .action("store_true")
+             .help("Compress FASTA/FASTQ output (BGZF, readable by gunzip). Uses --compression-level.");
+    parser.add_option_group(textGroup);
+
     auto featureGroup = optparse::OptionGroup(parser, "Pulse feature options");
     featureGroup.group_description("Configure pulse features in the output BAM. Supported features include:\n"
                                    "    Pulse Feature:    BAM tag:  Default:\n"
@@ -94,6 +172,73 @@ int main(int argc, char* argv[])
                 .help("Store full, 16-bit IPD/PulseWidth data, instead of (default) downsampled, 8-bit encoding.");
     parser.add_option_group(featureGroup);
 
+    auto compressionGroup = optparse::OptionGroup(parser, "Output compression & buffering");
+    compressionGroup.add_option("--compression-level")
+                    .dest(Settings::Option::compressionLevel_)
+                    .metavar("INT")
+                    .help("BGZF compression level of the output BAM(s), 0 (uncompressed) to 9 (best). "
+                          "Default is the zlib default.");
+    compressionGroup.add_option("--scraps-compression-level")
+                    .dest(Settings::Option::scrapsCompressionLevel_)
+                    .metavar("INT")
+                    .help("Compression level of the scraps BAM, if different from --compression-level.");
+    compressionGroup.add_option("--write-buffer")
+                    .dest(Settings::Option::writeBuffer_)
+                    .metavar("SIZE")
+                    .help("Collect output into buffers of this size (e.g. 8M-64M) before writing, "
+                          "for fewer, larger writes on parallel filesystems. Default is off.");
+    compressionGroup.add_option("--direct-io")
+                    .dest(Settings::Option::directIO_)
+                    .action("store_true")
+                    .help("Write output files with O_DIRECT, bypassing the page cache. "
+                          "Uses a write buffer (default 8M) with aligned blocks.");
+    parser.add_option_group(compressionGroup);
+
+    auto shardGroup = optparse::OptionGroup(parser, "ZMW subsets");
+    shardGroup.group_description("Convert only part of a movie, e.g. to spread one movie across "
+                                 "several jobs. Output file names get a .zmws<start>-<end> or "
+                                 ".chunk<i>of<N> label.");
+    shardGroup.add_option("--zmw-range")
+              .dest(Settings::Option::zmwRange_)
+              .metavar("START:END")
+              .help("Only convert ZMWs with hole numbers in [START, END).");
+    shardGroup.add_option("--chunk")
+              .dest(Settings::Option::chunk_)
+              .metavar("I/N")
+              .help("Only convert chunk I (1-based) of N, with chunks balanced by base count.");
+    shardGroup.add_option("--subsample-fraction")
+              .dest(Settings::Option::subsampleFraction_)
+              .metavar("FRACTION")
+              .help("Only convert this fraction (0-1] of ZMWs, chosen by a hash of the hole number. "
+                    "Other ZMWs are never read. Default is 1 (all).");
+    shardGroup.add_option("--subsample-seed")
+              .dest(Settings::Option::subsampleSeed_)
+              .metavar("SEED")
+              .help("Seed for --subsample-fraction, the same seed picks the same ZMWs. Default is 0.");
+    parser.add_option_group(shardGroup);
+
+    auto filterGroup = optparse::OptionGroup(parser, "Read filters");
+    filterGroup.group_description("Drop reads before they are converted. Counts are reported with --stats.");
+    filterGroup.add_option("--min-read-score")
+               .dest(Settings::Option::minReadScore_)
+               .metavar("SCORE")
+               .help("Skip ZMWs with a read score below SCORE (0-1). Default is off.");
+    filterGroup.add_option("--min-subread-length")
+               .dest(Settings::Option::minSubreadLength_)
+               .metavar("LENGTH")
+               .help("Skip subreads shorter than LENGTH bases. Default is off.");
+    filterGroup.add_option("--min-hq-length")
+               .dest(Settings::Option::minHqLength_)
+               .metavar("LENGTH")
+               .help("Skip ZMWs whose HQ region is shorter than LENGTH bases (subread & HQ region "
+                     "output). Default is off.");
+    filterGroup.add_option("--scrap-filtered")
+               .dest(Settings::Option::scrapFiltered_)
+               .action("store_true")
+               .help("Write skipped subreads & HQ regions to the scraps BAM as filtered (sc:F) "
+                     "records, instead of dropping them.");
+    parser.add_option_group(filterGroup);
+
     auto bamModeGroup = optparse::OptionGroup(parser, "Output BAM file type");
     bamModeGroup.add_option("--internal")
                 .dest(Settings::Option::internalMode_)
@@ -102,8 +247,49 @@ int main(int argc, char* argv[])
                       "non-sequencing ZMWs should be included in the output scraps "
                       "BAM file, if applicable."
                       );
+    bamModeGroup.add_option("--lean-scraps")
+                .dest(Settings::Option::leanScraps_)
+                .action("store_true")
+                .help("Leave pulse features (--pulsefeatures) out of scraps BAM records & header, "
+                      "keeping bases & per-record tags. Roughly halves scraps size.");
     parser.add_option_group(bamModeGroup);
 
+    auto resourceGroup = optparse::OptionGroup(parser, "Resource usage");
+    resourceGroup.add_option("--max-memory")
+                 .dest(Settings::Option::maxMemory_)
+                 .metavar("SIZE")
+                 .help("Approximate memory limit (e.g. 512M, 4G). Buffers, queues and preloaded "
+                       "tables are sized to fit, falling back to slower streaming reads as needed. "
+                       "Default is no limit.");
+    resourceGroup.add_option("--chunk-cache")
+                 .dest(Settings::Option::chunkCache_)
+                 .metavar("SIZE|auto")
+                 .help("HDF5 raw-data chunk cache per input dataset (e.g. 8M). 'auto' sizes it "
+                       "to each file's largest chunk. Default is the HDF5 default (1M).");
+    resourceGroup.add_option("--chunk-cache-slots")
+                 .dest(Settings::Option::chunkCacheSlots_)
+                 .metavar("INT")
+                 .help("Number of hash table slots in each chunk cache (ideally a prime).");
+    resourceGroup.add_option("--chunk-cache-w0")
+                 .dest(Settings::Option::chunkCacheW0_)
+                 .metavar("FLOAT")
+                 .help("Chunk cache preemption policy in [0,1]. 1 evicts fully read chunks first.");
+    resourceGroup.add_option("--metadata-cache")
+                 .dest(Settings::Option::metadataCache_)
+                 .metavar("SIZE")
+                 .help("Initial HDF5 metadata cache size per input file, 1K to 128M.");
+    resourceGroup.add_option("--prefetch")
+                 .dest(Settings::Option::prefetch_)
+                 .metavar("INT")
+                 .help("Prefetch input data for this many ZMWs ahead of the reader, on a "
+                       "background thread. Useful for inputs on network filesystems. Default is off.");
+    resourceGroup.add_option("--prefetch-mode")
+                 .dest(Settings::Option::prefetchMode_)
+                 .metavar("advise|read")
+                 .help("How to prefetch: 'advise' (posix_fadvise, default) or 'read' (explicit "
+                       "reads, for filesystems that ignore readahead advice).");
+    parser.add_option_group(resourceGroup);
+
     auto additionalGroup = optparse::OptionGroup(parser, "Additional options");
     additionalGroup.add_option("--allowUnrecognizedChemistryTriple")
                    .dest(Settings::Option::allowUnsupportedChem_)
@@ -112,8 +298,51 @@ int main(int argc, char* argv[])
                          "with chemistries that are supported in SMRT Analysis 3. "
                          "Set this flag to disable the strict check and allow "
                          "generation of BAM files containing legacy chemistries.");
+    additionalGroup.add_option("--stats")
+                   .dest(Settings::Option::stats_)
+                   .action("store_true")
+                   .help("Print run statistics to stderr when conversion finishes.");
+    additionalGroup.add_option("--stats-only")
+                   .dest(Settings::Option::statsOnly_)
+                   .action("store_true")
+                   .help("Dry run: count the records & bases conversion would write, & estimate the "
+                         "output size, from region tables & ZMW metadata only. No files are written.");
     parser.add_option_group(additionalGroup);
 
+    auto checkpointGroup = optparse::OptionGroup(parser, "Checkpoints");
+    checkpointGroup.group_description("Let a stopped conversion carry on where it left off. Resume "
+                                      "points are kept in <output>.checkpoint (removed on success). "
+                                      "BAM output to files only.");
+    checkpointGroup.add_option("--checkpoint")
+                   .dest(Settings::Option::checkpoint_)
+                   .metavar("INT")
+                   .help("Write a resume point every INT ZMWs. Output is only identical between runs "
+                         "with the same interval. Default is off.");
+    checkpointGroup.add_option("--resume")
+                   .dest(Settings::Option::resume_)
+                   .action("store_true")
+                   .help("Cut outputs back to their last complete checkpoint & convert the rest, "
+                         "instead of starting over. Other options must match the stopped run. "
+                         "Starts from scratch if there is no checkpoint.");
+    parser.add_option_group(checkpointGroup);
+
+    auto splitGroup = optparse::OptionGroup(parser, "Split output");
+    splitGroup.group_description("Write the output as several <prefix>.partK BAM files (scraps "
+                                 "alongside), each with its own PBI & starting at a ZMW boundary. "
+                                 "A dataset XML lists every part. Parts roll over at whichever "
+                                 "limit is reached first.");
+    splitGroup.add_option("--split-by-zmws")
+              .dest(Settings::Option::splitByZmws_)
+              .metavar("INT")
+              .help("Start a new part after this many ZMWs have been read.");
+    splitGroup.add_option("--split-by-bytes")
+              .dest(Settings::Option::splitByBytes_)
+              .metavar("SIZE")
+              .help("Start a new part once the main BAM reaches this size on disk (e.g. 4G). "
+                    "Size is checked every 64 ZMWs, so parts run over by up to the output "
+                    "buffers plus those ZMWs.");
+    parser.add_option_group(splitGroup);
+
     // parse command line
     Settings settings = Settings::FromCommandLine(parser, argc, argv);
     if (!settings.errors.empty()) {
@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+#
+# Compares BGZF deflate backends (libdeflate vs zlib) and compression levels
+# on bax2bam output: wall time, throughput (input bax.h5 MB/s) and output
+# size for each backend & level.
+#
+# The backend is chosen when htslib is built, so comparing the two takes two
+# bax2bam builds: one against an htslib with libdeflate & one without. Each
+# executable's backend is read from its --stats report.
+#
+# usage: bench_compression.sh [bax.h5 ...]
+#
+#   BAX2BAM        path to the bax2bam executable (required)
+#   BAX2BAM_ALT    a second bax2bam, built against the other backend (optional)
+#   BENCH_LEVELS   compression levels to run (default: "0 1 3 6 9")
+#   BENCH_ARGS     extra bax2bam arguments (default: "--subread")
+#
+# requires: bash, awk, GNU date
+#
+set -euo pipefail
+
+: "${BAX2BAM:?BAX2BAM must point to the bax2bam executable}"
+LEVELS=${BENCH_LEVELS:-"0 1 3 6 9"}
+ARGS=${BENCH_ARGS:-"--subread"}
+
+if [ $# -eq 0 ]; then
+  set -- /pbi/dept/secondary/siv/testdata/bax2bam/m160823_221224_ethan_c010091942559900001800000112311890_s1_p0.1.bax.h5
+fi
+
+EXES=("${BAX2BAM}")
+if [ -n "${BAX2BAM_ALT:-}" ]; then
+  EXES+=("${BAX2BAM_ALT}")
+fi
+
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "${WORKDIR}"' EXIT
+
+INPUT_BYTES=$(cat "$@" | wc -c)
+
+# libdeflate if htslib reports it (the statistic is only present then), zlib otherwise
+backend() {
+  local exe=$1
+  shift
+  local stats
+  stats=$("${exe}" --stats -o "${WORKDIR}/probe" ${ARGS} "$@" 2>&1)
+  if grep -q "BGZF compression via libdeflate" <<< "${stats}"; then
+    echo "libdeflate"
+  else
+    echo "zlib"
+  fi
+  rm -f "${WORKDIR}"/probe.*
+}
+
+printf "%-11s %-6s %10s %12s %14s %14s\n" "backend" "level" "seconds" "input MB/s" "main bytes" "scraps bytes"
+BACKENDS=()
+for exe in "${EXES[@]}"; do
+  name=$(backend "${exe}" "$@")
+  BACKENDS+=("${name}")
+  for level in ${LEVELS}; do
+    prefix="${WORKDIR}/level${level}"
+    start=$(date +%s.%N)
+    "${exe}" -o "${prefix}" --compression-level "${level}" ${ARGS} "$@"
+    end=$(date +%s.%N)
+
+    seconds=$(awk -v s="${start}" -v e="${end}" 'BEGIN { print e - s }')
+    throughput=$(awk -v b="${INPUT_BYTES}" -v s="${seconds}" 'BEGIN { print b / 1048576 / s }')
+    main=$(ls "${prefix}".*.bam | grep -v scraps | head -1)
+    mainBytes=$(wc -c < "${main}")
+    scrapsBytes=0
+    if [ -f "${prefix}.scraps.bam" ]; then
+      scrapsBytes=$(wc -c < "${prefix}.scraps.bam")
+    fi
+
+    printf "%-11s %-6s %10.2f %12.2f %14d %14d\n" "${name}" "${level}" "${seconds}" "${throughput}" "${mainBytes}" "${scrapsBytes}"
+    rm -f "${prefix}".*
+  done
+done
+
+if [ ${#EXES[@]} -eq 1 ]; then
+  echo "only the ${BACKENDS[0]} backend was measured, set BAX2BAM_ALT to a build against the other one to compare"
+elif [ "${BACKENDS[0]}" = "${BACKENDS[1]}" ]; then
+  echo "warning: BAX2BAM and BAX2BAM_ALT both use ${BACKENDS[0]}"
+fi
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+#
+# Compares output write paths: direct htslib writes (current default) vs.
+# large write buffers vs. O_DIRECT. Reports wall time & output throughput.
+#
+# usage: bench_write_buffer.sh [bax.h5 ...]
+#
+#   BAX2BAM        path to the bax2bam executable (required)
+#   BENCH_OUTDIR   directory to write to, i.e. the filesystem under test (default: mktemp -d)
+#   BENCH_ARGS     extra bax2bam arguments (default: "--subread")
+#
+# requires: bash, awk, GNU date
+#
+set -euo pipefail
+
+: "${BAX2BAM:?BAX2BAM must point to the bax2bam executable}"
+ARGS=${BENCH_ARGS:-"--subread"}
+
+if [ $# -eq 0 ]; then
+  set -- /pbi/dept/secondary/siv/testdata/bax2bam/m160823_221224_ethan_c010091942559900001800000112311890_s1_p0.1.bax.h5
+fi
+
+if [ -n "${BENCH_OUTDIR:-}" ]; then
+  WORKDIR=$(mktemp -d "${BENCH_OUTDIR}/bench_write.XXXXXX")
+else
+  WORKDIR=$(mktemp -d)
+fi
+trap 'rm -rf "${WORKDIR}"' EXIT
+
+run() {
+  local label=$1
+  shift
+  local prefix="${WORKDIR}/out"
+  local start end seconds bytes throughput
+  start=$(date +%s.%N)
+  "${BAX2BAM}" -o "${prefix}" "$@" ${ARGS} "${INPUTS[@]}"
+  end=$(date +%s.%N)
+  seconds=$(awk -v s="${start}" -v e="${end}" 'BEGIN { print e - s }')
+  bytes=$(cat "${prefix}".*.bam | wc -c)
+  throughput=$(awk -v b="${bytes}" -v s="${seconds}" 'BEGIN { print b / 1048576 / s }')
+  printf "%-20s %10.2f %14.2f %14d\n" "${label}" "${seconds}" "${throughput}" "${bytes}"
+  rm -f "${prefix}".*
+}
+
+INPUTS=("$@")
+printf "%-20s %10s %14s %14s\n" "path" "seconds" "output MB/s" "output bytes"
+run "htslib (default)"
+run "buffer 8M"          --write-buffer 8M
+run "buffer 64M"         --write-buffer 64M
+run "O_DIRECT 8M"        --direct-io --write-buffer 8M
+run "O_DIRECT 64M"       --direct-io --write-buffer 64M
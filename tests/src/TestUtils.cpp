@@ -7,6 +7,8 @@
 #include <cstdio>
 #include <cstdlib>
 
+#include <pbbam/DataSet.h>
+
 using namespace PacBio;
 using namespace PacBio::BAM;
 
@@ -23,6 +25,15 @@ void RemoveFile(const std::string& filename)
     RemoveFiles(filenames);
 }
 
+void WriteBaxDatasetXml(const std::vector<std::string>& baxFilenames,
+                        const std::string& xmlFilename)
+{
+    DataSet dataset(DataSet::HDF_SUBREAD);
+    for (const std::string& fn : baxFilenames)
+        dataset.ExternalResources().Add(ExternalResource("PacBio.SubreadFile.BaxFile", fn));
+    dataset.Save(xmlFilename);
+}
+
 int RunBax2Bam(const std::vector<std::string>& baxFilenames,
                const std::string& outputType,
                const std::string& additionalArgs)
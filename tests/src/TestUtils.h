@@ -10,6 +10,10 @@
 void RemoveFile(const std::string& filename);
 void RemoveFiles(const std::vector<std::string>& filenames);
 
+// writes an HdfSubreadSet listing baxFilenames, for --xml input
+void WriteBaxDatasetXml(const std::vector<std::string>& baxFilenames,
+                        const std::string& xmlFilename);
+
 int RunBax2Bam(const std::vector<std::string>& baxFilenames,
                const std::string& outputType,
                const std::string& additionalArgs = std::string());
@@ -0,0 +1,100 @@
+// Author: Derek Barnett
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "BufferedFileSink.h"
+
+namespace tests {
+
+// bytes that don't repeat on block boundaries, so misplaced blocks show up
+static std::string MakeData(const size_t length)
+{
+    std::string data(length, '\0');
+    unsigned int x = 12345;
+    for (size_t i = 0; i < length; ++i) {
+        x = x * 1103515245 + 12345;
+        data[i] = static_cast<char>(x >> 16);
+    }
+    return data;
+}
+
+static std::string ReadFile(const std::string& fn)
+{
+    std::ifstream in(fn, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// writes data through the sink the way htslib does: opening WriterPath() & writing in pieces
+static void RoundTrip(const std::string& data,
+                      const size_t bufferSize,
+                      const bool useDirectIO,
+                      const size_t pieceSize)
+{
+    const std::string fn = "bufferedfilesink_roundtrip.bin";
+    {
+        BufferedFileSink sink(fn, bufferSize, useDirectIO);
+        ASSERT_TRUE(sink.Open()) << sink.Error();
+
+        const int fd = open(sink.WriterPath().c_str(), O_WRONLY);
+        ASSERT_GE(fd, 0);
+        for (size_t offset = 0; offset < data.size(); offset += pieceSize) {
+            const size_t length = std::min(pieceSize, data.size() - offset);
+            ASSERT_EQ(static_cast<ssize_t>(length), write(fd, data.data() + offset, length));
+        }
+        close(fd);
+
+        ASSERT_TRUE(sink.Finish()) << sink.Error();
+        EXPECT_EQ(data.size(), sink.BytesWritten());
+    }
+    EXPECT_TRUE(data == ReadFile(fn));
+    remove(fn.c_str());
+}
+
+} // namespace tests
+
+TEST(BufferedFileSinkTest, RoundTrip_Empty)
+{
+    tests::RoundTrip(std::string(), BufferedFileSink::Alignment, false, 1);
+}
+
+TEST(BufferedFileSinkTest, RoundTrip_SmallerThanBuffer)
+{
+    tests::RoundTrip(tests::MakeData(1000), BufferedFileSink::DefaultBufferSize, false, 100);
+}
+
+TEST(BufferedFileSinkTest, RoundTrip_ManyBuffersWithTail)
+{
+    // several full buffers, then a partial block
+    const size_t bufferSize = 4 * BufferedFileSink::Alignment;
+    tests::RoundTrip(tests::MakeData(10 * bufferSize + 123), bufferSize, false, 777);
+}
+
+TEST(BufferedFileSinkTest, RoundTrip_ExactBuffers)
+{
+    const size_t bufferSize = 2 * BufferedFileSink::Alignment;
+    tests::RoundTrip(tests::MakeData(5 * bufferSize), bufferSize, false, 4096);
+}
+
+TEST(BufferedFileSinkTest, RoundTrip_DirectIO)
+{
+    // falls back to buffered writes where O_DIRECT is unsupported, contents match either way
+    const size_t bufferSize = 4 * BufferedFileSink::Alignment;
+    tests::RoundTrip(tests::MakeData(10 * bufferSize + 123), bufferSize, true, 777);
+    tests::RoundTrip(tests::MakeData(3 * bufferSize), bufferSize, true, 65536);
+}
+
+TEST(BufferedFileSinkTest, Open_UnwritableFileFails)
+{
+    BufferedFileSink sink("no_such_dir/bufferedfilesink.bin");
+    EXPECT_FALSE(sink.Open());
+    EXPECT_FALSE(sink.Error().empty());
+}
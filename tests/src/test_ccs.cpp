@@ -217,3 +217,124 @@ cleanup:
 
     }); // EXPECT_NO_THROW
 }
+
+namespace tests {
+
+static const std::string ccsMovieName = "m131018_081703_42161_c100585152550000001823088404281404_s1_p0";
+
+// name, sequence & pass count
+static std::string CcsRecordKey(const BamRecord& record)
+{
+    return record.FullName() + " " + record.Sequence() + " " +
+           std::to_string(record.NumPasses());
+}
+
+static std::vector<std::string> CcsRecords(const std::string& fn)
+{
+    std::vector<std::string> records;
+    EntireFileQuery query(BamFile{ fn });
+    for (const BamRecord& record : query)
+        records.push_back(CcsRecordKey(record));
+    return records;
+}
+
+// hole numbers of the ccs.h5 file's ZMWs, by ZMW index
+static std::vector<int> CcsHoleNumbers(const std::string& fn)
+{
+    std::vector<int> holeNumbers;
+    HDFCCSReader<CCSSequence> reader;
+    reader.IncludeField("Basecall");
+    reader.SetReadBasesFromCCS();
+    if (reader.Initialize(fn) != 1)
+        return holeNumbers;
+
+    CCSSequence record;
+    while (reader.GetNext(record)) {
+        holeNumbers.push_back(record.zmwData.holeNumber);
+        record.Free();
+    }
+    reader.Close();
+    return holeNumbers;
+}
+
+} // namespace tests
+
+TEST(CcsTest, ZmwRange_MatchesFullRun)
+{
+    // setup
+    const std::string& movieName = tests::ccsMovieName;
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/data/" + movieName + ".1.ccs.h5");
+
+    const std::string generatedBam = movieName + ".ccs.bam";
+    const size_t zmwBegin = 1000;
+    const size_t zmwEnd = 3000;
+    const std::string rangeBam = movieName + ".zmws" + std::to_string(zmwBegin) +
+                                 "-" + std::to_string(zmwEnd) + ".ccs.bam";
+
+    const std::vector<int> holeNumbers = tests::CcsHoleNumbers(baxFilenames.front());
+    ASSERT_GT(holeNumbers.size(), zmwEnd);
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--ccs"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--ccs", "--zmw-range " + std::to_string(zmwBegin) +
+                                                   ":" + std::to_string(zmwEnd)));
+
+    EXPECT_NO_THROW(
+    {
+        // the full run's records from ZMWs [zmwBegin, zmwEnd), same content
+        const int firstHole = holeNumbers.at(zmwBegin);
+        const int endHole = holeNumbers.at(zmwEnd);
+        std::vector<std::string> expected;
+        EntireFileQuery query(BamFile{ generatedBam });
+        for (const BamRecord& record : query) {
+            if (record.HoleNumber() >= firstHole && record.HoleNumber() < endHole)
+                expected.push_back(tests::CcsRecordKey(record));
+        }
+        EXPECT_FALSE(expected.empty());
+        EXPECT_EQ(expected, tests::CcsRecords(rangeBam));
+    });
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, rangeBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(CcsTest, Chunks_MatchFullRun)
+{
+    // setup
+    const std::string& movieName = tests::ccsMovieName;
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/data/" + movieName + ".1.ccs.h5");
+
+    const std::string generatedBam = movieName + ".ccs.bam";
+    const std::string chunkBam1 = movieName + ".chunk1of3.ccs.bam";
+    const std::string chunkBam2 = movieName + ".chunk2of3.ccs.bam";
+    const std::string chunkBam3 = movieName + ".chunk3of3.ccs.bam";
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--ccs"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--ccs", "--chunk 1/3"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--ccs", "--chunk 2/3"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--ccs", "--chunk 3/3"));
+
+    EXPECT_NO_THROW(
+    {
+        // chunks, in order, hold the full run's records with the same content
+        std::vector<std::string> records;
+        for (const std::string& chunkBam : { chunkBam1, chunkBam2, chunkBam3 }) {
+            const std::vector<std::string> chunkRecords = tests::CcsRecords(chunkBam);
+            EXPECT_FALSE(chunkRecords.empty()) << chunkBam;
+            records.insert(records.end(), chunkRecords.begin(), chunkRecords.end());
+        }
+        EXPECT_EQ(tests::CcsRecords(generatedBam), records);
+    });
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, chunkBam1, chunkBam2, chunkBam3 }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
@@ -419,3 +419,60 @@ TEST(HqRegionsTest, EndToEnd_Single)
     });
 }
 
+
+TEST(HqRegionsTest, CombinedWithSubreads_MatchesSeparateRun)
+{
+    // setup
+    const std::string movieName = "m140905_042212_sidney_c100564852550000001823085912221377_s1_X0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/data/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".hqregions.bam";
+    const std::string scrapBam = movieName + ".lqregions.bam";
+    const std::string subreadBam = movieName + ".subreads.bam";
+    const std::string subreadScrapBam = movieName + ".scraps.bam";
+    const std::string features = "--pulsefeatures=\"DeletionQV,DeletionTag,InsertionQV,IPD,MergeQV,SubstitutionQV\"";
+
+    // HQ regions on their own
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--hqregion " + features));
+    std::vector<std::string> expectedNames;
+    std::vector<std::string> expectedDeletionQVs;
+    std::vector<std::vector<uint8_t> > expectedIPDs;
+    EXPECT_NO_THROW(
+    {
+        EntireFileQuery query(BamFile{ generatedBam });
+        for (const BamRecord& record : query) {
+            expectedNames.push_back(record.FullName());
+            expectedDeletionQVs.push_back(record.DeletionQV().Fastq());
+            expectedIPDs.push_back(record.IPD().Encode());
+        }
+    });
+    EXPECT_FALSE(expectedNames.empty());
+    RemoveFile(generatedBam);
+    RemoveFile(generatedBam + ".pbi");
+
+    // HQ regions written alongside subreads, from the same pass
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread --hqregion " + features));
+    EXPECT_NO_THROW(
+    {
+        EXPECT_TRUE(BamFile{ subreadBam }.PacBioIndexExists());
+
+        EntireFileQuery query(BamFile{ generatedBam });
+        size_t i = 0;
+        for (const BamRecord& record : query) {
+            ASSERT_LT(i, expectedNames.size());
+            EXPECT_EQ(expectedNames.at(i),       record.FullName());
+            EXPECT_EQ(expectedDeletionQVs.at(i), record.DeletionQV().Fastq());
+            EXPECT_EQ(expectedIPDs.at(i),        record.IPD().Encode());
+            ++i;
+        }
+        EXPECT_EQ(expectedNames.size(), i);
+    });
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam, subreadBam, subreadScrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
@@ -0,0 +1,71 @@
+// Author: Derek Barnett
+
+#include <cstddef>
+#include <limits>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "MemoryBudget.h"
+
+TEST(MemoryBudgetTest, ParseSize_PlainBytes)
+{
+    size_t bytes = 1;
+    EXPECT_TRUE(MemoryBudget::ParseSize("1048576", &bytes));
+    EXPECT_EQ(1048576u, bytes);
+
+    // zero parses, callers decide whether it's allowed
+    EXPECT_TRUE(MemoryBudget::ParseSize("0", &bytes));
+    EXPECT_EQ(0u, bytes);
+}
+
+TEST(MemoryBudgetTest, ParseSize_Suffixes)
+{
+    size_t bytes = 0;
+    EXPECT_TRUE(MemoryBudget::ParseSize("4K", &bytes));
+    EXPECT_EQ(size_t{4} << 10, bytes);
+    EXPECT_TRUE(MemoryBudget::ParseSize("512m", &bytes));
+    EXPECT_EQ(size_t{512} << 20, bytes);
+    EXPECT_TRUE(MemoryBudget::ParseSize("4G", &bytes));
+    EXPECT_EQ(size_t{4} << 30, bytes);
+    EXPECT_TRUE(MemoryBudget::ParseSize("2t", &bytes));
+    EXPECT_EQ(size_t{2} << 40, bytes);
+}
+
+TEST(MemoryBudgetTest, ParseSize_RejectsMalformedInput)
+{
+    size_t bytes = 0;
+    EXPECT_FALSE(MemoryBudget::ParseSize("", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize("G", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize("-1", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize(" 1G", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize("1GB", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize("1.5G", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize("4X", &bytes));
+}
+
+TEST(MemoryBudgetTest, ParseSize_RejectsOverflow)
+{
+    size_t bytes = 0;
+    const std::string maxBytes = std::to_string(std::numeric_limits<size_t>::max());
+    EXPECT_TRUE(MemoryBudget::ParseSize(maxBytes, &bytes));
+    EXPECT_EQ(std::numeric_limits<size_t>::max(), bytes);
+
+    EXPECT_FALSE(MemoryBudget::ParseSize(maxBytes + "0", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize("99999999999999999999999", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize(maxBytes + "K", &bytes));
+    EXPECT_FALSE(MemoryBudget::ParseSize("16777216T", &bytes)); // 2^64
+}
+
+TEST(MemoryBudgetTest, LimitedBudgetBoundsReadBuffers)
+{
+    const MemoryBudget unlimited;
+    EXPECT_FALSE(unlimited.IsLimited());
+    EXPECT_EQ(std::numeric_limits<size_t>::max(), unlimited.MaxReadBytes());
+
+    const MemoryBudget limited(size_t{1} << 30);
+    EXPECT_TRUE(limited.IsLimited());
+    EXPECT_GT(limited.MaxReadBytes(), 0u);
+    EXPECT_LT(limited.MaxReadBytes(), limited.MaxBytes());
+    EXPECT_LE(limited.ReadScoreBlockSize(), size_t{16384});
+}
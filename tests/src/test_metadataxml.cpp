@@ -0,0 +1,148 @@
+// Author: Derek Barnett
+
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "MetadataXml.h"
+
+namespace tests {
+
+static bool Scan(const std::string& xml, MetadataChemistry* chemistry)
+{
+    std::istringstream in(xml);
+    return MetadataXml::ScanChemistry(in, chemistry);
+}
+
+} // namespace tests
+
+TEST(MetadataXmlTest, Scan_PlainTags)
+{
+    const std::string xml =
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+        "<Metadata>\n"
+        "  <InstCtrlVer>2.3.0.3.154799</InstCtrlVer>\n"
+        "  <BindingKit><PartNumber>100-619-300</PartNumber></BindingKit>\n"
+        "  <SequencingKit><PartNumber>100-620-000</PartNumber></SequencingKit>\n"
+        "</Metadata>\n";
+
+    MetadataChemistry chemistry;
+    EXPECT_TRUE(tests::Scan(xml, &chemistry));
+    EXPECT_EQ("100-619-300", chemistry.bindingKit);
+    EXPECT_EQ("100-620-000", chemistry.sequencingKit);
+    EXPECT_EQ("2.3.0.3.154799", chemistry.basecallerVersion);
+}
+
+TEST(MetadataXmlTest, Scan_NamespacePrefixedTags)
+{
+    const std::string xml =
+        "<pb:Metadata xmlns:pb=\"http://pacificbiosciences.com/PacBioCollectionMetadata.xsd\">"
+        "<pb:BindingKit><pb:PartNumber>100-619-300</pb:PartNumber></pb:BindingKit>"
+        "<pb:SequencingKit><pb:PartNumber>100-620-000</pb:PartNumber></pb:SequencingKit>"
+        "<pb:InstCtrlVer>2.3.0.3.154799</pb:InstCtrlVer>"
+        "</pb:Metadata>";
+
+    MetadataChemistry chemistry;
+    EXPECT_TRUE(tests::Scan(xml, &chemistry));
+    EXPECT_EQ("100-619-300", chemistry.bindingKit);
+    EXPECT_EQ("100-620-000", chemistry.sequencingKit);
+    EXPECT_EQ("2.3.0.3.154799", chemistry.basecallerVersion);
+}
+
+TEST(MetadataXmlTest, Scan_AttributesCommentsAndCdata)
+{
+    // '>' inside a quoted attribute value doesn't end the tag
+    const std::string xml =
+        "<Metadata version=\"a>b\" note='x/y'>"
+        "<!-- <InstCtrlVer>commented out</InstCtrlVer> -->"
+        "<BindingKit Name=\"kit\"><PartNumber type=\"x\">100-619-300</PartNumber></BindingKit>"
+        "<SequencingKit><PartNumber><![CDATA[100-620-000]]></PartNumber></SequencingKit>"
+        "<InstCtrlVer>2.3.0.3.154799</InstCtrlVer>"
+        "</Metadata>";
+
+    MetadataChemistry chemistry;
+    EXPECT_TRUE(tests::Scan(xml, &chemistry));
+    EXPECT_EQ("100-619-300", chemistry.bindingKit);
+    EXPECT_EQ("100-620-000", chemistry.sequencingKit);
+    EXPECT_EQ("2.3.0.3.154799", chemistry.basecallerVersion);
+}
+
+TEST(MetadataXmlTest, Scan_OnlyOwnTextOfField)
+{
+    // child elements' text isn't part of the field's value
+    const std::string xml =
+        "<Metadata>"
+        "<BindingKit><PartNumber>100-<Note>ignored</Note>619-300</PartNumber></BindingKit>"
+        "<SequencingKit><PartNumber>100-620-000</PartNumber></SequencingKit>"
+        "<InstCtrlVer>2.3.0.3.154799</InstCtrlVer>"
+        "</Metadata>";
+
+    MetadataChemistry chemistry;
+    EXPECT_TRUE(tests::Scan(xml, &chemistry));
+    EXPECT_EQ("100-619-300", chemistry.bindingKit);
+}
+
+TEST(MetadataXmlTest, Scan_Entities)
+{
+    const std::string xml =
+        "<Metadata>"
+        "<BindingKit><PartNumber>a&amp;lt;b</PartNumber></BindingKit>"
+        "<SequencingKit><PartNumber>&#65;&#x42;&lt;&gt;&quot;&apos;</PartNumber></SequencingKit>"
+        "<InstCtrlVer><![CDATA[&amp;]]></InstCtrlVer>"
+        "</Metadata>";
+
+    MetadataChemistry chemistry;
+    EXPECT_TRUE(tests::Scan(xml, &chemistry));
+    EXPECT_EQ("a&lt;b", chemistry.bindingKit);
+    EXPECT_EQ("AB<>\"'", chemistry.sequencingKit);
+    EXPECT_EQ("&amp;", chemistry.basecallerVersion); // CDATA is literal
+}
+
+TEST(MetadataXmlTest, Scan_StopsOnceAllFieldsSeen)
+{
+    // nothing past the last field is read, so trailing junk doesn't matter
+    const std::string xml =
+        "<Metadata>"
+        "<BindingKit><PartNumber>100-619-300</PartNumber></BindingKit>"
+        "<SequencingKit><PartNumber>100-620-000</PartNumber></SequencingKit>"
+        "<InstCtrlVer>2.3.0.3.154799</InstCtrlVer>"
+        "<Unterminated";
+
+    std::istringstream in(xml);
+    MetadataChemistry chemistry;
+    EXPECT_TRUE(MetadataXml::ScanChemistry(in, &chemistry));
+    EXPECT_EQ("2.3.0.3.154799", chemistry.basecallerVersion);
+
+    std::string rest;
+    std::getline(in, rest);
+    EXPECT_EQ("<Unterminated", rest);
+}
+
+TEST(MetadataXmlTest, Scan_MissingFieldFails)
+{
+    const std::string xml =
+        "<Metadata>"
+        "<BindingKit><PartNumber>100-619-300</PartNumber></BindingKit>"
+        "<InstCtrlVer>2.3.0.3.154799</InstCtrlVer>"
+        "</Metadata>";
+
+    MetadataChemistry chemistry;
+    EXPECT_FALSE(tests::Scan(xml, &chemistry));
+}
+
+TEST(MetadataXmlTest, Scan_WrongPathIgnored)
+{
+    // PartNumber outside of the kit elements isn't a kit part number
+    const std::string xml =
+        "<Metadata>"
+        "<Other><PartNumber>wrong</PartNumber></Other>"
+        "<BindingKit><PartNumber>100-619-300</PartNumber></BindingKit>"
+        "<SequencingKit><PartNumber>100-620-000</PartNumber></SequencingKit>"
+        "<InstCtrlVer>2.3.0.3.154799</InstCtrlVer>"
+        "</Metadata>";
+
+    MetadataChemistry chemistry;
+    EXPECT_TRUE(tests::Scan(xml, &chemistry));
+    EXPECT_EQ("100-619-300", chemistry.bindingKit);
+}
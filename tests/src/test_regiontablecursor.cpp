@@ -0,0 +1,120 @@
+// Author: Derek Barnett
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <hdf/HDFBasReader.hpp>
+#include <hdf/HDFRegionTableReader.hpp>
+
+#include "RegionTableCursor.h"
+#include "TestData.h"
+
+namespace tests {
+
+static const std::string regionsBaxFn = Data_Dir + "/" +
+    "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0.1.bax.h5";
+
+static std::vector<UInt> BaxHoleNumbers(const std::string& fn)
+{
+    std::vector<UInt> holeNumbers;
+    HDFBasReader baxReader;
+    baxReader.IncludeField("Basecall");
+    if (baxReader.Initialize(fn) != 1)
+        return holeNumbers;
+
+    SMRTSequence baxRecord;
+    while (baxReader.GetNext(baxRecord)) {
+        holeNumbers.push_back(baxRecord.zmwData.holeNumber);
+        baxRecord.Free();
+    }
+    baxReader.Close();
+    return holeNumbers;
+}
+
+static void CompareRegions(const RegionTable& expectedTable,
+                           RegionTable& cursorTable,
+                           const UInt holeNumber)
+{
+    ASSERT_EQ(expectedTable.HasHoleNumber(holeNumber), cursorTable.HasHoleNumber(holeNumber))
+        << "hole number: " << holeNumber;
+    if (!expectedTable.HasHoleNumber(holeNumber))
+        return;
+
+    const RegionAnnotations expected = expectedTable[holeNumber];
+    const RegionAnnotations observed = cursorTable[holeNumber];
+    ASSERT_EQ(expected.HasHQRegion(), observed.HasHQRegion()) << "hole number: " << holeNumber;
+    if (expected.HasHQRegion()) {
+        EXPECT_EQ(expected.HQStart(), observed.HQStart()) << "hole number: " << holeNumber;
+        EXPECT_EQ(expected.HQEnd(), observed.HQEnd()) << "hole number: " << holeNumber;
+    }
+
+    const std::vector<ReadInterval> expectedAdapters = expected.AdapterIntervals();
+    const std::vector<ReadInterval> observedAdapters = observed.AdapterIntervals();
+    ASSERT_EQ(expectedAdapters.size(), observedAdapters.size()) << "hole number: " << holeNumber;
+    for (size_t i = 0; i < expectedAdapters.size(); ++i) {
+        EXPECT_EQ(expectedAdapters.at(i).start, observedAdapters.at(i).start);
+        EXPECT_EQ(expectedAdapters.at(i).end,   observedAdapters.at(i).end);
+        EXPECT_EQ(expectedAdapters.at(i).score, observedAdapters.at(i).score);
+    }
+}
+
+static void CompareWithRegionTable(RegionTableCursor& cursor,
+                                   const size_t holeStep)
+{
+    // full table, loaded the way bax2bam used to
+    std::unique_ptr<HDFRegionTableReader> const regionTableReader(new HDFRegionTableReader);
+    RegionTable regionTable;
+    std::string fn = regionsBaxFn;
+    ASSERT_TRUE(regionTableReader->Initialize(fn) != 0);
+    regionTable.Reset();
+    regionTableReader->ReadTable(regionTable);
+    regionTableReader->Close();
+
+    const std::vector<UInt> holeNumbers = BaxHoleNumbers(regionsBaxFn);
+    ASSERT_FALSE(holeNumbers.empty());
+
+    ASSERT_TRUE(cursor.Initialize(regionsBaxFn));
+    for (size_t i = 0; i < holeNumbers.size(); i += holeStep) {
+        const UInt holeNumber = holeNumbers.at(i);
+        CompareRegions(regionTable, cursor.Seek(holeNumber), holeNumber);
+    }
+    cursor.Close();
+}
+
+} // namespace tests
+
+TEST(RegionTableCursorTest, MatchesRegionTable_EveryZmw)
+{
+    RegionTableCursor cursor;
+    tests::CompareWithRegionTable(cursor, 1);
+}
+
+TEST(RegionTableCursorTest, MatchesRegionTable_SmallWindowsAndBlocks)
+{
+    // windows & blocks much smaller than the table, so rows straddle both
+    RegionTableCursor cursor(3, 7);
+    tests::CompareWithRegionTable(cursor, 1);
+}
+
+TEST(RegionTableCursorTest, MatchesRegionTable_SkippingZmws)
+{
+    // jumping ahead (--zmw-range, unsampled ZMWs) drops the rows passed over
+    RegionTableCursor cursor(16, 64);
+    tests::CompareWithRegionTable(cursor, 37);
+}
+
+TEST(RegionTableCursorTest, SeekBackwardsThrows)
+{
+    const std::vector<UInt> holeNumbers = tests::BaxHoleNumbers(tests::regionsBaxFn);
+    ASSERT_GT(holeNumbers.size(), 100u);
+
+    RegionTableCursor cursor(4, 8);
+    ASSERT_TRUE(cursor.Initialize(tests::regionsBaxFn));
+    EXPECT_NO_THROW(cursor.Seek(holeNumbers.at(100)));
+    EXPECT_THROW(cursor.Seek(holeNumbers.at(0)), std::runtime_error);
+    cursor.Close();
+}
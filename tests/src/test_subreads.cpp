@@ -6,12 +6,22 @@
 #include <cstdio>
 #include <cstdlib>
 #include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include <dirent.h>
+#include <unistd.h>
 
 #include <gtest/gtest.h>
 
+#include <boost/algorithm/string/predicate.hpp>
+
 #include <pbbam/BamFile.h>
 #include <pbbam/BamRecord.h>
+#include <pbbam/BamReader.h>
+#include <pbbam/DataSet.h>
 #include <pbbam/EntireFileQuery.h>
+#include <pbbam/PbiRawData.h>
 
 #include <hdf/HDFRegionTableReader.hpp>
 #include <hdf/HDFBasReader.hpp>
@@ -414,3 +424,869 @@ cleanup:
 
     }); // EXPECT_NO_THROW
 }
+
+TEST(SubreadsTest, Streaming_MatchesFileOutput)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string streamedBam = "streamed.subreads.bam";
+
+    // run conversion, once to files & once to stdout
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "-o - > " + streamedBam));
+
+    EXPECT_NO_THROW(
+    {
+        // no index for a streamed BAM
+        const BamFile streamedBamFile(streamedBam);
+        EXPECT_FALSE(streamedBamFile.PacBioIndexExists());
+
+        // same records, same order
+        EntireFileQuery generatedQuery(BamFile{ generatedBam });
+        EntireFileQuery streamedQuery(streamedBamFile);
+        auto generatedIter = generatedQuery.begin();
+        auto streamedIter = streamedQuery.begin();
+        size_t numRecords = 0;
+        for ( ; generatedIter != generatedQuery.end() && streamedIter != streamedQuery.end();
+              ++generatedIter, ++streamedIter)
+        {
+            EXPECT_EQ((*generatedIter).FullName(), (*streamedIter).FullName());
+            EXPECT_EQ((*generatedIter).Sequence(), (*streamedIter).Sequence());
+            ++numRecords;
+        }
+        EXPECT_TRUE(generatedIter == generatedQuery.end());
+        EXPECT_TRUE(streamedIter == streamedQuery.end());
+        EXPECT_GT(numRecords, 1UL);
+
+    }); // EXPECT_NO_THROW
+
+    // cleanup
+    RemoveFile(generatedBam);
+    RemoveFile(scrapBam);
+    RemoveFile(generatedBam + ".pbi");
+    RemoveFile(scrapBam + ".pbi");
+    RemoveFile(streamedBam);
+}
+
+TEST(SubreadsTest, Chunks_CoverFullOutput)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string chunkBam1 = movieName + ".chunk1of2.subreads.bam";
+    const std::string chunkBam2 = movieName + ".chunk2of2.subreads.bam";
+    const std::string chunkScraps1 = movieName + ".chunk1of2.scraps.bam";
+    const std::string chunkScraps2 = movieName + ".chunk2of2.scraps.bam";
+
+    // run conversion, once whole & once in 2 chunks
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--chunk 1/2"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--chunk 2/2"));
+
+    EXPECT_NO_THROW(
+    {
+        // chunks, in order, hold the same records as the whole movie
+        std::vector<std::string> chunkNames;
+        size_t numChunk1Records = 0;
+        for (const std::string& chunkBam : { chunkBam1, chunkBam2 }) {
+            const BamFile chunkBamFile(chunkBam);
+            EXPECT_TRUE(chunkBamFile.PacBioIndexExists());
+            EntireFileQuery chunkQuery(chunkBamFile);
+            for (const BamRecord& record : chunkQuery)
+                chunkNames.push_back(record.FullName());
+            if (numChunk1Records == 0)
+                numChunk1Records = chunkNames.size();
+        }
+        EXPECT_GT(numChunk1Records, 0UL);
+        EXPECT_LT(numChunk1Records, chunkNames.size());
+
+        EntireFileQuery generatedQuery(BamFile{ generatedBam });
+        size_t i = 0;
+        for (const BamRecord& record : generatedQuery) {
+            ASSERT_LT(i, chunkNames.size());
+            EXPECT_EQ(record.FullName(), chunkNames.at(i));
+            ++i;
+        }
+        EXPECT_EQ(chunkNames.size(), i);
+
+    }); // EXPECT_NO_THROW
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam, chunkBam1, chunkBam2, chunkScraps1, chunkScraps2 }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(SubreadsTest, Merge_ChunksMatchWholeMovie)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string chunkBam1 = movieName + ".chunk1of2.subreads.bam";
+    const std::string chunkBam2 = movieName + ".chunk2of2.subreads.bam";
+    const std::string chunkScraps1 = movieName + ".chunk1of2.scraps.bam";
+    const std::string chunkScraps2 = movieName + ".chunk2of2.scraps.bam";
+    const std::string mergedBam = "merged.subreads.bam";
+
+    // convert whole & in 2 chunks, then merge the chunks
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--chunk 1/2"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--chunk 2/2"));
+    const std::string mergeCommandLine = tests::Bax2Bam_Exe + " merge -o " + mergedBam +
+                                         " " + chunkBam1 + " " + chunkBam2;
+    EXPECT_EQ(0, system(mergeCommandLine.c_str()));
+
+    EXPECT_NO_THROW(
+    {
+        // same records, same order
+        EntireFileQuery generatedQuery(BamFile{ generatedBam });
+        EntireFileQuery mergedQuery(BamFile{ mergedBam });
+        auto generatedIter = generatedQuery.begin();
+        auto mergedIter = mergedQuery.begin();
+        size_t numRecords = 0;
+        for ( ; generatedIter != generatedQuery.end() && mergedIter != mergedQuery.end();
+              ++generatedIter, ++mergedIter)
+        {
+            EXPECT_EQ((*generatedIter).FullName(), (*mergedIter).FullName());
+            EXPECT_EQ((*generatedIter).Sequence(), (*mergedIter).Sequence());
+            ++numRecords;
+        }
+        EXPECT_TRUE(generatedIter == generatedQuery.end());
+        EXPECT_TRUE(mergedIter == mergedQuery.end());
+        EXPECT_GT(numRecords, 1UL);
+
+        // merged index points at the merged records
+        const BamFile mergedBamFile(mergedBam);
+        const PbiRawData mergedIndex(mergedBamFile.PacBioIndexFilename());
+        const PbiRawData generatedIndex(BamFile{ generatedBam }.PacBioIndexFilename());
+        EXPECT_EQ(generatedIndex.NumReads(), mergedIndex.NumReads());
+        EXPECT_EQ(generatedIndex.BasicData().holeNumber_, mergedIndex.BasicData().holeNumber_);
+        EXPECT_EQ(mergedBamFile.FirstAlignmentOffset(), mergedIndex.BasicData().fileOffset_.front());
+
+    }); // EXPECT_NO_THROW
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam, chunkBam1, chunkBam2,
+                                   chunkScraps1, chunkScraps2, mergedBam })
+    {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(SubreadsTest, MinSubreadLength_ScrapsFilteredSubreads)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const int minLength = 500;
+
+    // count short subreads in unfiltered output
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    size_t numSubreads = 0;
+    size_t numShort = 0;
+    EXPECT_NO_THROW(
+    {
+        EntireFileQuery query(BamFile{ generatedBam });
+        for (const BamRecord& record : query) {
+            ++numSubreads;
+            if (record.QueryEnd() - record.QueryStart() < minLength)
+                ++numShort;
+        }
+    });
+    EXPECT_GT(numShort, 0UL);
+
+    // short subreads leave the main BAM & show up in scraps as filtered
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--min-subread-length " + std::to_string(minLength) +
+                                                      " --scrap-filtered"));
+    EXPECT_NO_THROW(
+    {
+        size_t numKept = 0;
+        EntireFileQuery query(BamFile{ generatedBam });
+        for (const BamRecord& record : query) {
+            EXPECT_GE(record.QueryEnd() - record.QueryStart(), minLength);
+            ++numKept;
+        }
+        EXPECT_EQ(numSubreads - numShort, numKept);
+
+        size_t numFiltered = 0;
+        EntireFileQuery scrapsQuery(BamFile{ scrapBam });
+        for (const BamRecord& record : scrapsQuery) {
+            if (record.Impl().TagValue("sc").ToAscii() == 'F')
+                ++numFiltered;
+        }
+        EXPECT_EQ(numShort, numFiltered);
+    });
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(SubreadsTest, Subsample_IsRepeatableSubsetOfZmws)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string sampleArgs = "--subsample-fraction 0.2 --subsample-seed 7";
+
+    auto readNames = [&]() {
+        std::vector<std::string> names;
+        EntireFileQuery query(BamFile{ generatedBam });
+        for (const BamRecord& record : query)
+            names.push_back(record.FullName());
+        return names;
+    };
+
+    EXPECT_NO_THROW(
+    {
+        EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+        const std::vector<std::string> allNames = readNames();
+
+        EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", sampleArgs));
+        const std::vector<std::string> sampleNames = readNames();
+
+        EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", sampleArgs));
+        const std::vector<std::string> repeatNames = readNames();
+
+        // same ZMWs every run, & only some of them
+        EXPECT_EQ(sampleNames, repeatNames);
+        EXPECT_FALSE(sampleNames.empty());
+        EXPECT_LT(sampleNames.size(), allNames.size());
+        for (const std::string& name : sampleNames)
+            EXPECT_NE(allNames.cend(), std::find(allNames.cbegin(), allNames.cend(), name));
+    });
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(SubreadsTest, Fasta_MatchesBamRecords)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string generatedFasta = movieName + ".subreads.fasta";
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--fasta"));
+
+    EXPECT_NO_THROW(
+    {
+        // same names & bases, in the same order
+        std::ifstream fasta(generatedFasta);
+        std::string header;
+        std::string sequence;
+        size_t numRecords = 0;
+        EntireFileQuery query(BamFile{ generatedBam });
+        for (const BamRecord& record : query) {
+            ASSERT_TRUE(std::getline(fasta, header) && std::getline(fasta, sequence));
+            EXPECT_EQ(">" + record.FullName(), header);
+            EXPECT_EQ(record.Sequence(), sequence);
+            ++numRecords;
+        }
+        EXPECT_GT(numRecords, 0UL);
+        EXPECT_FALSE(std::getline(fasta, header));
+    });
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+    RemoveFile(generatedFasta);
+}
+
+TEST(SubreadsTest, StatsOnly_CountsMatchConversion)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string statsFile = movieName + ".stats.txt";
+
+    // dry run writes no BAMs
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--stats-only 2> " + statsFile));
+    EXPECT_FALSE(std::ifstream(generatedBam).good());
+
+    // reported subread counts match an actual conversion
+    uint64_t numSubreads = 0;
+    uint64_t numBases = 0;
+    std::ifstream stats(statsFile);
+    std::string line;
+    while (std::getline(stats, line)) {
+        const size_t colon = line.find(": ");
+        if (colon == std::string::npos)
+            continue;
+        const std::string name = line.substr(0, colon);
+        if (name == "SUBREAD subreads")
+            numSubreads = std::stoull(line.substr(colon + 2));
+        else if (name == "SUBREAD subread bases")
+            numBases = std::stoull(line.substr(colon + 2));
+    }
+    EXPECT_GT(numSubreads, 0UL);
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    EXPECT_NO_THROW(
+    {
+        uint64_t numRecords = 0;
+        uint64_t numRecordBases = 0;
+        EntireFileQuery query(BamFile{ generatedBam });
+        for (const BamRecord& record : query) {
+            ++numRecords;
+            numRecordBases += record.QueryEnd() - record.QueryStart();
+        }
+        EXPECT_EQ(numRecords, numSubreads);
+        EXPECT_EQ(numRecordBases, numBases);
+    });
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+    RemoveFile(statsFile);
+}
+
+TEST(SubreadsTest, LeanScraps_HaveNoPulseFeatures)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--lean-scraps"));
+    EXPECT_NO_THROW(
+    {
+        // scraps header advertises no base features
+        BamFile scrapsFile(scrapBam);
+        const BamHeader& header = scrapsFile.Header();
+        const std::vector<std::string> readGroupIds = header.ReadGroupIds();
+        ASSERT_FALSE(readGroupIds.empty());
+        const ReadGroupInfo& rg = header.ReadGroup(readGroupIds.front());
+        EXPECT_FALSE(rg.HasBaseFeature(BaseFeature::DELETION_QV));
+        EXPECT_FALSE(rg.HasBaseFeature(BaseFeature::IPD));
+        EXPECT_FALSE(rg.HasBaseFeature(BaseFeature::PULSE_WIDTH));
+
+        // scrap records keep bases & structural tags only
+        size_t numScraps = 0;
+        EntireFileQuery scraps(scrapsFile);
+        for (const BamRecord& record : scraps) {
+            const BamRecordImpl& impl = record.Impl();
+            EXPECT_FALSE(impl.Sequence().empty());
+            EXPECT_TRUE(impl.HasTag("sc"));
+            EXPECT_TRUE(impl.HasTag("sz"));
+            EXPECT_TRUE(impl.HasTag("zm"));
+            EXPECT_TRUE(impl.HasTag("qs"));
+            EXPECT_FALSE(impl.HasTag("dq"));
+            EXPECT_FALSE(impl.HasTag("ip"));
+            EXPECT_FALSE(impl.HasTag("pw"));
+            ++numScraps;
+        }
+        EXPECT_GT(numScraps, 0UL);
+
+        // subreads are unchanged
+        EntireFileQuery subreads(BamFile{ generatedBam });
+        for (const BamRecord& record : subreads) {
+            EXPECT_TRUE(record.Impl().HasTag("ip"));
+            break;
+        }
+    });
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(SubreadsTest, Resume_MatchesUninterruptedRun)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+    const std::string baxFilename = tests::Data_Dir + "/" + movieName + ".1.bax.h5";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(baxFilename);
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string checkpointFile = generatedBam + ".checkpoint";
+    const std::vector<std::string> outputs = { generatedBam, scrapBam, generatedBam + ".pbi", scrapBam + ".pbi" };
+
+    auto readFile = [](const std::string& fn) {
+        std::ifstream in(fn, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+
+    // starts a conversion & kills it once its checkpoint file has numLines lines
+    auto runUntilKilled = [&](const std::string& args, const size_t numLines) {
+        const std::string command =
+            tests::Bax2Bam_Exe + " --subread " + args + " " + baxFilename + " & pid=$!; "
+            "while kill -0 $pid 2>/dev/null && "
+            "[ \"$(cat " + checkpointFile + " 2>/dev/null | wc -l)\" -lt " + std::to_string(numLines) + " ]; "
+            "do sleep 0.01; done; "
+            "kill -9 $pid 2>/dev/null; wait $pid";
+        return system(command.c_str());
+    };
+
+    // uninterrupted run, its checkpoints are removed when it succeeds
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--checkpoint 20"));
+    EXPECT_FALSE(std::ifstream(checkpointFile).good());
+    std::vector<std::string> expected;
+    for (const std::string& fn : outputs)
+        expected.push_back(readFile(fn));
+    RemoveFiles(outputs);
+
+    // a run stopped partway, whose resumed run is stopped in turn
+    EXPECT_NE(0, runUntilKilled("--checkpoint 20", 50));
+    EXPECT_TRUE(std::ifstream(checkpointFile).good());
+    EXPECT_FALSE(std::ifstream(generatedBam + ".pbi").good());
+
+    EXPECT_NE(0, runUntilKilled("--checkpoint 20 --resume", 150));
+    EXPECT_TRUE(std::ifstream(checkpointFile).good());
+    EXPECT_TRUE(std::ifstream(generatedBam + ".resume").good());
+
+    // finally resumed output is byte-for-byte the same
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--checkpoint 20 --resume"));
+    EXPECT_FALSE(std::ifstream(checkpointFile).good());
+    EXPECT_FALSE(std::ifstream(generatedBam + ".resume").good());
+    for (size_t i = 0; i < outputs.size(); ++i)
+        EXPECT_TRUE(readFile(outputs[i]) == expected[i]) << outputs[i];
+
+    // resuming with different options is refused
+    EXPECT_NE(0, runUntilKilled("--checkpoint 20", 50));
+    EXPECT_NE(0, RunBax2Bam(baxFilenames, "--subread", "--checkpoint 30 --resume"));
+
+    // cleanup
+    RemoveFiles(outputs);
+    RemoveFile(checkpointFile);
+    RemoveFile(generatedBam + ".resume");
+    RemoveFile(scrapBam + ".resume");
+}
+
+TEST(SubreadsTest, SplitByZmws_PartsMatchSingleOutput)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+
+    auto readNames = [](const std::string& fn) {
+        std::vector<std::string> names;
+        EntireFileQuery query(BamFile{ fn });
+        for (const BamRecord& record : query)
+            names.push_back(record.FullName());
+        return names;
+    };
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    std::vector<std::string> expectedNames;
+    EXPECT_NO_THROW(expectedNames = readNames(generatedBam));
+
+    // parts, each indexed, hold the same records in the same order
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "--split-by-zmws 100"));
+    std::vector<std::string> partFilenames;
+    for (size_t k = 1; ; ++k) {
+        const std::string part = movieName + ".part" + std::to_string(k);
+        if (!std::ifstream(part + ".subreads.bam").good())
+            break;
+        EXPECT_TRUE(std::ifstream(part + ".subreads.bam.pbi").good());
+        EXPECT_TRUE(std::ifstream(part + ".scraps.bam.pbi").good());
+        partFilenames.push_back(part + ".subreads.bam");
+        partFilenames.push_back(part + ".scraps.bam");
+    }
+    EXPECT_GT(partFilenames.size(), 2UL);
+
+    std::vector<std::string> names;
+    EXPECT_NO_THROW(
+    {
+        for (size_t i = 0; i < partFilenames.size(); i += 2) {
+            const std::vector<std::string> partNames = readNames(partFilenames[i]);
+            names.insert(names.end(), partNames.begin(), partNames.end());
+        }
+    });
+    EXPECT_EQ(expectedNames, names);
+
+    // cleanup
+    partFilenames.push_back(generatedBam);
+    partFilenames.push_back(scrapBam);
+    for (const std::string& fn : partFilenames) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(SubreadsTest, CompressionLevels_RecordsAndIndexMatch)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+
+    auto readRecords = [](const std::string& fn) {
+        std::vector<std::string> records;
+        EntireFileQuery query(BamFile{ fn });
+        for (const BamRecord& record : query)
+            records.push_back(record.FullName() + " " + record.Sequence());
+        return records;
+    };
+
+    // each PBI offset must point at its record
+    auto checkIndex = [](const std::string& fn, const std::vector<std::string>& records) {
+        const PbiRawData index(fn + ".pbi");
+        ASSERT_EQ(records.size(), index.NumReads());
+        BamReader reader(fn);
+        BamRecord record;
+        for (size_t i = 0; i < records.size(); ++i) {
+            reader.VirtualSeek(index.BasicData().fileOffset_.at(i));
+            ASSERT_TRUE(reader.GetNext(record));
+            EXPECT_EQ(records.at(i), record.FullName() + " " + record.Sequence());
+        }
+    };
+
+    auto fileSize = [](const std::string& fn) {
+        std::ifstream in(fn, std::ios::binary | std::ios::ate);
+        return static_cast<size_t>(in.tellg());
+    };
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    std::vector<std::string> expectedSubreads;
+    std::vector<std::string> expectedScraps;
+    EXPECT_NO_THROW(
+    {
+        expectedSubreads = readRecords(generatedBam);
+        expectedScraps = readRecords(scrapBam);
+    });
+    EXPECT_FALSE(expectedSubreads.empty());
+    EXPECT_FALSE(expectedScraps.empty());
+
+    // uncompressed subreads with best-compressed scraps, then the other way around
+    size_t storedSubreadsSize = 0;
+    size_t storedScrapsSize = 0;
+    for (const std::string& levels : { std::string("--compression-level 0 --scraps-compression-level 9"),
+                                       std::string("--compression-level 9 --scraps-compression-level 0") })
+    {
+        EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", levels));
+        EXPECT_NO_THROW(
+        {
+            EXPECT_EQ(expectedSubreads, readRecords(generatedBam)) << levels;
+            EXPECT_EQ(expectedScraps, readRecords(scrapBam)) << levels;
+            checkIndex(generatedBam, expectedSubreads);
+            checkIndex(scrapBam, expectedScraps);
+        });
+
+        if (storedSubreadsSize == 0) {
+            storedSubreadsSize = fileSize(generatedBam);
+            storedScrapsSize = fileSize(scrapBam);
+        } else {
+            EXPECT_GT(storedSubreadsSize, fileSize(generatedBam));
+            EXPECT_LT(storedScrapsSize, fileSize(scrapBam));
+        }
+    }
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(SubreadsTest, TmpDir_OutputsPublishedToFinalPaths)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string inputXml = "tmpdir_input.subreadset.xml";
+    const std::string prefix = "tmpdir_staged";
+    const std::string stagedBam = prefix + ".subreads.bam";
+    const std::string stagedScraps = prefix + ".scraps.bam";
+    const std::string stagedXml = prefix + ".subreadset.xml";
+
+    char tmpDir[] = "bax2bam_tmpdir.XXXXXX";
+    ASSERT_TRUE(mkdtemp(tmpDir) != nullptr);
+
+    auto readNames = [](const std::string& fn) {
+        std::vector<std::string> names;
+        EntireFileQuery query(BamFile{ fn });
+        for (const BamRecord& record : query)
+            names.push_back(record.FullName());
+        return names;
+    };
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    std::vector<std::string> expectedNames;
+    EXPECT_NO_THROW(expectedNames = readNames(generatedBam));
+    EXPECT_FALSE(expectedNames.empty());
+
+    // BAMs, PBIs & dataset XML all written via the scratch dir
+    EXPECT_NO_THROW(WriteBaxDatasetXml(baxFilenames, inputXml));
+    EXPECT_EQ(0, RunBax2Bam(std::vector<std::string>(), "--subread",
+                            "-o " + prefix + " --tmpdir " + tmpDir + " --xml " + inputXml));
+
+    for (const std::string& fn : { stagedBam, stagedBam + ".pbi",
+                                   stagedScraps, stagedScraps + ".pbi",
+                                   stagedXml })
+    {
+        EXPECT_TRUE(std::ifstream(fn).good()) << fn;
+    }
+    EXPECT_NO_THROW(EXPECT_EQ(expectedNames, readNames(stagedBam)));
+
+    // staging dir is cleaned up, nothing left behind in the scratch dir
+    size_t numLeftovers = 0;
+    if (DIR* dir = opendir(tmpDir)) {
+        while (const dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name != "." && name != "..")
+                ++numLeftovers;
+        }
+        closedir(dir);
+    }
+    EXPECT_EQ(0UL, numLeftovers);
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam, stagedBam, stagedScraps }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+    RemoveFile(stagedXml);
+    RemoveFile(inputXml);
+    rmdir(tmpDir);
+}
+
+TEST(SubreadsTest, WriteBuffer_MatchesDirectWrites)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string prefix = "write_buffer";
+    const std::string bufferedBam = prefix + ".subreads.bam";
+    const std::string bufferedScraps = prefix + ".scraps.bam";
+
+    auto readFile = [](const std::string& fn) {
+        std::ifstream in(fn, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+
+    // through the pipe & large buffers (& O_DIRECT where supported), outputs are byte-identical
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    for (const std::string& args : { std::string("--write-buffer 64K"),
+                                     std::string("--write-buffer 64K --direct-io") })
+    {
+        EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread", "-o " + prefix + " " + args));
+        const std::string expectedBam = readFile(generatedBam);
+        EXPECT_FALSE(expectedBam.empty());
+        EXPECT_TRUE(expectedBam == readFile(bufferedBam)) << args;
+        EXPECT_TRUE(readFile(scrapBam) == readFile(bufferedScraps)) << args;
+        EXPECT_TRUE(std::ifstream(bufferedBam + ".pbi").good()) << args;
+    }
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam, bufferedBam, bufferedScraps }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+}
+
+TEST(SubreadsTest, SplitByBytes_PartsAndDatasetXml)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string inputXml = "split_input.subreadset.xml";
+    const std::string prefix = "split_bytes";
+    const std::string outputXml = prefix + ".subreadset.xml";
+    const size_t splitBytes = 1024 * 1024;
+
+    auto readNames = [](const std::string& fn) {
+        std::vector<std::string> names;
+        EntireFileQuery query(BamFile{ fn });
+        for (const BamRecord& record : query)
+            names.push_back(record.FullName());
+        return names;
+    };
+
+    auto fileSize = [](const std::string& fn) {
+        std::ifstream in(fn, std::ios::binary | std::ios::ate);
+        return static_cast<size_t>(in.tellg());
+    };
+
+    EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread"));
+    std::vector<std::string> expectedNames;
+    EXPECT_NO_THROW(expectedNames = readNames(generatedBam));
+    ASSERT_GT(fileSize(generatedBam), 2 * splitBytes);
+
+    EXPECT_NO_THROW(WriteBaxDatasetXml(baxFilenames, inputXml));
+    EXPECT_EQ(0, RunBax2Bam(std::vector<std::string>(), "--subread",
+                            "-o " + prefix + " --split-by-bytes 1M --xml " + inputXml));
+
+    // every part but the last reached the limit, & together they hold the single output's records
+    std::vector<std::string> partFilenames;
+    for (size_t k = 1; ; ++k) {
+        const std::string part = prefix + ".part" + std::to_string(k) + ".subreads.bam";
+        if (!std::ifstream(part).good())
+            break;
+        partFilenames.push_back(part);
+    }
+    ASSERT_GT(partFilenames.size(), 1UL);
+    for (size_t i = 0; i + 1 < partFilenames.size(); ++i)
+        EXPECT_GE(fileSize(partFilenames[i]), splitBytes) << partFilenames[i];
+
+    std::vector<std::string> names;
+    EXPECT_NO_THROW(
+    {
+        for (const std::string& part : partFilenames) {
+            const std::vector<std::string> partNames = readNames(part);
+            EXPECT_FALSE(partNames.empty()) << part;
+            names.insert(names.end(), partNames.begin(), partNames.end());
+        }
+    });
+    EXPECT_EQ(expectedNames, names);
+
+    // dataset XML lists each part, in order, with its scraps & indexes
+    EXPECT_NO_THROW(
+    {
+        const DataSet dataset(outputXml);
+        const ExternalResources& resources = dataset.ExternalResources();
+        ASSERT_EQ(partFilenames.size(), resources.Size());
+        size_t i = 0;
+        for (const ExternalResource& resource : resources) {
+            const std::string& part = partFilenames.at(i);
+            const std::string scraps = prefix + ".part" + std::to_string(i + 1) + ".scraps.bam";
+            const std::string id = resource.ResourceId();
+            EXPECT_TRUE(boost::algorithm::ends_with(id, "/" + part)) << id;
+            EXPECT_EQ(1UL, resource.FileIndices().Size()) << id;
+            ASSERT_EQ(1UL, resource.ExternalResources().Size()) << id;
+            for (const ExternalResource& scrapsResource : resource.ExternalResources())
+                EXPECT_TRUE(boost::algorithm::ends_with(scrapsResource.ResourceId(), "/" + scraps));
+            ++i;
+        }
+        EXPECT_EQ(std::to_string(expectedNames.size()), dataset.Metadata().NumRecords());
+    });
+
+    // cleanup
+    for (size_t k = 1; k <= partFilenames.size(); ++k) {
+        const std::string part = prefix + ".part" + std::to_string(k);
+        for (const std::string& fn : { part + ".subreads.bam", part + ".scraps.bam" }) {
+            RemoveFile(fn);
+            RemoveFile(fn + ".pbi");
+        }
+    }
+    for (const std::string& fn : { generatedBam, scrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+    RemoveFile(outputXml);
+    RemoveFile(inputXml);
+}
+
+TEST(SubreadsTest, Prefetch_OnlySampledZmws)
+{
+    // setup
+    const std::string movieName = "m160823_221224_ethan_c010091942559900001800000112311890_s1_p0";
+
+    std::vector<std::string> baxFilenames;
+    baxFilenames.push_back(tests::Data_Dir + "/" + movieName + ".1.bax.h5");
+
+    const std::string generatedBam = movieName + ".subreads.bam";
+    const std::string scrapBam = movieName + ".scraps.bam";
+    const std::string statsFile = "prefetch_stats.txt";
+    const double fraction = 0.05;
+
+    // "bytes prefetched" from a run's --stats report
+    auto bytesPrefetched = [&](const std::string& args) {
+        EXPECT_EQ(0, RunBax2Bam(baxFilenames, "--subread",
+                                "--stats --prefetch 256 --prefetch-mode read " + args + " 2> " + statsFile));
+        std::ifstream in(statsFile);
+        std::string line;
+        const std::string label = "bytes prefetched: ";
+        while (std::getline(in, line)) {
+            if (line.compare(0, label.size(), label) == 0)
+                return std::stoull(line.substr(label.size()));
+        }
+        return 0ULL;
+    };
+
+    const unsigned long long allBytes = bytesPrefetched("");
+    const unsigned long long sampledBytes = bytesPrefetched("--subsample-fraction " + std::to_string(fraction));
+    EXPECT_GT(allBytes, 0ULL);
+    EXPECT_GT(sampledBytes, 0ULL);
+
+    // unsampled ZMWs aren't prefetched, only chunks shared with sampled ones are
+    EXPECT_LT(static_cast<double>(sampledBytes), 4 * fraction * allBytes);
+
+    // cleanup
+    for (const std::string& fn : { generatedBam, scrapBam }) {
+        RemoveFile(fn);
+        RemoveFile(fn + ".pbi");
+    }
+    RemoveFile(statsFile);
+}